@@ -195,7 +195,14 @@ __global__ void ml_gol_kernel_one_step(bool* d_current, bool* d_next, color_t* d
 
 __global__ void ml_gol_kernel_one_step_shared(bool* d_current, bool* d_next, color_t* d_layers_colors, color_t* d_combined, color_t* d_dependent, uint64_t grid_size, uint64_t num_layers);
 
-__global__ void manage_ghost_cells_kernel(bool* d_current, bool* d_next, uint64_t grid_size, uint64_t num_layers);
+/**
+ * @brief The kernel to fill the ghost cells of the current grid on the device, one thread per row and column (ghost ones included).
+ * 
+ * @param d_current The current grid
+ * @param grid_size The size of the grid
+ * @param num_layers The number of layers
+ */
+__global__ void fill_ghost_cells_kernel(bool* d_current, uint64_t grid_size, uint64_t num_layers);
 
 __global__ void swap_grids_no_ghost_kernel(bool* d_current, bool* d_next, uint64_t grid_size, uint64_t num_layers);
 
@@ -10,7 +10,10 @@ extern "C" {
 
 #include "ml_gol.cuh"
 
+// side of the blocks of threads, it can be changed at compile time, e.g. make NVCCFLAGS+=-DBLKDIM=16
+#ifndef BLKDIM
 #define BLKDIM 32
+#endif
 
 #define cudaCheckErrors(msg) \
     do { \
@@ -87,7 +90,8 @@ void start_game_on_cuda(const uint64_t grid_size, const uint64_t num_layers, con
             swap_grids_no_ghost_kernel<<<gridDim, blockDim>>>(d_current, d_next, grid_size, num_layers);
             cudaDeviceSynchronize();
 
-            manage_ghost_cells_kernel<<<1,1>>>(d_current, d_next, grid_size, num_layers);
+            // one thread per row and column of the grid, the ghost ones included
+            fill_ghost_cells_kernel<<<(grid_size + 2 + BLKDIM * BLKDIM - 1) / (BLKDIM * BLKDIM), BLKDIM * BLKDIM>>>(d_current, grid_size, num_layers);
             cudaDeviceSynchronize();
 
             sum_times += tend - tstart;
@@ -304,9 +308,9 @@ void reset_combined_and_dependent(ml_gol_t* ml_gol) {
 
 __host__ __device__ void fill_ghost_cells(bool* current, uint64_t grid_size, uint64_t num_layers) {
     const uint64_t TOP = 1;
-    const uint64_t BOTTOM = grid_size - 1;
+    const uint64_t BOTTOM = grid_size;
     const uint64_t LEFT = 1;
-    const uint64_t RIGHT = grid_size - 1;
+    const uint64_t RIGHT = grid_size;
     const uint64_t HALO_TOP = TOP - 1;
     const uint64_t HALO_BOTTOM = BOTTOM + 1;
     const uint64_t HALO_LEFT = LEFT - 1;
@@ -519,17 +523,24 @@ __global__ void swap_grids_no_ghost_kernel(bool* d_current, bool* d_next, uint64
     swap_grid_cell(d_current, d_next, x, y, num_layers, grid_size);        
 }
 
-__global__ void manage_ghost_cells_kernel(bool* d_current, bool* d_next, uint64_t grid_size, uint64_t num_layers) {
-    // one thread swaps ghost cells and then update them
-        for (uint64_t row = 0; row <= grid_size + 1; row++) {
-            swap_grid_cell(d_current, d_next, row, 0, num_layers, grid_size);
-            swap_grid_cell(d_current, d_next, row, grid_size + 1, num_layers, grid_size);   
-        }
+__global__ void fill_ghost_cells_kernel(bool* d_current, uint64_t grid_size, uint64_t num_layers) {
+    // the thread k fills the ghost cells of the row k and of the column k, the ghost cells of the next grid are never read
+    uint64_t k = threadIdx.x + (blockDim.x * blockIdx.x);
+
+    if (k > grid_size + 1) {
+        return;
+    }
+
+    // the corners are read from the cells of the grid, not from the ghost cells filled by the other threads
+    uint64_t column = k == 0 ? grid_size : (k == grid_size + 1 ? 1 : k);
 
-        for (uint64_t column = 1; column <= grid_size; column++) {
-            swap_grid_cell(d_current, d_next, 0, column, num_layers, grid_size);
-            swap_grid_cell(d_current, d_next, grid_size + 1, column, num_layers, grid_size);   
+    for (uint64_t l = 0; l < num_layers; l++) {
+        if (k >= 1 && k <= grid_size) {
+            d_current[idx_flat(grid_size, num_layers, k, 0, l)] = d_current[idx_flat(grid_size, num_layers, k, grid_size, l)];
+            d_current[idx_flat(grid_size, num_layers, k, grid_size + 1, l)] = d_current[idx_flat(grid_size, num_layers, k, 1, l)];
         }
-        
-        fill_ghost_cells(d_current, grid_size, num_layers);
+
+        d_current[idx_flat(grid_size, num_layers, 0, k, l)] = d_current[idx_flat(grid_size, num_layers, grid_size, column, l)];
+        d_current[idx_flat(grid_size, num_layers, grid_size + 1, k, l)] = d_current[idx_flat(grid_size, num_layers, 1, column, l)];
+    }
 }
@@ -0,0 +1,63 @@
+#ifndef __AUTOTUNE_H
+#define __AUTOTUNE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "scheduler.h"
+
+/**
+ * @brief Returns the name of the file where the tuned schedules are stored.
+ * It is the value of the MLGOL_TUNING_CACHE environment variable if set, otherwise ".mlgol_tuning" in the current directory.
+ *
+ * @return The name of the file
+ */
+const char* tuning_cache_filename(void);
+
+/**
+ * @brief Writes the model name of the CPU (from /proc/cpuinfo) in the given string, "unknown" if it is not available.
+ *
+ * @param model The string
+ * @param length The length of the string
+ */
+void get_cpu_model(char* model, size_t length);
+
+/**
+ * @brief Benchmarks the candidate schedules for the given configuration on this machine and returns the fastest.
+ *
+ * The kernels are compared first with the schedule chosen by the cost model,
+ * then all the strategies with the thread counts that are powers of two (and the maximum),
+ * then, if the tiles are the fastest, the tile sizes.
+ * Each candidate is timed on a few steps of a random grid with the given size.
+ *
+ * @param grid_size The size of the grid
+ * @param num_layers The number of layers
+ * @param max_threads The maximum number of threads
+ * @return The fastest schedule
+ */
+schedule_t autotune_schedule(uint64_t grid_size, uint64_t num_layers, int max_threads);
+
+/**
+ * @brief Loads the tuned schedule for the given configuration and the CPU of this machine.
+ *
+ * @param filename The name of the cache file
+ * @param grid_size The size of the grid
+ * @param num_layers The number of layers
+ * @param schedule The loaded schedule
+ * @return 0 if the schedule was found, -1 otherwise
+ */
+int load_tuned_schedule(const char* filename, uint64_t grid_size, uint64_t num_layers, schedule_t* schedule);
+
+/**
+ * @brief Stores the tuned schedule for the given configuration and the CPU of this machine,
+ * the schedule previously stored for the same configuration is replaced.
+ *
+ * @param filename The name of the cache file
+ * @param grid_size The size of the grid
+ * @param num_layers The number of layers
+ * @param schedule The schedule
+ * @return 0 on success, -1 if the file could not be written
+ */
+int save_tuned_schedule(const char* filename, uint64_t grid_size, uint64_t num_layers, schedule_t schedule);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef __BATCH_H
+#define __BATCH_H
+
+#include <stdint.h>
+
+/**
+ * @brief Structure to represent the configuration of a single run of a batch.
+ */
+typedef struct {
+    uint64_t grid_size;
+    uint64_t num_layers;
+    uint64_t num_steps;
+    float density;
+    uint64_t seed;
+} run_config_t;
+
+/**
+ * @brief Structure to represent the results of a single run of a batch.
+ *
+ * The alive cells are counted over all the layers after the last step,
+ * the mean dependent is the mean value (0-255) of the dependent grid after the last step.
+ */
+typedef struct {
+    uint64_t alive_cells;
+    double mean_dependent;
+    double elapsed_time;
+    int thread;
+} run_result_t;
+
+/**
+ * @brief Runs all the configurations listed in the given file and writes the results in the summary file.
+ *
+ * The configuration file has one run per line with the format:
+ * <grid_size> <num_layers> <num_steps> <density> <seed>
+ * Empty lines and lines starting with '#' are ignored.
+ *
+ * @param config_filename The file with the configurations of the runs
+ * @param summary_filename The file where the summary is written (CSV)
+ * @return 0 on success, -1 if the configuration file could not be read
+ */
+int start_batch(const char* config_filename, const char* summary_filename);
+
+/**
+ * @brief Reads the configurations of the runs from the given file.
+ *
+ * @param filename The name of the file
+ * @param configs The array of configurations, allocated by the function
+ * @return The number of configurations read, -1 on error
+ */
+int64_t read_run_configs(const char* filename, run_config_t** configs);
+
+/**
+ * @brief Executes the given runs concurrently, one run per thread at a time.
+ *
+ * Runs are scheduled dynamically from the most expensive to the cheapest one
+ * and every thread reuses its own pooled buffers from one run to the next.
+ *
+ * @param configs The configurations of the runs
+ * @param num_runs The number of runs
+ * @param results The results of the runs, in the same order of the configurations
+ */
+void run_batch(const run_config_t* configs, uint64_t num_runs, run_result_t* results);
+
+/**
+ * @brief Writes the results of the runs to a CSV file.
+ *
+ * @param filename The name of the file
+ * @param configs The configurations of the runs
+ * @param results The results of the runs
+ * @param num_runs The number of runs
+ */
+void write_batch_summary(const char* filename, const run_config_t* configs, const run_result_t* results, uint64_t num_runs);
+
+#endif
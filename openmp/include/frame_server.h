@@ -0,0 +1,98 @@
+#ifndef __FRAME_SERVER_H
+#define __FRAME_SERVER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "preview.h"
+
+#define DEFAULT_FRAME_SIZE 512
+
+// frames of the triple buffer, the flag of the slot tells whether its frame has not been taken by the server yet
+#define FRAME_BUFFERS 3
+#define FRAME_FRESH 4
+
+// milliseconds a request waits for the simulation to publish a new frame, before the last one is served
+#define FRAME_WAIT 1000
+
+// milliseconds the server waits for a connection before it checks whether it has to stop, and for the request of a connection
+#define FRAME_POLL_INTERVAL 100
+#define FRAME_REQUEST_TIMEOUT 1000
+
+#define MAX_FRAME_REQUEST_LENGTH 1024
+#define FRAME_ADDRESS_LENGTH 108
+
+/**
+ * @brief Structure to represent a server of the live frames of a run, over HTTP on a local TCP port or a unix socket.
+ *
+ * The frames are previews (see preview.h) of a single level, of frame_size pixels per side, in a triple buffer shared with
+ * the simulation without locks: the step callback calculates a frame in its back buffer and exchanges it with the slot,
+ * the server exchanges its front buffer with the slot when the frame of the slot is fresh. The latest frame always wins,
+ * the frames not taken in time are overwritten, so a slow viewer never stalls the simulation.
+ * The frames are only calculated when the server asked for one (the wanted flag): without viewers a step costs a relaxed load.
+ * The frames are downscaled, colored (in the buffer of the front frame) and encoded as PNG by the server thread, when a viewer requests them:
+ * GET /combined?size=<pixels> or /dependent?size=<pixels>, a page that shows both and refreshes them every second is served at /.
+ */
+typedef struct {
+    preview_t frames[FRAME_BUFFERS];
+    uint64_t frame_steps[FRAME_BUFFERS];
+    color_t* layers_colors;
+    uint64_t num_layers;
+    uint64_t frame_size;
+    int back;
+    int front;
+    bool has_frame;
+    atomic_int slot;
+    atomic_bool wanted;
+    float* scaled_density;
+    int socket_fd;
+    pthread_t server;
+    atomic_bool running;
+    char socket_path[FRAME_ADDRESS_LENGTH];
+} frame_server_t;
+
+/**
+ * @brief Initializes the frames of a server for the given multilayer game of life, the size is limited to the size of the grid.
+ * It must be freed with free_frame_server.
+ *
+ * @param frame_server The frame server
+ * @param ml_gol The multilayer game of life structure
+ * @param frame_size The side of the frames in pixels, the largest size a viewer can request
+ */
+void init_frame_server(frame_server_t* frame_server, const ml_gol_t* ml_gol, uint64_t frame_size);
+
+/**
+ * @brief Step callback that publishes a frame of the step when the server asked for one, the user data is the frame server.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param user_data The frame server
+ */
+void frame_server_step_callback(const ml_gol_t* ml_gol, void* user_data);
+
+/**
+ * @brief Starts the thread that serves the frames, on 127.0.0.1 if the address is a port number and on a unix socket otherwise.
+ * A file already at the path of a unix socket (e.g. the socket of a previous run) is replaced.
+ *
+ * @param frame_server The frame server
+ * @param address The port or the path of the socket
+ * @return 0 on success, -1 if the socket could not be created
+ */
+int start_frame_server(frame_server_t* frame_server, const char* address);
+
+/**
+ * @brief Stops the server thread, and removes the unix socket.
+ *
+ * @param frame_server The frame server
+ */
+void stop_frame_server(frame_server_t* frame_server);
+
+/**
+ * @brief Frees the memory allocated for the frame server, it must be stopped.
+ *
+ * @param frame_server The frame server
+ */
+void free_frame_server(frame_server_t* frame_server);
+
+#endif
@@ -5,36 +5,192 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "rule.h"
+#include "mlgol_api.h"
+
+/**
+ * @brief The implementations of the step of a layer, they all produce the same result.
+ *
+ * KERNEL_NEIGHBORS: counts the neighbors of each cell and applies the rules with branches.
+ * KERNEL_BRANCHLESS: works on whole rows through row pointers and applies the rules without branches, so that it is vectorized.
+ * KERNEL_WRAP: like KERNEL_BRANCHLESS, but the wrap of the torus is handled by the kernel itself (the rows through the row pointers,
+ * the first and last columns by a separate edge kernel), so the ghost cells are never read and not filled after its steps.
+ * Its interior kernel is specialized at compile time for the most common rules, the other rules use a generic one.
+ * The layers with a Larger than Life rule (radius larger than 1) are stepped by the same kernel whatever the chosen one,
+ * it counts the cells of the squares from the column sums of the grid in constant time per cell for any radius.
+ */
+typedef enum {
+    KERNEL_NEIGHBORS,
+    KERNEL_BRANCHLESS,
+    KERNEL_WRAP
+} kernel_t;
+
+#define NUM_KERNELS 3
+
+/**
+ * @brief How the cells of a layer are stored while stepping.
+ *
+ * REPRESENTATION_AUTO: the layer switches between the dense and the sparse representation when its population crosses
+ * the thresholds of live_set.h, checked after each step.
+ * REPRESENTATION_DENSE: the layer is always stepped by its kernel on the whole grid.
+ * REPRESENTATION_SPARSE: the layer is always stepped from its live set, the sorted positions of its alive cells,
+ * so that the time of a step scales with the population instead of the area of the grid.
+ * The layers whose rule cannot be stepped from a live set (Larger than Life, births with 0 neighbors) are always dense.
+ */
+typedef enum {
+    REPRESENTATION_AUTO,
+    REPRESENTATION_DENSE,
+    REPRESENTATION_SPARSE
+} representation_t;
+
+#define NUM_REPRESENTATIONS 3
+
+// the first cell (column 1) of every row is aligned to this number of bytes, for the vector loads of the kernels
+#define GRID_ALIGNMENT 64
+
+// side of the square tiles used to track which parts of the grid changed during a step
+#define ACTIVITY_TILE_SIZE 64
+
+// rows of the chunks of the column sums, they restart at the first row of each chunk
+#define COLUMN_SUMS_ROWS ACTIVITY_TILE_SIZE
+
+/**
+ * @brief Structure to represent the statistics of a step of the game of life.
+ * The alive cells are counted after the step, the changed tiles are the tiles with at least one birth or death.
+ */
+typedef struct {
+    uint64_t alive;
+    uint64_t births;
+    uint64_t deaths;
+    uint64_t changed_tiles;
+} gol_stats_t;
+
+struct live_set;
+
 /**
  * @brief Structure to represent the game of life.
  * 
  * The game of life is represented by two grids: the current grid and the next grid.
  * The current grid represents the current state of the game, while the next grid represents the next state of the game.
  * Each grid is represented as an array of boolean values, where true represents an alive cell and false represents a dead cell.
- * The variable size represents the size of the grids.
+ * The variable size represents the size of the grids, the stride is the distance between the start of two rows (see idx).
+ * The kernel is the implementation used to step the grid, the rule decides the births and the survivals (Conway's by default).
+ * The stats refer to the last completed step, they are gathered by the kernels while stepping (in next_stats).
+ * The changed tiles flag the tiles of ACTIVITY_TILE_SIZE cells per side changed by the last completed step (next_changed_tiles while stepping).
+ * The column sums of a grid (NULL unless enabled) hold, with the same indices of the cells, the alive cells of the column
+ * from the first row of the chunk of COLUMN_SUMS_ROWS rows of the cell to the cell, modulo 256: the difference of two of them
+ * is the exact number of alive cells between two rows of the chunk, since it is at most COLUMN_SUMS_ROWS.
+ * They are swapped with the grids and calculated again for the new current grid at the end of each step.
+ * The live set is NULL while the layer is dense, otherwise the layer is stepped from it (see live_set.h): the changed tiles
+ * and the stats are still kept up to date. The grids and the column sums are kept up to date too, only in the cells that change,
+ * if keep_grids is set (the default): otherwise they are freed (NULL) after the steps of the sparse layer, so that its memory follows
+ * its population, and rebuilt from the live set when they are read (see restore_grids) or the layer becomes dense again.
+ * The grids that do not belong to the layer (owns_grids is false, see init_gol_with_buffers) are never freed.
  */
 typedef struct {
     bool* current;
     bool* next;
     uint64_t size;
+    uint64_t stride;
+    kernel_t kernel;
+    rule_t rule;
+    gol_stats_t stats;
+    gol_stats_t next_stats;
+    uint8_t* changed_tiles;
+    uint8_t* next_changed_tiles;
+    uint64_t tiles_per_side;
+    uint8_t* column_sums;
+    uint8_t* next_column_sums;
+    representation_t representation;
+    struct live_set* live_set;
+    bool owns_grids;
+    bool keep_grids;
 } gol_t;
 
 /**
- * @brief Initializes the game of life's grid with the given density.
+ * @brief Initializes the game of life's grid with the given density, its representation is chosen automatically.
+ * 
+ * @param gol The game of life structure
+ * @param grid_size The size of the grid
+ * @param density The density of the grid
+ * @param rng_state The state of the random number generator (see rand_r)
+ */
+void init_gol(gol_t *gol, uint64_t grid_size, float density, unsigned int* rng_state);
+
+/**
+ * @brief Initializes the game of life's grid on already allocated buffers.
+ * Each grid buffer must hold at least count_grid_cells(grid_size) cells and be aligned to GRID_ALIGNMENT bytes,
+ * the tiles buffer at least 2 * count_activity_tiles(grid_size) flags.
+ * The buffers are not freed by free_gol, they belong to the caller. The layer is always dense, so that it does not allocate memory.
  * 
  * @param gol The game of life structure
  * @param grid_size The size of the grid
  * @param density The density of the grid
+ * @param rng_state The state of the random number generator (see rand_r)
+ * @param current The buffer for the current grid
+ * @param next The buffer for the next grid
+ * @param tiles The buffer for the changed tiles flags
  */
-void init_gol(gol_t *gol, uint64_t grid_size, float density);
+void init_gol_with_buffers(gol_t *gol, uint64_t grid_size, float density, unsigned int* rng_state, bool* current, bool* next, uint8_t* tiles);
+
+/**
+ * @brief Returns the distance between the start of two rows of a grid, the cells and the ghost cells of a row rounded up to GRID_ALIGNMENT.
+ * 
+ * @param grid_size The size of the grid
+ * @return The stride of the rows
+ */
+uint64_t get_grid_stride(uint64_t grid_size);
+
+/**
+ * @brief Returns the number of cells of a grid buffer, ghost cells and alignment included, it is a multiple of GRID_ALIGNMENT.
+ * 
+ * @param grid_size The size of the grid
+ * @return The number of cells
+ */
+size_t count_grid_cells(uint64_t grid_size);
+
+/**
+ * @brief Allocates a grid buffer (or the column sums) of count_grid_cells(grid_size) bytes, filled with zeros and aligned to a page.
+ * The buffer is mapped from the system rather than taken from malloc: the grids of a sparse layer are freed and allocated again,
+ * and malloc would keep their memory in its heap after raising its mmap threshold to their size on the first free.
+ * 
+ * @param grid_size The size of the grid
+ * @return The buffer, it must be freed with free_grid
+ */
+void* allocate_grid(uint64_t grid_size);
+
+/**
+ * @brief Frees a buffer allocated by allocate_grid, nothing is done if it is NULL.
+ * 
+ * @param grid The buffer
+ * @param grid_size The size of the grid
+ */
+void free_grid(void* grid, uint64_t grid_size);
+
+/**
+ * @brief Returns the number of activity tiles of a grid.
+ * 
+ * @param grid_size The size of the grid
+ * @return The number of tiles
+ */
+uint64_t count_activity_tiles(uint64_t grid_size);
 
 /**
  * @brief Initializes the grid with the given density.
  * 
  * @param gol The game of life structure
  * @param density The density of the grid
+ * @param rng_state The state of the random number generator (see rand_r)
+ */
+void init_grid(const gol_t* gol, float density, unsigned int* rng_state);
+
+/**
+ * @brief Counts the number of alive cells in the grid, the cells of the live set if the grids of the sparse layer are freed.
+ * 
+ * @param gol The game of life structure
+ * @return The number of alive cells
  */
-void init_grid(const gol_t* gol, float density);
+uint64_t count_alive_cells(const gol_t* gol);
 
 /**
  * @brief Counts the number of alive neighbors of a cell.
@@ -47,19 +203,59 @@ void init_grid(const gol_t* gol, float density);
 uint8_t count_alive_neighbors(const gol_t* gol, uint64_t i, uint64_t j);
 
 /**
- * @brief Performs one step of the game of life.
+ * @brief Performs one step of the game of life, from the live set if the layer has one.
+ * After a dense step the ghost cells of the current grid are filled again, unless the kernel does not read them.
  * 
  * @param gol The game of life structure
  */
 void step(gol_t* gol);
 
 /**
- * @brief Swaps the current and next grids.
+ * @brief Calculates the next state of a rectangular block of cells with the kernel of the game of life, the grids are not swapped.
+ * Rows and columns start from 1 (0 is the ghost cell), the last row and column are excluded.
+ * Different blocks of the same grid can be calculated concurrently, the births, deaths and changed tiles are added to the next stats.
+ * 
+ * @param gol The game of life structure
+ * @param first_row The first row of the block
+ * @param last_row The row after the last row of the block
+ * @param first_col The first column of the block
+ * @param last_col The column after the last column of the block
+ */
+void step_block(gol_t* gol, uint64_t first_row, uint64_t last_row, uint64_t first_col, uint64_t last_col);
+
+/**
+ * @brief Completes a step calculated with step_block: swaps the grids, fills the ghost cells (if the kernel reads them) and publishes the stats of the step.
+ * The ghost cells and the column sums of a layer with a live set are not calculated again, its step only updates the cells that changed.
+ * 
+ * @param gol The game of life structure
+ */
+void complete_step(gol_t* gol);
+
+/**
+ * @brief Returns the stats of the step being calculated: the births and deaths of the next stats,
+ * the alive cells from the ones of the last completed step and the changed tiles counted on the next changed tiles.
+ * 
+ * @param gol The game of life structure
+ * @return The stats of the step
+ */
+gol_stats_t collect_step_stats(const gol_t* gol);
+
+/**
+ * @brief Swaps the current and next grids, with their column sums.
  * 
  * @param gol The game of life structure
  */
 void swap_grids(gol_t* gol);
 
+/**
+ * @brief Brings the state of the game of life up to date after the cells of the current grid were written directly (e.g. by a pattern):
+ * the ghost cells, the column sums (if enabled) and the stats are calculated again and all the tiles are flagged as changed.
+ * The live set, if any, is built again and the representation is chosen again for the new population.
+ * 
+ * @param gol The game of life structure
+ */
+void refresh_gol(gol_t* gol);
+
 /**
  * @brief Fills the ghost cells of the grid.
  * 
@@ -67,6 +263,109 @@ void swap_grids(gol_t* gol);
  */
 void fill_ghost_cells(const gol_t* gol);
 
+/**
+ * @brief Fills the ghost cells of the given rows of the grid: the ghost columns of the rows and, if they include the first
+ * or the last row, the ghost row on the other side of the torus. Rows start from 1, the last row is excluded.
+ * Different rows of the same grid can be filled concurrently, calling it on all the rows is the same as fill_ghost_cells.
+ * 
+ * @param gol The game of life structure
+ * @param first_row The first row
+ * @param last_row The row after the last row
+ */
+void fill_ghost_rows(const gol_t* gol, uint64_t first_row, uint64_t last_row);
+
+/**
+ * @brief Sets the rule of the game of life, the column sums are enabled for the Larger than Life rules.
+ * The representation is chosen again, since not all the rules can be stepped from a live set.
+ * 
+ * @param gol The game of life structure
+ * @param rule The rule
+ */
+void set_rule(gol_t* gol, rule_t rule);
+
+/**
+ * @brief Allocates the column sums of the two grids, if not already enabled, and calculates the ones of the current grid.
+ * They are kept up to date by the following steps and freed by free_gol.
+ * 
+ * @param gol The game of life structure
+ */
+void enable_column_sums(gol_t* gol);
+
+/**
+ * @brief Calculates the column sums of the given rows of the current grid, rows start from 1 and the last row is excluded.
+ * The rows must be whole chunks of COLUMN_SUMS_ROWS rows (the last one can be shorter), different chunks can be calculated concurrently.
+ * 
+ * @param gol The game of life structure
+ * @param first_row The first row
+ * @param last_row The row after the last row
+ */
+void calculate_column_sums(const gol_t* gol, uint64_t first_row, uint64_t last_row);
+
+/**
+ * @brief Adds to counts[k] the alive cells of the current grid in the square of side 2 * radius + 1 centered on the cell (i, first_col + k),
+ * the cell included, for the columns from first_col to last_col (excluded). The squares are wrapped on the torus, a cell is counted
+ * more than once if the square is larger than the grid. It needs the column sums and takes constant time per cell for any radius.
+ * 
+ * @param gol The game of life structure
+ * @param i The row of the cells
+ * @param radius The radius of the squares
+ * @param first_col The first column
+ * @param last_col The column after the last column, at most ACTIVITY_TILE_SIZE columns after the first one
+ * @param counts The counts, one per column
+ */
+void add_square_counts(const gol_t* gol, uint64_t i, uint64_t radius, uint64_t first_col, uint64_t last_col, uint16_t* counts);
+
+/**
+ * @brief Sets the kernel used to step the grid.
+ * The ghost cells are filled if the kernel reads them, since they are not up to date after the steps of KERNEL_WRAP.
+ * 
+ * @param gol The game of life structure
+ * @param kernel The kernel
+ */
+void set_kernel(gol_t* gol, kernel_t kernel);
+
+/**
+ * @brief Returns the name of the given kernel.
+ * 
+ * @param kernel The kernel
+ * @return The name of the kernel
+ */
+MLGOL_API const char* kernel_name(kernel_t kernel);
+
+/**
+ * @brief Parses the name of a kernel.
+ * 
+ * @param name The name of the kernel
+ * @param kernel The parsed kernel
+ * @return 0 on success, -1 if the name is unknown
+ */
+MLGOL_API int parse_kernel(const char* name, kernel_t* kernel);
+
+/**
+ * @brief Returns the name of the given representation.
+ *
+ * @param representation The representation
+ * @return The name of the representation
+ */
+MLGOL_API const char* representation_name(representation_t representation);
+
+/**
+ * @brief Parses the name of a representation.
+ *
+ * @param name The name of the representation
+ * @param representation The parsed representation
+ * @return 0 on success, -1 if the name is unknown
+ */
+MLGOL_API int parse_representation(const char* name, representation_t* representation);
+
+/**
+ * @brief Returns whether the wrap kernel has an interior kernel specialized for the given rule (never for a Larger than Life rule).
+ * 
+ * @param rule The rule
+ * @return true if the rule is specialized, false if it uses the generic interior kernel
+ */
+bool has_specialized_kernel(rule_t rule);
+
 /**
  * @brief Frees the memory allocated for the game of life structure.
  * 
@@ -76,6 +375,7 @@ void free_gol(gol_t* gol);
 
 /**
  * @brief Returns the index of a cell in the grid.
+ * The column 1 of each row starts at a multiple of GRID_ALIGNMENT, the ghost column 0 is the last byte of the padding of the row before.
  * 
  * @param gol The game of life structure
  * @param i The row of the cell
@@ -83,7 +383,7 @@ void free_gol(gol_t* gol);
  * @return size_t The index of the cell
  */
 static inline size_t idx(const gol_t* gol, uint64_t i, uint64_t j) {
-    return i * (gol->size + 2) + j;
+    return i * gol->stride + (GRID_ALIGNMENT - 1) + j;
 }
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef __IMAGE_H
 #define __IMAGE_H
 
+#include <stdio.h>
 #include <stdint.h>
 
 /**
@@ -13,4 +14,15 @@
  */
 void write_png_file(const char* filename, uint64_t width, uint64_t height, uint8_t* buffer);
 
+/**
+ * @brief Writes a PNG image with the given buffer to an open file (e.g. a memory stream).
+ * 
+ * @param fp The file
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param buffer The buffer with the image data
+ * @return 0 on success, -1 if the image could not be written
+ */
+int write_png_stream(FILE* fp, uint64_t width, uint64_t height, uint8_t* buffer);
+
 #endif
\ No newline at end of file
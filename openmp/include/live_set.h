@@ -0,0 +1,138 @@
+#ifndef __LIVE_SET_H
+#define __LIVE_SET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "game_of_life.h"
+
+// a layer with REPRESENTATION_AUTO becomes sparse when fewer than 1 cell in SPARSE_ENTER_RATIO is alive and dense again
+// when more than 1 cell in SPARSE_EXIT_RATIO is, the gap keeps a population around a threshold from switching at every step
+#define SPARSE_ENTER_RATIO 32
+#define SPARSE_EXIT_RATIO 16
+
+// the smallest grid stepped from a live set, so that the 3 columns and the 3 rows around a cell are different cells
+#define LIVE_SET_MIN_SIZE 3
+
+/**
+ * @brief Structure to represent the sparse representation of a layer.
+ *
+ * The cells are the positions (i - 1) * size + (j - 1) of the alive cells, in increasing order, the changes are the positions
+ * of the cells that changed state in the last step, in the same order: they are also the only cells where the next grid
+ * of the layer (the previous step) differs from the current one, so a step only copies them before writing its own changes.
+ * The next cells and the next changes are the arrays filled by the step, swapped with the others at its end.
+ * The rows are the rows (from 0) with at least one alive cell, in increasing order, and the row begins and ends hold for each row
+ * the range of its cells (size + 1 entries, empty for the other rows): a step only reads and clears the entries of its rows,
+ * so that it never visits the empty rows. The visited rows are the rows next to an alive cell, the scratch array of a step
+ * like the columns and the column counts (size + 2 entries).
+ * The column sums tell whether the layer had its column sums when its grids were freed, so that they are restored with them.
+ */
+typedef struct live_set {
+    uint64_t* cells;
+    uint64_t num_cells;
+    uint64_t cells_capacity;
+    uint64_t* next_cells;
+    uint64_t num_next_cells;
+    uint64_t next_cells_capacity;
+    uint64_t* changes;
+    uint64_t num_changes;
+    uint64_t changes_capacity;
+    uint64_t* next_changes;
+    uint64_t num_next_changes;
+    uint64_t next_changes_capacity;
+    uint64_t* rows;
+    uint64_t num_rows;
+    uint64_t* row_begins;
+    uint64_t* row_ends;
+    uint64_t* visited_rows;
+    int64_t* columns;
+    uint8_t* column_counts;
+    bool column_sums;
+} live_set_t;
+
+/**
+ * @brief Returns whether a layer can be stepped from a live set: its rule counts the 8 neighbors (radius 1),
+ * it has no births with 0 neighbors (the dead cells far from the alive ones would be born) and the grid is at least LIVE_SET_MIN_SIZE.
+ *
+ * @param gol The game of life structure
+ * @return true if the layer can be sparse
+ */
+bool can_use_live_set(const gol_t* gol);
+
+/**
+ * @brief Builds the live set of a layer from its current grid, allocating it if the layer is dense.
+ * The next grid and its column sums are copied from the current ones, so that the live set starts without changes.
+ * It reads the whole grid, with all the threads.
+ *
+ * @param gol The game of life structure
+ */
+void build_live_set(gol_t* gol);
+
+/**
+ * @brief Makes a layer dense again: the ghost cells, not kept by the steps of the live set, are filled and the live set is freed.
+ *
+ * @param gol The game of life structure
+ */
+void release_live_set(gol_t* gol);
+
+/**
+ * @brief Allocates the grids of a sparse layer freed by update_representation and fills them from its live set:
+ * the current grid with the cells and its ghost cells, the next grid with the previous state (the current one without the changes),
+ * and their column sums if the layer had them. It does nothing if the layer has its grids.
+ *
+ * @param gol The game of life structure
+ */
+void restore_grids(gol_t* gol);
+
+/**
+ * @brief Sets whether a layer keeps its grids while it is sparse, for the outputs that read them: the grids are restored
+ * if they are kept, freed if the layer is sparse and they are not (unless the layer does not own them).
+ *
+ * @param gol The game of life structure
+ * @param keep Whether the grids are kept
+ */
+void set_keep_grids(gol_t* gol, bool keep);
+
+/**
+ * @brief Adds to sums[j] the alive cells of the live set in the column j (from 0) of the rows i - radius to i + radius
+ * (i from 1, wrapped on the torus), for all the columns of the grid. It reads the live set only, the grids may be freed.
+ *
+ * @param gol The game of life structure
+ * @param i The row of the center of the window
+ * @param radius The radius of the window
+ * @param sums The sums of the columns, size entries
+ */
+void add_live_set_columns(const gol_t* gol, uint64_t i, uint64_t radius, uint16_t* sums);
+
+/**
+ * @brief Switches a layer to the representation required by its setting, its rule and, with REPRESENTATION_AUTO, its population
+ * (the alive cells of its stats, see SPARSE_ENTER_RATIO and SPARSE_EXIT_RATIO). The switch reads the whole grid once.
+ * The grids of a sparse layer are then freed, unless it keeps them (see set_keep_grids).
+ * It must be called between two steps, after the outputs that read the previous state in the next grid.
+ *
+ * @param gol The game of life structure
+ */
+void update_representation(gol_t* gol);
+
+/**
+ * @brief Sets the representation of a layer and switches to it, if needed.
+ *
+ * @param gol The game of life structure
+ * @param representation The representation
+ */
+void set_representation(gol_t* gol, representation_t representation);
+
+/**
+ * @brief Performs one step of a layer from its live set, then completes it (see complete_step).
+ * The rows next to an alive cell are found from the cells and visited in order: the columns of the alive cells of the 3 rows
+ * around each one are merged with their counts, then each column next to one of them gets the alive cells of its 3x3 square
+ * from the counts of the columns around it and the rule gives its next state. The new cells come out in order, without sorting.
+ * Only the changed cells are written to the next grid (with its column sums) if the layer has its grids, the tiles of the changes are flagged.
+ * The empty rows are never visited, so the step costs as much as the alive and changed cells, not the size of the grid.
+ * The layer is stepped by the calling thread alone, the layers can be stepped concurrently.
+ *
+ * @param gol The game of life structure
+ */
+void step_live_set(gol_t* gol);
+
+#endif
@@ -5,6 +5,27 @@
 
 #include "game_of_life.h"
 #include "color.h"
+#include "scheduler.h"
+#include "viewport.h"
+#include "telemetry.h"
+#include "mlgol_api.h"
+
+struct ml_gol;
+
+/**
+ * @brief Function called after each step of the multilayer game of life.
+ * When it is called the layers, the combined and the dependent grids are all up to date with the step.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param user_data The pointer given to set_step_callback
+ */
+typedef void (*step_callback_t)(const struct ml_gol* ml_gol, void* user_data);
+
+// maximum number of step callbacks of a multilayer game of life
+#define MAX_STEP_CALLBACKS 8
+
+// maximum number of layers, so that the dependent counts of the 3x3 neighborhoods over all the layers fit in 16 bits
+#define MAX_NUM_LAYERS (UINT16_MAX / 9)
 
 /**
  * @brief Structure to represent the multilayer game of life.
@@ -13,39 +34,385 @@
  * The layers represent different instances of the game of life, each with standard rules.
  * The combined grid represents the combined state of all the layers, while the dependent grid represents a dependent state based on the layers.
  * The grid_size represents the size of the grids (layers, combined and dependent).
+ * The step is the number of steps performed since the initialization, the step callbacks are called after each of them.
+ * The schedule tells how the work of each step is split among the threads.
+ * The neighborhood of a cell of the dependent grid is the square of side 2 * dependent_radius + 1 around it (3x3 by default).
+ * The dependent histogram counts the cells of the dependent grid by number of alive cells in their neighborhood (0 to side^2 * num_layers),
+ * it is gathered while the dependent grid is calculated, each thread in its own row of the thread histograms.
+ * The dependent counts hold, for each cell, the number of alive cells in its neighborhood over all the layers (the value of the dependent grid):
+ * they are calculated once and then updated at each step only around the cells that changed state (recalculated from the column sums
+ * of the layers in the squares that changed, with a larger radius).
+ * The dependent deltas are the scratch rows (one per thread histogram) used to update the counts.
+ * When derived_grids is false the combined and dependent grids (and the histogram) are not calculated by the steps,
+ * for the outputs that only read the layers. When combined_grid is false only the combined grid is not calculated,
+ * for the outputs that only read the dependent grid and its histogram (e.g. the stats). The grids that are not calculated are not allocated
+ * either, unless they are pooled buffers (owns_buffers is false).
+ * When layers_grids is false (and the derived grids are disabled) the sparse layers free their grids and keep only their live sets,
+ * for the outputs that do not read the grids of the layers (see set_keep_grids in live_set.h).
+ * The telemetry, when it is not NULL, receives the progress of the steps (see telemetry.h).
  */
-typedef struct {
+typedef struct ml_gol {
     gol_t* layers;
     uint64_t num_layers;
     color_t* layers_colors;
     color_t* combined;
     color_t* dependent;
+    uint16_t* dependent_counts;
+    int16_t* dependent_deltas;
+    uint64_t dependent_radius;
     uint64_t grid_size;
+    uint64_t step;
+    step_callback_t step_callbacks[MAX_STEP_CALLBACKS];
+    void* callbacks_data[MAX_STEP_CALLBACKS];
+    int num_step_callbacks;
+    schedule_t schedule;
+    uint64_t* dependent_histogram;
+    uint64_t* thread_histograms;
+    int num_thread_histograms;
+    bool derived_grids;
+    bool combined_grid;
+    bool layers_grids;
+    bool owns_buffers;
+    telemetry_t* telemetry;
 } ml_gol_t;
 
+/**
+ * @brief Structure to hold reusable buffers for multilayer game of life instances.
+ * 
+ * The buffers grow to fit the largest instance they have been reserved for and are reused
+ * by the following instances, so that runs executed one after the other do not need to allocate memory.
+ */
+typedef struct {
+    gol_t* layers;
+    bool* grids;
+    color_t* layers_colors;
+    color_t* combined;
+    color_t* dependent;
+    uint16_t* dependent_counts;
+    uint8_t* tiles;
+    uint64_t* histograms;
+    int16_t* deltas;
+    uint64_t layers_capacity;
+    size_t grids_capacity;
+    size_t colors_capacity;
+    size_t tiles_capacity;
+    size_t histograms_capacity;
+    size_t deltas_capacity;
+} ml_gol_buffers_t;
+
+/**
+ * @brief Structure to represent the optional outputs of a run.
+ * The stats filename is NULL when the stats are not written, the dependent histogram is in the stats every stats histogram interval steps.
+ * The preview size is 0 when no preview is created.
+ * The preview levels are the number of levels of the pyramid of previews, each half the side of the previous one.
+ * The viewports are the regions written at full resolution at each step.
+ * The replay filename is NULL when no replay is written, a keyframe is written every keyframe interval steps.
+ * The telemetry socket is NULL when no telemetry server is started.
+ * The frame server address (a local port or a unix socket) is NULL when no live frames are served, the frames have frame size pixels per side.
+ */
+typedef struct {
+    bool create_png;
+    const char* stats_filename;
+    uint64_t stats_histogram_interval;
+    uint64_t preview_size;
+    uint64_t preview_levels;
+    const viewport_t* viewports;
+    uint64_t num_viewports;
+    const char* replay_filename;
+    uint64_t keyframe_interval;
+    const char* telemetry_socket;
+    const char* frame_server_address;
+    uint64_t frame_size;
+} output_options_t;
+
+/**
+ * @brief Structure to represent the rules of a run.
+ * The rules are assigned to the layers in order and repeated when there are fewer rules than layers,
+ * all the layers follow Conway's rule when there are none. The dependent radius is the radius of the neighborhoods of the dependent grid.
+ * The workload file, if any, replaces the random initial state of the layers (see load_workload in pattern.h).
+ */
+typedef struct {
+    const rule_t* rules;
+    uint64_t num_rules;
+    uint64_t dependent_radius;
+    const char* workload_filename;
+} rule_options_t;
+
 /**
  * @brief Function to start the multilayer game of life.
  * 
  * @param grid_size Size of the grid
  * @param num_layers Number of layers
  * @param num_steps Number of steps
- * @param use_png Flag to indicate if PNG files should be created
+ * @param outputs The outputs to write while running
+ * @param rules The rules of the layers and of the dependent grid
  * @param density Density of the grid
  * @param seed Seed for the random number generator
+ * @return 0 on success, -1 if the number of layers is larger than MAX_NUM_LAYERS or the workload could not be loaded
  */
-void start_game(uint64_t grid_size, uint64_t num_layers, uint64_t num_steps, bool use_png, float density, uint64_t seed);
+MLGOL_API int start_game(uint64_t grid_size, uint64_t num_layers, uint64_t num_steps, output_options_t outputs, rule_options_t rules, float density, uint64_t seed);
 
 /**
- * @brief Initializes the multilayer game of life structure.
+ * @brief Creates and initializes a multilayer game of life, the combined and dependent grids are calculated for step 0.
+ * It must be freed with free_ml_gol.
+ * 
+ * @param grid_size Size of the grid
+ * @param num_layers Number of layers
+ * @param density Density of the grid
+ * @param seed Seed for the random number generator
+ * @return The multilayer game of life structure, NULL if the number of layers is 0 or larger than MAX_NUM_LAYERS
+ */
+MLGOL_API ml_gol_t* create_ml_gol(uint64_t grid_size, uint64_t num_layers, float density, uint64_t seed);
+
+/**
+ * @brief Creates and initializes a multilayer game of life like create_ml_gol, the combined and dependent grids
+ * are only allocated and calculated for step 0 if they are enabled (see set_derived_grids). When they are not,
+ * the sparse layers do not keep their grids either (see set_layers_grids), so that they are freed as soon as they are initialized.
+ * 
+ * @param grid_size Size of the grid
+ * @param num_layers Number of layers
+ * @param density Density of the grid
+ * @param seed Seed for the random number generator
+ * @param derived_grids Flag to indicate if the combined and dependent grids are calculated
+ * @return The multilayer game of life structure, NULL if the number of layers is 0 or larger than MAX_NUM_LAYERS
+ */
+ml_gol_t* create_ml_gol_with_derived_grids(uint64_t grid_size, uint64_t num_layers, float density, uint64_t seed, bool derived_grids);
+
+/**
+ * @brief Initializes the multilayer game of life structure, the combined and dependent grids are calculated for step 0.
  * 
  * @param ml_gol The multilayer game of life structure
  * @param grid_size Size of the grid
  * @param num_layers Number of layers
- * @param create_png Flag to indicate if PNG files should be created
  * @param density Density of the grid
  * @param seed Seed for the random number generator
+ * @return 0 on success, -1 if the number of layers is 0 or larger than MAX_NUM_LAYERS
+ */
+MLGOL_API int init_ml_gol(ml_gol_t* ml_gol, uint64_t grid_size, uint64_t num_layers, float density, uint64_t seed);
+
+/**
+ * @brief Initializes the multilayer game of life structure on the given pooled buffers.
+ * The buffers are not freed by free_ml_gol, so the structure must not be passed to it.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param buffers The pooled buffers, they are grown if needed
+ * @param grid_size Size of the grid
+ * @param num_layers Number of layers
+ * @param density Density of the grid
+ * @param seed Seed for the random number generator
+ * @return 0 on success, -1 if the number of layers is 0 or larger than MAX_NUM_LAYERS
+ */
+MLGOL_API int init_ml_gol_with_buffers(ml_gol_t* ml_gol, ml_gol_buffers_t* buffers, uint64_t grid_size, uint64_t num_layers, float density, uint64_t seed);
+
+/**
+ * @brief Grows the pooled buffers so that they can hold an instance with the given size.
+ * 
+ * @param buffers The pooled buffers
+ * @param grid_size Size of the grid
+ * @param num_layers Number of layers
+ */
+MLGOL_API void reserve_ml_gol_buffers(ml_gol_buffers_t* buffers, uint64_t grid_size, uint64_t num_layers);
+
+/**
+ * @brief Frees the memory held by the pooled buffers.
+ * 
+ * @param buffers The pooled buffers
  */
-void init_ml_gol(ml_gol_t* ml_gol, uint64_t grid_size, uint64_t num_layers, bool create_png, float density, uint64_t seed);
+MLGOL_API void free_ml_gol_buffers(ml_gol_buffers_t* buffers);
+
+/**
+ * @brief Performs the given number of steps of the multilayer game of life.
+ * Each step advances all the layers, calculates the combined and dependent grids and then calls the step callbacks, if any.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param num_steps The number of steps
+ */
+MLGOL_API void step_ml_gol(ml_gol_t* ml_gol, uint64_t num_steps);
+
+/**
+ * @brief Sets how the work of the next steps is split among the threads.
+ * With SCHEDULE_PERSISTENT the step callbacks are called from inside the parallel region by a single thread.
+ * With SCHEDULE_TASKS the steps only overlap when there are no step callbacks, since they need the whole state of every step.
+ * The number of threads is limited to the number of thread histograms.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param schedule The schedule
+ */
+MLGOL_API void set_schedule(ml_gol_t* ml_gol, schedule_t schedule);
+
+/**
+ * @brief Sets whether the steps calculate the combined and dependent grids, they do by default.
+ * The grids are freed while they are disabled, unless they are pooled buffers (see init_ml_gol_with_buffers).
+ * When they are enabled again the grids are allocated and calculated for the current step.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param derived_grids Flag to indicate if the grids should be calculated
+ */
+MLGOL_API void set_derived_grids(ml_gol_t* ml_gol, bool derived_grids);
+
+/**
+ * @brief Sets whether the steps calculate the combined grid together with the dependent one, they do by default.
+ * It has no effect while the derived grids are disabled. When it is enabled again the grid is calculated for the current step.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param combined_grid Flag to indicate if the combined grid should be calculated
+ */
+MLGOL_API void set_combined_grid(ml_gol_t* ml_gol, bool combined_grid);
+
+/**
+ * @brief Sets whether the sparse layers keep their grids while the derived grids are disabled, they do by default.
+ * Without them a sparse layer only holds its live set, so that the memory follows the alive cells: the grids are allocated again
+ * when the layer becomes dense or when they are read (see get_layer_grid), the outputs that read them at each step should keep them.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param layers_grids Flag to indicate if the sparse layers keep their grids
+ */
+MLGOL_API void set_layers_grids(ml_gol_t* ml_gol, bool layers_grids);
+
+/**
+ * @brief Sets the only function called after each step, NULL to remove all the callbacks.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param callback The function to call
+ * @param user_data The pointer passed to the function
+ */
+MLGOL_API void set_step_callback(ml_gol_t* ml_gol, step_callback_t callback, void* user_data);
+
+/**
+ * @brief Adds a function called after each step, the callbacks are called in the order they were added.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param callback The function to call
+ * @param user_data The pointer passed to the function
+ * @return 0 on success, -1 if there are already MAX_STEP_CALLBACKS callbacks
+ */
+MLGOL_API int add_step_callback(ml_gol_t* ml_gol, step_callback_t callback, void* user_data);
+
+/**
+ * @brief Sets the telemetry that receives the progress of the steps, NULL to stop recording it.
+ * The steps performed from now on are recorded, the time before is the setup time of the telemetry.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param telemetry The telemetry
+ */
+void set_telemetry(ml_gol_t* ml_gol, telemetry_t* telemetry);
+
+/**
+ * @brief Sets the representation of all the layers (see representation_t), they start with REPRESENTATION_AUTO.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param representation The representation
+ */
+MLGOL_API void set_layers_representation(ml_gol_t* ml_gol, representation_t representation);
+
+/**
+ * @brief Sets the rule of the given layer, all the layers start with Conway's rule.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer number
+ * @param rule The rule
+ */
+MLGOL_API void set_layer_rule(ml_gol_t* ml_gol, uint64_t layer, rule_t rule);
+
+/**
+ * @brief Returns the rule of the given layer.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer number
+ * @return The rule of the layer
+ */
+MLGOL_API rule_t get_layer_rule(const ml_gol_t* ml_gol, uint64_t layer);
+
+/**
+ * @brief Sets the radius of the neighborhoods of the dependent grid, 1 by default, and calculates the dependent grid again.
+ * With a radius larger than 1 the column sums of the layers are enabled.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param radius The radius, from 1 to MAX_RULE_RADIUS
+ * @return 0 on success, -1 if the radius is not valid or the counts of the neighborhoods would not fit in the dependent counts
+ */
+MLGOL_API int set_dependent_radius(ml_gol_t* ml_gol, uint64_t radius);
+
+/**
+ * @brief Returns the stats of the last step of the given layer (the initial alive cells before the first step).
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer number
+ * @return The pointer to the stats of the layer
+ */
+MLGOL_API const gol_stats_t* get_layer_stats(const ml_gol_t* ml_gol, uint64_t layer);
+
+/**
+ * @brief Returns a read-only pointer to the histogram of the dependent grid, no copy is made.
+ * Bin k counts the cells with k alive cells in their neighborhood over all the layers, there are side^2 * num_layers + 1 bins
+ * (see get_dependent_histogram_bins), side is the side of the neighborhoods.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @return The pointer to the histogram
+ */
+MLGOL_API const uint64_t* get_dependent_histogram(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Returns the number of bins of the histogram of the dependent grid.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @return The number of bins
+ */
+MLGOL_API uint64_t get_dependent_histogram_bins(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Returns a read-only pointer to the current grid of the given layer, no copy is made.
+ * The pointer refers to the cell (0, 0), the cell (i, j) is at position i * get_layer_grid_stride(ml_gol) + j.
+ * The pointer is valid until the next step. The grid of a sparse layer that freed it is allocated again from its live set,
+ * so the function must not be called concurrently for the same layer.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer number
+ * @return The pointer to the grid of the layer
+ */
+MLGOL_API const bool* get_layer_grid(const ml_gol_t* ml_gol, uint64_t layer);
+
+/**
+ * @brief Allocates again the grids freed by the sparse layers (see set_layers_grids), before the outputs read them
+ * from several threads: the grids that are not freed are left as they are.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ */
+void restore_layers_grids(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Returns the distance between two consecutive rows of the layer grids.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @return The number of cells between the start of two rows
+ */
+MLGOL_API uint64_t get_layer_grid_stride(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Returns a read-only pointer to the combined grid, no copy is made.
+ * The grid is grid_size * grid_size RGB pixels stored by rows, it is overwritten by the next step.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @return The pointer to the combined grid, NULL if it is not calculated and was freed
+ */
+MLGOL_API const color_t* get_combined_grid(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Returns a read-only pointer to the dependent grid, no copy is made.
+ * The grid is grid_size * grid_size RGB pixels stored by rows, it is overwritten by the next step.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @return The pointer to the dependent grid, NULL if it is not calculated and was freed
+ */
+MLGOL_API const color_t* get_dependent_grid(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Brings the multilayer game of life up to date after the cells of its layers were written directly (e.g. by a pattern):
+ * each layer is refreshed (see refresh_gol) and the combined and dependent grids are calculated again, if the steps calculate them.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ */
+MLGOL_API void refresh_ml_gol(ml_gol_t* ml_gol);
 
 /**
  * @brief Calculates the combined grid from the layers of the multilayer game of life.
@@ -54,13 +421,30 @@ void init_ml_gol(ml_gol_t* ml_gol, uint64_t grid_size, uint64_t num_layers, bool
  */
 void calculate_combined(const ml_gol_t* ml_gol);
 
+/**
+ * @brief Calculates the given rows of the combined grid, rows start from 1 and the last row is excluded.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param first_row The first row
+ * @param last_row The row after the last row
+ */
+void calculate_combined_rows(const ml_gol_t* ml_gol, uint64_t first_row, uint64_t last_row);
+
+/**
+ * @brief Updates a row (starting from 1) of the combined grid after a step, only the tiles changed in at least one layer are calculated.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param i The row
+ */
+void update_combined_row(const ml_gol_t* ml_gol, uint64_t i);
+
 /**
  * @brief Creates a PNG file for the given step of the multilayer game of life.
  * 
  * @param ml_gol The multilayer game of life structure
  * @param step The step number
  */
-void create_png_for_step(const ml_gol_t* ml_gol, uint64_t step);
+MLGOL_API void create_png_for_step(const ml_gol_t* ml_gol, uint64_t step);
 
 /**
  * @brief Creates a PNG file for the given grid.
@@ -90,12 +474,67 @@ void reset_combined_and_dependent(ml_gol_t* ml_gol);
 void write_png_file(const char* filename, uint64_t width, uint64_t height, uint8_t* buffer);
 
 /**
- * @brief Calculates the dependent grid from the layers of the multilayer game of life.
+ * @brief Calculates the dependent grid, its counts and its histogram from scratch, from the layers of the multilayer game of life.
  * 
  * @param ml_gol The multilayer game of life structure
  */
 void calculate_dependent(const ml_gol_t* ml_gol);
 
+/**
+ * @brief Calculates only the dependent histogram from scratch, from the layers of the multilayer game of life:
+ * the counts of a row are summed in a scratch row and added to the histogram, the dependent grid and its counts are not written.
+ * It is the histogram of the outputs that do not need the dependent grid (e.g. the stats) while the derived grids are disabled.
+ *
+ * @param ml_gol The multilayer game of life structure
+ */
+void calculate_dependent_histogram(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Calculates the given rows of the dependent grid, rows start from 1 and the last row is excluded.
+ * The cells are added to the thread histogram of the calling thread, the thread histograms are added to the histogram by merge_dependent_histograms.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param first_row The first row
+ * @param last_row The row after the last row
+ */
+void calculate_dependent_rows(const ml_gol_t* ml_gol, uint64_t first_row, uint64_t last_row);
+
+/**
+ * @brief Adds the thread histograms to the dependent histogram and clears them for the next step.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ */
+void merge_dependent_histograms(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Updates the dependent grid after a step from the cells that changed state, instead of calculating it from scratch.
+ * Each birth adds 1 and each death removes 1 from the counts of the 3x3 square around it, only the changed tiles of the layers are scanned.
+ * With a larger radius the counts of the tiles with a change in their neighborhood are calculated again from the column sums of the layers.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ */
+void update_dependent(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Applies to the dependent grid the changes of the cells of the given row (starting from 1) in the last step.
+ * The rows before and after are also updated, so rows closer than 3 must not be updated concurrently (with a larger radius only the row is updated).
+ * The changes of the histogram are added to the thread histogram of the calling thread.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ * @param i The row
+ */
+void update_dependent_row(const ml_gol_t* ml_gol, uint64_t i);
+
+/**
+ * @brief Updates the combined and dependent grids after a step in which all the layers were stepped from live sets,
+ * from the cells changed in the last step: each change calculates its cell of the combined grid again (when it is calculated) and adds 1 (birth)
+ * or removes 1 (death) from the counts of the neighborhoods that contain it, so the work scales with the changes instead of the grid.
+ * The changes of the histogram are added to the thread histogram of the calling thread.
+ *
+ * @param ml_gol The multilayer game of life structure
+ */
+void update_derived_from_live_sets(const ml_gol_t* ml_gol);
+
 /**
  * @brief Gets the color for the given layer.
  * 
@@ -113,20 +552,28 @@ color_t get_color_for_layer(uint64_t layer, const uint64_t num_layers);
 void print_layers_colors(const ml_gol_t* ml_gol);
 
 /**
- * @brief Counts the number of alive neighbors for the given cell in the multilayer game of life.
+ * @brief Prints the rules of the layers and whether their kernels are specialized.
+ * 
+ * @param ml_gol The multilayer game of life structure
+ */
+void print_layers_rules(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Counts the number of alive neighbors for the given cell in the multilayer game of life,
+ * the alive cells of all the layers in the neighborhood of the dependent radius (the cell included).
  * 
  * @param ml_gol The multilayer game of life structure
  * @param i The row index
  * @param j The column index
  * @return The number of alive neighbors
  */
-uint8_t count_dependent_alive_neighbors(const ml_gol_t* ml_gol, uint64_t i, uint64_t j);
+uint16_t count_dependent_alive_neighbors(const ml_gol_t* ml_gol, uint64_t i, uint64_t j);
 
 /**
  * @brief Frees the memory allocated for the multilayer game of life structure.
  * 
  * @param ml_gol The multilayer game of life structure
  */
-void free_ml_gol(ml_gol_t* ml_gol);
+MLGOL_API void free_ml_gol(ml_gol_t* ml_gol);
 
 #endif
\ No newline at end of file
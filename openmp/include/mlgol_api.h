@@ -0,0 +1,8 @@
+#ifndef __MLGOL_API_H
+#define __MLGOL_API_H
+
+// the library is compiled with -fvisibility=hidden: only the functions declared with MLGOL_API are exported by libmlgol.so,
+// the others are internal to the library (the executable links the static library and sees all of them)
+#define MLGOL_API __attribute__((visibility("default")))
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef __PATTERN_H
+#define __PATTERN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ml_gol.h"
+#include "mlgol_api.h"
+
+// bodies of RLE patterns of at least this many bytes are decoded in parallel, in chunks of about PATTERN_CHUNK_SIZE bytes
+#define PARALLEL_DECODE_SIZE (1 << 20)
+#define PATTERN_CHUNK_SIZE (1 << 16)
+
+#define MAX_WORKLOAD_LINE_LENGTH 512
+#define MAX_PATTERN_PATH_LENGTH 1024
+
+/**
+ * @brief Structure to represent a pattern, a rectangle of cells stored row by row (1 alive, 0 dead).
+ */
+typedef struct {
+    uint64_t width;
+    uint64_t height;
+    uint8_t* cells;
+} pattern_t;
+
+/**
+ * @brief Decodes a pattern in the RLE format: optional comment lines starting with '#', the header line
+ * x = <width>, y = <height>[, rule = <rule>] and the runs of cells up to '!', as <count><tag> with the count optional (1).
+ * The tags are 'b' (or '.') for dead cells, '$' for the end of a row and any other letter for alive cells (the states of
+ * the multi-state rules are all alive). The rule of the header is ignored, the rules are the ones of the layers.
+ * Large bodies (PARALLEL_DECODE_SIZE bytes) are split in chunks decoded in parallel: the chunks first measure how far
+ * they move the position of the cells, a scan of these moves gives the starting position of each chunk, then they write their cells.
+ *
+ * @param text The text of the pattern
+ * @param length The length of the text
+ * @param pattern The pattern, it must be freed with free_pattern
+ * @return 0 on success, -1 if the text is not a valid RLE pattern (e.g. cells outside of the size of the header)
+ */
+MLGOL_API int parse_rle_pattern(const char* text, size_t length, pattern_t* pattern);
+
+/**
+ * @brief Decodes a pattern in the plaintext format: optional comment lines starting with '!' and one line per row,
+ * with 'O' (or '*') for alive cells and '.' for dead cells. The width is the one of the longest row, the rows are decoded in parallel.
+ *
+ * @param text The text of the pattern
+ * @param length The length of the text
+ * @param pattern The pattern, it must be freed with free_pattern
+ * @return 0 on success, -1 if the text is not a valid plaintext pattern
+ */
+MLGOL_API int parse_plaintext_pattern(const char* text, size_t length, pattern_t* pattern);
+
+/**
+ * @brief Reads a pattern file, in the RLE format if its first line that is not a comment is the header (x = ...), in the plaintext one otherwise.
+ *
+ * @param filename The name of the file
+ * @param pattern The pattern, it must be freed with free_pattern
+ * @return 0 on success, -1 if the file could not be read or is not a valid pattern
+ */
+MLGOL_API int load_pattern(const char* filename, pattern_t* pattern);
+
+/**
+ * @brief Frees the memory allocated for the pattern.
+ *
+ * @param pattern The pattern
+ */
+MLGOL_API void free_pattern(pattern_t* pattern);
+
+/**
+ * @brief Places a pattern in a layer with its top left cell at the given cell (from 0), wrapping around the torus.
+ * The alive cells of the pattern are added to the ones of the layer, its dead cells leave the layer as it is (e.g. a background soup).
+ * The rows are written in parallel. The layer must be refreshed afterwards (see refresh_ml_gol).
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer
+ * @param pattern The pattern
+ * @param row The row of the top left cell
+ * @param col The column of the top left cell
+ * @return 0 on success, -1 if the pattern is larger than the grid
+ */
+MLGOL_API int place_pattern(ml_gol_t* ml_gol, uint64_t layer, const pattern_t* pattern, uint64_t row, uint64_t col);
+
+/**
+ * @brief Places copies of a pattern in a layer, every row_spacing rows and col_spacing columns starting from the given cell,
+ * as many as fit in the grid without wrapping onto each other.
+ * The layer must be refreshed afterwards (see refresh_ml_gol).
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer
+ * @param pattern The pattern
+ * @param row_spacing The rows between the top left cells of two copies, at least the height of the pattern
+ * @param col_spacing The columns between the top left cells of two copies, at least the width of the pattern
+ * @param row The row of the top left cell of the first copy
+ * @param col The column of the top left cell of the first copy
+ * @return 0 on success, -1 if the copies would overlap
+ */
+MLGOL_API int tile_pattern(ml_gol_t* ml_gol, uint64_t layer, const pattern_t* pattern, uint64_t row_spacing, uint64_t col_spacing, uint64_t row, uint64_t col);
+
+/**
+ * @brief Replaces the cells of a layer with a random soup of the given density (0 clears the layer).
+ * The layer must be refreshed afterwards (see refresh_ml_gol).
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer
+ * @param density The density of the soup
+ * @param seed The seed of the random number generator
+ */
+MLGOL_API void fill_soup(ml_gol_t* ml_gol, uint64_t layer, float density, uint64_t seed);
+
+/**
+ * @brief Sets the initial state of the layers from a workload file and refreshes the multilayer game of life.
+ *
+ * The workload file has one command per line, applied in order:
+ * soup <layer> <density> <seed>
+ * place <layer> <pattern_file> <row> <col>
+ * tile <layer> <pattern_file> <row_spacing> <col_spacing> [<row> <col>]
+ * The layer is a number, taken modulo the number of layers, or '*' for all of them (the seed of the soup is then increased by the layer).
+ * The rows, columns and spacings are numbers of cells or percentages of the grid size (e.g. 50%).
+ * The paths of the patterns are relative to the directory of the workload file.
+ * Empty lines and lines starting with '#' are ignored.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param filename The name of the workload file
+ * @return 0 on success, -1 if the file or a pattern could not be read or a command is not valid
+ */
+MLGOL_API int load_workload(ml_gol_t* ml_gol, const char* filename);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __PERFCHECK_H
+#define __PERFCHECK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// states hashed in each workload: the initial one and the ones at 1/4, 1/2, 3/4 and all the steps
+#define PERF_CHECKPOINTS 5
+
+// the largest number of layers of a workload
+#define PERF_MAX_LAYERS 8
+
+// hashes of a state: the combined grid, the dependent grid and the layers
+#define PERF_MAX_HASHES (2 + PERF_MAX_LAYERS)
+
+#define PERF_NAME_LENGTH 32
+
+// repetitions of the timing of a workload, interleaved with the other workloads, the median one is kept
+#define PERF_REPETITIONS 5
+
+// seconds stepped by each repetition at least, the steps of a workload are run again from its initial state until they add up to it
+#define PERF_MIN_TIME 0.25
+
+// a time per step is a regression when it is above the baseline by more than the tolerance and this many times the noise of the timings
+#define PERF_NOISE_FACTOR 3
+
+#define DEFAULT_PERF_TOLERANCE 0.1
+
+/**
+ * @brief Structure to represent a workload of the performance check.
+ * The rules are separated by ';' (a Larger than Life rule contains commas) and repeated over the layers, NULL for Conway's rule.
+ * The workload file, when it is not NULL, sets the initial state instead of the random soup (see load_workload), its path is relative
+ * to the openmp directory, where make perfcheck runs.
+ */
+typedef struct {
+    const char* name;
+    uint64_t grid_size;
+    uint64_t num_layers;
+    uint64_t num_steps;
+    uint64_t seed;
+    float density;
+    const char* rules;
+    uint64_t dependent_radius;
+    const char* workload_filename;
+} perf_workload_t;
+
+/**
+ * @brief Structure to represent the golden hashes of a state of a workload, a line of the golden file:
+ * <workload> <step> <combined> <dependent> <layer 0> ... <layer num_layers - 1>
+ * with the hashes (see state_hash.h) as 16 hexadecimal digits.
+ */
+typedef struct {
+    char name[PERF_NAME_LENGTH];
+    uint64_t step;
+    uint64_t num_hashes;
+    uint64_t hashes[PERF_MAX_HASHES];
+} perf_golden_t;
+
+/**
+ * @brief Returns the fixed matrix of workloads of the performance check.
+ *
+ * @param num_workloads The number of workloads
+ * @return The workloads
+ */
+const perf_workload_t* get_perf_workloads(uint64_t* num_workloads);
+
+/**
+ * @brief Runs the performance check: each workload is stepped with every schedule strategy and kernel and the hashes of its states
+ * at the checkpoints must match the golden file, a difference always fails the check. Then the workloads are timed with the default schedule
+ * and the threads of the baseline file (the median of PERF_REPETITIONS interleaved repetitions) and their time per step is compared with it:
+ * above the baseline by more than the tolerance and PERF_NOISE_FACTOR times the noise it is a warning, a failure in strict mode.
+ * The timings are not compared (a failure in strict mode) when the baseline was measured on another CPU model or with more threads
+ * than this machine has, they are only reported for the workloads without a baseline.
+ * The baseline file has a header line "# measured on <cpu model> with <threads> threads" and one line per workload:
+ * <workload> <seconds_per_step> <noise>. In both files empty lines and the other lines starting with '#' are ignored.
+ *
+ * @param golden_filename The golden file
+ * @param baseline_filename The baseline file
+ * @param tolerance The relative tolerance of the timings (e.g. 0.1 for 10%)
+ * @param strict Whether the timings that cannot be compared or are above the threshold fail the check
+ * @return 0 if all the checks pass, -1 otherwise
+ */
+int run_perfcheck(const char* golden_filename, const char* baseline_filename, double tolerance, bool strict);
+
+/**
+ * @brief Writes the golden and baseline files from the current build: the hashes of the default schedule, after checking that
+ * all the schedule strategies and kernels agree on them, and the timings of this machine with their noise.
+ *
+ * @param golden_filename The golden file
+ * @param baseline_filename The baseline file
+ * @return 0 on success, -1 if the schedules disagree or a file could not be written
+ */
+int update_perfcheck(const char* golden_filename, const char* baseline_filename);
+
+/**
+ * @brief Reads the golden hashes from a file.
+ *
+ * @param filename The name of the file
+ * @param golden The array of golden hashes, allocated by the function
+ * @return The number of golden hashes read, -1 on error
+ */
+int64_t read_perf_golden(const char* filename, perf_golden_t** golden);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef __PREVIEW_H
+#define __PREVIEW_H
+
+#include <stdint.h>
+
+#include "ml_gol.h"
+
+// folder (inside output) where the previews are written
+#define PREVIEW_FOLDER "preview"
+
+/**
+ * @brief Structure to represent the weights used to average the cells of a grid in the pixels of a smaller one.
+ *
+ * The pixel p receives the cells from first[p] (modulo the grid size, it can be negative) to first[p] + count[p] - 1,
+ * the weight of the k-th of them is weights[p * max_count + k].
+ * The weights of a pixel always sum to the same total, so that all the pixels are averages over the same area.
+ */
+typedef struct {
+    int64_t* first;
+    uint64_t* count;
+    uint32_t* weights;
+    uint64_t max_count;
+    uint64_t total;
+} preview_weights_t;
+
+/**
+ * @brief Structure to represent the downsampled previews of the combined and dependent grids.
+ *
+ * The level 0 has size pixels per side, each following level halves the side of the previous one (a mip pyramid).
+ * Every pixel of the level 0 is the exact average of the grid_size / size cells per side it covers, split between
+ * neighboring pixels when the sizes are not multiples: for the combined grid the density of each layer,
+ * for the dependent grid the mean number of alive cells in the neighborhood of the cells over all the layers
+ * (the square of the dependent radius when the previews are initialized).
+ * The previews are calculated from the layers, the full resolution combined and dependent grids are not used.
+ */
+typedef struct {
+    uint64_t grid_size;
+    uint64_t num_layers;
+    uint64_t size;
+    uint64_t num_levels;
+    preview_weights_t block_weights;
+    preview_weights_t neighborhood_weights;
+    float* layers_density;
+    float* dependent_density;
+    uint8_t* buffer;
+} preview_t;
+
+/**
+ * @brief Initializes the previews for the given multilayer game of life.
+ * The size is limited to the size of the grid and the levels stop when the side would be smaller than one pixel.
+ *
+ * @param preview The previews, they must be freed with free_preview
+ * @param ml_gol The multilayer game of life structure
+ * @param size The side of the level 0 in pixels
+ * @param num_levels The number of levels of the pyramid, 1 for the level 0 only
+ */
+void init_preview(preview_t* preview, const ml_gol_t* ml_gol, uint64_t size, uint64_t num_levels);
+
+/**
+ * @brief Returns the side in pixels of the given level.
+ *
+ * @param preview The previews
+ * @param level The level
+ * @return The side of the level
+ */
+uint64_t get_preview_level_size(const preview_t* preview, uint64_t level);
+
+/**
+ * @brief Calculates all the levels of the previews from the current state of the layers.
+ *
+ * @param preview The previews
+ * @param ml_gol The multilayer game of life structure
+ */
+void calculate_preview(preview_t* preview, const ml_gol_t* ml_gol);
+
+/**
+ * @brief Creates the PNG files of all the levels of the previews for the given step, in output/preview.
+ * The files are named combined<side>_<step>.png and dependent<side>_<step>.png.
+ *
+ * @param preview The previews
+ * @param ml_gol The multilayer game of life structure
+ * @param step The step number
+ */
+void create_png_for_preview(preview_t* preview, const ml_gol_t* ml_gol, uint64_t step);
+
+/**
+ * @brief Step callback that calculates the previews and creates their PNG files, the user data is the previews.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param user_data The previews
+ */
+void preview_step_callback(const ml_gol_t* ml_gol, void* user_data);
+
+/**
+ * @brief Frees the memory allocated for the previews.
+ *
+ * @param preview The previews
+ */
+void free_preview(preview_t* preview);
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef __REPLAY_H
+#define __REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ml_gol.h"
+#include "mlgol_api.h"
+
+// first bytes and version of a replay file
+#define REPLAY_MAGIC "MLGR"
+#define REPLAY_VERSION 1
+
+// types of the records of a replay file
+#define REPLAY_KEYFRAME 'K'
+#define REPLAY_DELTA 'D'
+
+#define DEFAULT_KEYFRAME_INTERVAL 64
+
+/**
+ * @brief Structure to represent a replay file being written, one record per step.
+ *
+ * The file starts with the header:
+ * <magic: 4 bytes> <version: uint32> <num_layers: uint64> <grid_size: uint64> <keyframe_interval: uint64>
+ * followed by the records:
+ * <type: 1 byte> <step: uint64> <payload_size: uint64> <payload>
+ * The payload of a keyframe has the cells of each layer packed in bits (row by row, 8 cells per byte, the first in the lowest bit).
+ * The payload of a delta has, for each layer, the number of runs and the runs of consecutive cells (row by row) that changed state
+ * since the previous step, each as the cells skipped since the end of the previous run and its length.
+ * The numbers of the delta payloads are unsigned LEB128 varints, all the others are in the byte order of the machine.
+ * The first record and the steps multiple of the keyframe interval are keyframes, the others are deltas.
+ */
+typedef struct {
+    FILE* fp;
+    uint64_t num_layers;
+    uint64_t grid_size;
+    uint64_t keyframe_interval;
+    uint64_t num_records;
+    uint8_t** payloads;
+    size_t* payload_sizes;
+    size_t* payload_capacities;
+} replay_writer_t;
+
+/**
+ * @brief Structure to represent a replay file being read.
+ *
+ * The records are indexed when the file is opened, the state of a step is reconstructed from the nearest keyframe
+ * before it in an internal multilayer game of life, so that its combined and dependent grids can be calculated.
+ */
+typedef struct {
+    FILE* fp;
+    uint64_t num_layers;
+    uint64_t grid_size;
+    uint64_t keyframe_interval;
+    uint64_t num_records;
+    uint8_t* record_types;
+    uint64_t* record_steps;
+    long* record_offsets;
+    uint64_t* record_sizes;
+    uint8_t* payload;
+    size_t payload_capacity;
+    int64_t current_record;
+    ml_gol_t* ml_gol;
+} replay_reader_t;
+
+/**
+ * @brief Opens a replay file for the given multilayer game of life and writes its header and the current state as a keyframe.
+ *
+ * @param writer The replay writer, it must be closed with close_replay_writer
+ * @param filename The name of the file
+ * @param ml_gol The multilayer game of life structure
+ * @param keyframe_interval The number of steps between two keyframes
+ * @return 0 on success, -1 if the file could not be opened
+ */
+MLGOL_API int open_replay_writer(replay_writer_t* writer, const char* filename, const ml_gol_t* ml_gol, uint64_t keyframe_interval);
+
+/**
+ * @brief Writes the record of the last step of the multilayer game of life.
+ * A delta must follow the record of the previous step, since it only has the cells changed by the step.
+ *
+ * @param writer The replay writer
+ * @param ml_gol The multilayer game of life structure
+ */
+MLGOL_API void write_replay_record(replay_writer_t* writer, const ml_gol_t* ml_gol);
+
+/**
+ * @brief Flushes and closes the replay file.
+ *
+ * @param writer The replay writer
+ */
+MLGOL_API void close_replay_writer(replay_writer_t* writer);
+
+/**
+ * @brief Step callback that writes a replay record, the user data is the replay writer.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param user_data The replay writer
+ */
+MLGOL_API void replay_step_callback(const ml_gol_t* ml_gol, void* user_data);
+
+/**
+ * @brief Opens a replay file and indexes its records, the state is positioned at the first step.
+ *
+ * @param reader The replay reader, it must be closed with close_replay_reader
+ * @param filename The name of the file
+ * @return 0 on success, -1 if the file could not be read or is not a replay file
+ */
+MLGOL_API int open_replay_reader(replay_reader_t* reader, const char* filename);
+
+/**
+ * @brief Returns the last step stored in the replay file.
+ *
+ * @param reader The replay reader
+ * @return The last step
+ */
+MLGOL_API uint64_t get_replay_last_step(const replay_reader_t* reader);
+
+/**
+ * @brief Reconstructs the state of the given step, from the nearest keyframe before it (or from the current step, if nearer),
+ * and calculates its combined and dependent grids.
+ *
+ * @param reader The replay reader
+ * @param step The step
+ * @return 0 on success, -1 if the step is not in the file or the file is corrupted
+ */
+MLGOL_API int seek_replay(replay_reader_t* reader, uint64_t step);
+
+/**
+ * @brief Returns the multilayer game of life with the state of the last step reconstructed by seek_replay.
+ * Its step is the reconstructed step, its grids can be read with the getters of ml_gol.h.
+ *
+ * @param reader The replay reader
+ * @return The multilayer game of life structure
+ */
+MLGOL_API const ml_gol_t* get_replay_ml_gol(const replay_reader_t* reader);
+
+/**
+ * @brief Closes the replay file and frees the memory allocated for the reader.
+ *
+ * @param reader The replay reader
+ */
+MLGOL_API void close_replay_reader(replay_reader_t* reader);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef __RULE_H
+#define __RULE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mlgol_api.h"
+
+/**
+ * @brief Structure to represent a Life-like or a Larger than Life rule.
+ *
+ * A Life-like rule (radius 1) is in the notation B<counts>/S<counts>: bit k of birth is set if a dead cell with k alive neighbors
+ * becomes alive, bit k of survive is set if an alive cell with k alive neighbors stays alive (k from 0 to 8).
+ * A Larger than Life rule counts the alive cells in the square of side 2 * radius + 1 around a cell (the cell itself only if middle is set),
+ * a dead cell becomes alive if the count is in [birth_min, birth_max] and an alive cell stays alive if it is in [survive_min, survive_max].
+ * The masks are only used with radius 1 and the ranges with a larger radius, the unused fields are 0.
+ */
+typedef struct {
+    uint16_t birth;
+    uint16_t survive;
+    uint8_t radius;
+    bool middle;
+    uint16_t birth_min;
+    uint16_t birth_max;
+    uint16_t survive_min;
+    uint16_t survive_max;
+} rule_t;
+
+// B3/S23, the rule of the game of life
+#define CONWAY_RULE ((rule_t){1 << 3, (1 << 2) | (1 << 3), 1, false, 0, 0, 0, 0})
+
+// largest radius of a Larger than Life rule
+#define MAX_RULE_RADIUS 10
+
+// length of a buffer for any rule string, the longest valid one is R10,C0,M0,S441..441,B441..441,NM,
+// with room for the largest values of the fields and the terminator
+#define MAX_RULE_LENGTH 48
+
+/**
+ * @brief Parses a rule in the notation B<counts>/S<counts>, e.g. B36/S23 (HighLife) or B2/S (Seeds),
+ * or a Larger than Life rule in the notation of Golly R<radius>,C0,M<0|1>,S<min>..<max>,B<min>..<max>,NM, e.g. R5,C0,M1,S34..58,B34..45,NM (Bosco's rule).
+ * The letters can be lowercase, the counts of each part can be in any order. The C, M and N parts can be omitted,
+ * a single count can be given instead of a range. A Larger than Life rule of radius 1 is parsed as the Life-like rule with the same counts.
+ *
+ * @param string The rule string
+ * @param rule The parsed rule
+ * @return 0 on success, -1 if the string is not a valid rule
+ */
+MLGOL_API int parse_rule(const char* string, rule_t* rule);
+
+/**
+ * @brief Writes a rule in the notation B<counts>/S<counts>, with the counts in increasing order,
+ * or in the notation of Golly if it is a Larger than Life rule.
+ *
+ * @param rule The rule
+ * @param string The buffer, at least MAX_RULE_LENGTH characters
+ */
+MLGOL_API void rule_to_string(rule_t rule, char* string);
+
+/**
+ * @brief Returns whether two rules are the same.
+ *
+ * @param a The first rule
+ * @param b The second rule
+ * @return true if the rules are the same
+ */
+MLGOL_API bool rules_equal(rule_t a, rule_t b);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef __SCALING_H
+#define __SCALING_H
+
+#include <stdint.h>
+
+#include "scheduler.h"
+
+// bytes moved by the update of a cell: the cell read from the current grid and written to the next one,
+// counted like the STREAM benchmark counts its arrays (the reads of the write allocations are not counted)
+#define BYTES_PER_CELL_UPDATE 2
+
+// elements of each array of the bandwidth probe, 128 MiB per array, much larger than the last level caches
+#define STREAM_ARRAY_SIZE (1 << 24)
+
+/**
+ * @brief Structure to represent a point of a scaling study, a configuration timed with a given number of threads.
+ *
+ * The step time is the best time per step over a few repetitions, with the strategy predicted by the cost model for the number of threads.
+ * With strong scaling the speedup is the time with one thread over the time of the point and the efficiency is the speedup over the threads.
+ * With weak scaling the grid grows with the threads (the cells per thread are the same) and the speedup is scaled:
+ * the work of the point over the work with one thread (the threads, up to the rounding of the grid size) times the time
+ * with one thread over the time of the point, the efficiency is the speedup over the threads.
+ * The bandwidth is the memory traffic of the cell updates (BYTES_PER_CELL_UPDATE per update) per second,
+ * the STREAM bandwidth is the one of the bandwidth probe with the same number of threads.
+ */
+typedef struct {
+    int num_threads;
+    uint64_t grid_size;
+    schedule_t schedule;
+    double step_time;
+    double speedup;
+    double efficiency;
+    double cell_updates_per_second;
+    double bandwidth;
+    double stream_bandwidth;
+} scaling_point_t;
+
+/**
+ * @brief Structure to represent the results of a scaling study, a strong and a weak scaling point for each number of threads.
+ * The grid size is the one of the strong scaling points and of the weak scaling point with one thread.
+ */
+typedef struct {
+    uint64_t grid_size;
+    uint64_t num_layers;
+    uint64_t num_steps;
+    int max_threads;
+    uint64_t num_points;
+    scaling_point_t* strong;
+    scaling_point_t* weak;
+} scaling_report_t;
+
+/**
+ * @brief Measures the memory bandwidth of the machine with the given number of threads, like the triad of the STREAM benchmark
+ * (a[i] = b[i] + s * c[i] on arrays of STREAM_ARRAY_SIZE doubles), the best of a few repetitions.
+ *
+ * @param num_threads The number of threads
+ * @return The bandwidth in GB/s
+ */
+double measure_stream_bandwidth(int num_threads);
+
+/**
+ * @brief Runs a strong and a weak scaling study in this process, for 1, the powers of two and the maximum number of threads.
+ * The steps do not calculate the combined and dependent grids, as the runs without outputs.
+ *
+ * @param report The report, it must be freed with free_scaling_report
+ * @param grid_size The size of the grid (of the weak scaling with one thread)
+ * @param num_layers The number of layers
+ * @param num_steps The number of steps timed for each point
+ * @param max_threads The maximum number of threads
+ */
+void run_scaling_study(scaling_report_t* report, uint64_t grid_size, uint64_t num_layers, uint64_t num_steps, int max_threads);
+
+/**
+ * @brief Writes the report of a scaling study as a JSON file, with the machine, the configuration and the points of the two studies.
+ *
+ * @param filename The name of the file
+ * @param report The report
+ * @return 0 on success, -1 if the file could not be opened
+ */
+int write_scaling_report(const char* filename, const scaling_report_t* report);
+
+/**
+ * @brief Frees the memory allocated for the report.
+ *
+ * @param report The report
+ */
+void free_scaling_report(scaling_report_t* report);
+
+#endif
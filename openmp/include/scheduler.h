@@ -0,0 +1,121 @@
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+#include <stdint.h>
+
+#include "game_of_life.h"
+#include "mlgol_api.h"
+
+/**
+ * @brief The ways the work of a step can be split among the threads.
+ *
+ * SCHEDULE_LAYERS: each thread steps whole layers, one parallel region for the layers and one for the derived grids.
+ * SCHEDULE_ROWS: the rows of all the layers are split among the threads, one parallel region per step.
+ * SCHEDULE_TILES: square tiles of all the layers are split among the threads, one parallel region per step.
+ * SCHEDULE_PERSISTENT: like SCHEDULE_ROWS, but a single parallel region is opened for the whole step loop.
+ * SCHEDULE_TASKS: a graph of tasks on bands of rows, the derived grids of a band start as soon as the bands around it are stepped
+ * in all the layers and, without step callbacks, the next step of a band as soon as the previous one no longer needs it.
+ */
+typedef enum {
+    SCHEDULE_LAYERS,
+    SCHEDULE_ROWS,
+    SCHEDULE_TILES,
+    SCHEDULE_PERSISTENT,
+    SCHEDULE_TASKS
+} schedule_strategy_t;
+
+#define NUM_SCHEDULE_STRATEGIES 5
+
+// rows of the bands of SCHEDULE_TASKS, a multiple of the activity tiles so that each band owns the flags of its tiles
+#define TASK_BAND_ROWS ACTIVITY_TILE_SIZE
+
+// steps of a graph of SCHEDULE_TASKS at most, the representations of the layers are chosen again between two graphs
+#define TASK_GRAPH_STEPS 64
+
+/**
+ * @brief Structure to represent how a step is executed.
+ * The tile size is only used by SCHEDULE_TILES, the kernel is used to step all the layers.
+ */
+typedef struct {
+    schedule_strategy_t strategy;
+    int num_threads;
+    uint64_t tile_size;
+    kernel_t kernel;
+} schedule_t;
+
+/**
+ * @brief Structure to represent the measured costs used to predict the time of a step.
+ *
+ * The fork-join and barrier times are measured for every thread count from 1 to max_threads (index 0 is unused).
+ * The cell times are the serial times to step one cell of one layer and to calculate its share of the derived grids.
+ */
+typedef struct {
+    int max_threads;
+    double* fork_join_time;
+    double* barrier_time;
+    double step_cell_time;
+    double derived_cell_time;
+} cost_model_t;
+
+/**
+ * @brief Measures the costs of the machine with micro benchmarks, it takes a few milliseconds.
+ * The cell times are measured with the kernel of the default schedule.
+ *
+ * @param model The cost model, it must be freed with free_cost_model
+ * @param max_threads The maximum number of threads that can be chosen
+ */
+void measure_cost_model(cost_model_t* model, int max_threads);
+
+/**
+ * @brief Frees the memory allocated for the cost model.
+ *
+ * @param model The cost model
+ */
+void free_cost_model(cost_model_t* model);
+
+/**
+ * @brief Predicts the time of one step with the given schedule.
+ *
+ * @param model The cost model
+ * @param schedule The schedule
+ * @param grid_size The size of the grid
+ * @param num_layers The number of layers
+ * @return The predicted time in seconds
+ */
+double predict_step_time(const cost_model_t* model, schedule_t schedule, uint64_t grid_size, uint64_t num_layers);
+
+/**
+ * @brief Chooses the strategy and the number of threads with the lowest predicted time of a step.
+ *
+ * @param model The cost model
+ * @param grid_size The size of the grid
+ * @param num_layers The number of layers
+ * @return The chosen schedule
+ */
+schedule_t choose_schedule(const cost_model_t* model, uint64_t grid_size, uint64_t num_layers);
+
+/**
+ * @brief Returns the default schedule: whole layers split among all the available threads, stepped with the wrap kernel.
+ *
+ * @return The default schedule
+ */
+MLGOL_API schedule_t default_schedule(void);
+
+/**
+ * @brief Returns the name of the given strategy.
+ *
+ * @param strategy The strategy
+ * @return The name of the strategy
+ */
+MLGOL_API const char* schedule_strategy_name(schedule_strategy_t strategy);
+
+/**
+ * @brief Parses the name of a strategy.
+ *
+ * @param name The name of the strategy
+ * @param strategy The parsed strategy
+ * @return 0 on success, -1 if the name is unknown
+ */
+MLGOL_API int parse_schedule_strategy(const char* name, schedule_strategy_t* strategy);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef __STATE_HASH_H
+#define __STATE_HASH_H
+
+#include <stdint.h>
+
+#include "ml_gol.h"
+#include "mlgol_api.h"
+
+// parameters of the 64 bit FNV-1a hash
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/**
+ * @brief Hashes the given bytes with FNV-1a, continuing from the given hash (FNV_OFFSET_BASIS for a new hash).
+ *
+ * @param hash The hash of the previous bytes
+ * @param data The bytes
+ * @param length The number of bytes
+ * @return The hash
+ */
+MLGOL_API uint64_t fnv1a_hash(uint64_t hash, const void* data, uint64_t length);
+
+/**
+ * @brief Hashes the current grid of a layer, the grid_size * grid_size cells row by row (one byte each, 0 or 1).
+ * The hash does not depend on the layout of the grids (padding and ghost cells), on the schedule or on the kernel.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param layer The layer number
+ * @return The hash
+ */
+MLGOL_API uint64_t hash_layer_state(const ml_gol_t* ml_gol, uint64_t layer);
+
+/**
+ * @brief Hashes the combined grid, the r, g and b bytes of the pixels row by row.
+ * The combined grid must be up to date (see set_derived_grids).
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @return The hash
+ */
+MLGOL_API uint64_t hash_combined_state(const ml_gol_t* ml_gol);
+
+/**
+ * @brief Hashes the dependent grid, the r, g and b bytes of the pixels row by row.
+ * The dependent grid must be up to date (see set_derived_grids).
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @return The hash
+ */
+MLGOL_API uint64_t hash_dependent_state(const ml_gol_t* ml_gol);
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ml_gol.h"
+
+/**
+ * @brief The formats of the stats file.
+ *
+ * STATS_CSV: one line per step with the stats of each layer and a summary of the dependent histogram.
+ * STATS_BINARY: a header followed by one fixed size record per step with the stats of each layer and the whole dependent histogram.
+ * The dependent histogram is only written every histogram interval steps, the other records have an empty summary (CSV) or a zero histogram (binary).
+ */
+typedef enum {
+    STATS_CSV,
+    STATS_BINARY
+} stats_format_t;
+
+// first bytes and version of a binary stats file
+#define STATS_MAGIC "MLGS"
+#define STATS_VERSION 2
+
+// steps between two records with the dependent histogram, when it is not given
+#define DEFAULT_STATS_HISTOGRAM_INTERVAL 16
+
+/**
+ * @brief Structure to represent a stream of stats records, one per step.
+ *
+ * The binary file starts with the header:
+ * <magic: 4 bytes> <version: uint32> <num_layers: uint64> <grid_size: uint64> <bins: uint64> <histogram_interval: uint64>
+ * followed by the records:
+ * <step: uint64> <alive, births, deaths, changed_tiles: uint64 for each layer> <histogram: bins uint64>
+ * All the values are in the byte order of the machine that wrote the file.
+ */
+typedef struct {
+    FILE* fp;
+    stats_format_t format;
+    uint64_t num_layers;
+    uint64_t bins;
+    uint64_t histogram_interval;
+    uint64_t* record;
+} stats_writer_t;
+
+/**
+ * @brief Opens a stats file for the given multilayer game of life and writes its header.
+ * The format is binary if the name ends with ".bin", CSV otherwise.
+ * The dependent histogram is calculated from scratch for the records that have it when the derived grids are disabled,
+ * so the histogram interval trades its resolution in time for the cost of the stats.
+ *
+ * @param writer The stats writer, it must be closed with close_stats_writer
+ * @param filename The name of the file
+ * @param ml_gol The multilayer game of life structure
+ * @param histogram_interval The steps between two records with the dependent histogram, 0 for the default
+ * @return 0 on success, -1 if the file could not be opened
+ */
+int open_stats_writer(stats_writer_t* writer, const char* filename, const ml_gol_t* ml_gol, uint64_t histogram_interval);
+
+/**
+ * @brief Writes the stats of the last step of the multilayer game of life.
+ *
+ * @param writer The stats writer
+ * @param ml_gol The multilayer game of life structure
+ */
+void write_stats_record(stats_writer_t* writer, const ml_gol_t* ml_gol);
+
+/**
+ * @brief Flushes and closes the stats file.
+ *
+ * @param writer The stats writer
+ */
+void close_stats_writer(stats_writer_t* writer);
+
+/**
+ * @brief Step callback that writes a stats record, the user data is the stats writer.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param user_data The stats writer
+ */
+void stats_step_callback(const ml_gol_t* ml_gol, void* user_data);
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "game_of_life.h"
+
+// maximum length of the path of a unix socket, the size of sun_path
+#define TELEMETRY_PATH_LENGTH 108
+
+// milliseconds the server waits for a connection before it checks whether it has to stop
+#define TELEMETRY_POLL_INTERVAL 100
+
+/**
+ * @brief Structure to represent the progress of a run, published for a telemetry server.
+ *
+ * The counters are written by the thread that completes the steps (one at a time) with relaxed atomic stores and read
+ * by the server with relaxed atomic loads: the compute path never waits for the server, and a snapshot may mix the values
+ * of two consecutive steps. The times are in nanoseconds since the start of the run and the phases split its time:
+ * setup is the time before the first step, compute the time of the steps (the layers and the derived grids)
+ * and outputs the time of the step callbacks. The last mark is the end of the last recorded phase, it is only used by the writer.
+ */
+typedef struct telemetry {
+    uint64_t num_layers;
+    uint64_t num_steps;
+    double start_time;
+    uint64_t last_mark;
+    _Atomic uint64_t step;
+    _Atomic uint64_t last_step_time;
+    _Atomic uint64_t setup_time;
+    _Atomic uint64_t compute_time;
+    _Atomic uint64_t outputs_time;
+    _Atomic uint64_t* alive;
+    int socket_fd;
+    pthread_t server;
+    atomic_bool running;
+    char socket_path[TELEMETRY_PATH_LENGTH];
+} telemetry_t;
+
+/**
+ * @brief Initializes the telemetry of a run, its start time is now.
+ * It must be freed with free_telemetry.
+ *
+ * @param telemetry The telemetry
+ * @param num_layers The number of layers
+ * @param num_steps The last step of the run
+ */
+void init_telemetry(telemetry_t* telemetry, uint64_t num_layers, uint64_t num_steps);
+
+/**
+ * @brief Marks the end of the setup, the time since the start is the setup time.
+ *
+ * @param telemetry The telemetry
+ */
+void begin_telemetry_steps(telemetry_t* telemetry);
+
+/**
+ * @brief Records a completed step: its number, the alive cells of the layers and the time since the last mark as compute time.
+ *
+ * @param telemetry The telemetry
+ * @param step The step
+ * @param layers The layers, with the stats of the step
+ */
+void record_step_telemetry(telemetry_t* telemetry, uint64_t step, const gol_t* layers);
+
+/**
+ * @brief Records the end of the outputs of a step, the time since the last mark is output time.
+ *
+ * @param telemetry The telemetry
+ */
+void record_outputs_telemetry(telemetry_t* telemetry);
+
+/**
+ * @brief Writes a snapshot of the telemetry as a JSON object on one line: the step, the steps per second, the times of the phases,
+ * the alive cells per layer, the memory of the process and the estimated time to completion.
+ *
+ * @param fp The file
+ * @param telemetry The telemetry
+ */
+void write_telemetry_json(FILE* fp, const telemetry_t* telemetry);
+
+/**
+ * @brief Starts a thread that listens on a unix socket and writes a snapshot to each connection, then closes it.
+ * A file already at the path (e.g. the socket of a previous run) is replaced.
+ *
+ * @param telemetry The telemetry
+ * @param socket_path The path of the socket
+ * @return 0 on success, -1 if the socket could not be created
+ */
+int start_telemetry_server(telemetry_t* telemetry, const char* socket_path);
+
+/**
+ * @brief Stops the server thread and removes the socket.
+ *
+ * @param telemetry The telemetry
+ */
+void stop_telemetry_server(telemetry_t* telemetry);
+
+/**
+ * @brief Frees the memory allocated for the telemetry, the server must be stopped.
+ *
+ * @param telemetry The telemetry
+ */
+void free_telemetry(telemetry_t* telemetry);
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef __VIEWPORT_H
+#define __VIEWPORT_H
+
+#include <stdint.h>
+
+struct ml_gol;
+
+// folder (inside output) where the viewports are written
+#define VIEWPORT_FOLDER "viewport"
+
+// maximum number of viewports of a run
+#define MAX_VIEWPORTS 16
+
+/**
+ * @brief Structure to represent a rectangular region of the grid.
+ * The first row and column start from 0, the region wraps across the edges of the torus
+ * when it goes beyond the last row or column.
+ */
+typedef struct {
+    uint64_t row;
+    uint64_t col;
+    uint64_t height;
+    uint64_t width;
+} viewport_t;
+
+/**
+ * @brief Structure to represent the output of a set of viewports, with a pixel buffer as large as the largest of them.
+ */
+typedef struct {
+    viewport_t viewports[MAX_VIEWPORTS];
+    uint64_t num_viewports;
+    uint8_t* buffer;
+} viewport_output_t;
+
+/**
+ * @brief Parses a viewport with the format <row>,<col>,<height>,<width>.
+ *
+ * @param spec The string to parse
+ * @param viewport The parsed viewport
+ * @return 0 on success, -1 if the format is invalid
+ */
+int parse_viewport(const char* spec, viewport_t* viewport);
+
+/**
+ * @brief Initializes the output of the given viewports.
+ * The viewports larger than the grid are limited to its size and their first row and column are taken modulo its size.
+ *
+ * @param output The output of the viewports, it must be freed with free_viewport_output
+ * @param ml_gol The multilayer game of life structure
+ * @param viewports The viewports
+ * @param num_viewports The number of viewports, at most MAX_VIEWPORTS
+ */
+void init_viewport_output(viewport_output_t* output, const struct ml_gol* ml_gol, const viewport_t* viewports, uint64_t num_viewports);
+
+/**
+ * @brief Calculates the combined and dependent pixels of a viewport from the layers, as RGB triplets stored by rows.
+ * The full combined and dependent grids are not used.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param viewport The viewport
+ * @param combined The buffer for the combined pixels, NULL to skip them
+ * @param dependent The buffer for the dependent pixels, NULL to skip them
+ */
+void calculate_viewport(const struct ml_gol* ml_gol, viewport_t viewport, uint8_t* combined, uint8_t* dependent);
+
+/**
+ * @brief Creates the PNG files of all the viewports for the given step, in output/viewport.
+ * The files are named combined<k>_<step>.png and dependent<k>_<step>.png, k is the index of the viewport.
+ *
+ * @param output The output of the viewports
+ * @param ml_gol The multilayer game of life structure
+ * @param step The step number
+ */
+void create_png_for_viewports(viewport_output_t* output, const struct ml_gol* ml_gol, uint64_t step);
+
+/**
+ * @brief Step callback that creates the PNG files of the viewports, the user data is the output of the viewports.
+ *
+ * @param ml_gol The multilayer game of life structure
+ * @param user_data The output of the viewports
+ */
+void viewports_step_callback(const struct ml_gol* ml_gol, void* user_data);
+
+/**
+ * @brief Frees the memory allocated for the output of the viewports.
+ *
+ * @param output The output of the viewports
+ */
+void free_viewport_output(viewport_output_t* output);
+
+#endif
@@ -0,0 +1,235 @@
+#include "autotune.h"
+#include "ml_gol.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+#define DEFAULT_TUNING_CACHE ".mlgol_tuning"
+
+// steps timed for each candidate, after one step of warm up
+#define TUNING_STEPS 3
+
+#define CPU_MODEL_LENGTH 128
+#define LINE_LENGTH 512
+
+static const uint64_t TILE_SIZES[] = { 16, 32, 64, 128, 256 };
+#define NUM_TILE_SIZES (sizeof(TILE_SIZES) / sizeof(TILE_SIZES[0]))
+
+const char* tuning_cache_filename(void) {
+    const char* filename = getenv("MLGOL_TUNING_CACHE");
+    return filename ? filename : DEFAULT_TUNING_CACHE;
+}
+
+void get_cpu_model(char* model, const size_t length) {
+    snprintf(model, length, "unknown");
+
+    FILE* fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) {
+        return;
+    }
+
+    char line[LINE_LENGTH];
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "model name", 10) != 0) {
+            continue;
+        }
+
+        char* value = strchr(line, ':');
+        if (value) {
+            // skip ": " and drop the newline
+            value += strspn(value + 1, " ") + 1;
+            value[strcspn(value, "\r\n")] = '\0';
+            snprintf(model, length, "%s", value);
+        }
+        break;
+    }
+
+    fclose(fp);
+}
+
+static double time_schedule(ml_gol_t* ml_gol, const schedule_t schedule) {
+    set_schedule(ml_gol, schedule);
+
+    step_ml_gol(ml_gol, 1);
+
+    double tstart = omp_get_wtime();
+    step_ml_gol(ml_gol, TUNING_STEPS);
+
+    return (omp_get_wtime() - tstart) / TUNING_STEPS;
+}
+
+static void try_schedule(ml_gol_t* ml_gol, const schedule_t candidate, schedule_t* best, double* best_time) {
+    double time = time_schedule(ml_gol, candidate);
+
+    printf("  %-10s %3d threads  tile %3ld  %-10s  %.6f s/step\n",
+        schedule_strategy_name(candidate.strategy), candidate.num_threads, candidate.tile_size, kernel_name(candidate.kernel), time);
+
+    if (time < *best_time) {
+        *best = candidate;
+        *best_time = time;
+    }
+}
+
+schedule_t autotune_schedule(const uint64_t grid_size, const uint64_t num_layers, const int max_threads) {
+    ml_gol_t* ml_gol = create_ml_gol(grid_size, num_layers, 0.3, 1);
+
+    cost_model_t model;
+    measure_cost_model(&model, max_threads);
+    schedule_t best = choose_schedule(&model, grid_size, num_layers);
+    free_cost_model(&model);
+
+    double best_time = time_schedule(ml_gol, best);
+
+    // kernels, with the schedule predicted by the cost model
+    schedule_t candidate = best;
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        candidate.kernel = (kernel_t) k;
+        try_schedule(ml_gol, candidate, &best, &best_time);
+    }
+
+    // strategies and thread counts, with the fastest kernel
+    candidate = best;
+    for (int t = 1; t <= max_threads; t = (t < max_threads && t * 2 > max_threads) ? max_threads : t * 2) {
+        for (int s = 0; s < NUM_SCHEDULE_STRATEGIES; s++) {
+            candidate.strategy = (schedule_strategy_t) s;
+            candidate.num_threads = t;
+            try_schedule(ml_gol, candidate, &best, &best_time);
+        }
+
+        if (t == max_threads) {
+            break;
+        }
+    }
+
+    // tile sizes, only meaningful when the tiles are the fastest
+    if (best.strategy == SCHEDULE_TILES) {
+        candidate = best;
+        for (uint64_t k = 0; k < NUM_TILE_SIZES && TILE_SIZES[k] <= grid_size; k++) {
+            candidate.tile_size = TILE_SIZES[k];
+            try_schedule(ml_gol, candidate, &best, &best_time);
+        }
+    }
+
+    free_ml_gol(ml_gol);
+
+    return best;
+}
+
+/**
+ * Parses a line of the cache file, the fields are separated by tabs:
+ * <cpu_model> <grid_size> <num_layers> <strategy> <num_threads> <tile_size> <kernel>
+ */
+static int parse_tuning_line(char* line, char* cpu_model, uint64_t* grid_size, uint64_t* num_layers, schedule_t* schedule) {
+    char* fields[7];
+
+    line[strcspn(line, "\r\n")] = '\0';
+
+    char* save = NULL;
+    for (int f = 0; f < 7; f++) {
+        fields[f] = strtok_r(f == 0 ? line : NULL, "\t", &save);
+        if (!fields[f]) {
+            return -1;
+        }
+    }
+
+    snprintf(cpu_model, CPU_MODEL_LENGTH, "%s", fields[0]);
+    *grid_size = strtoull(fields[1], NULL, 10);
+    *num_layers = strtoull(fields[2], NULL, 10);
+    schedule->num_threads = atoi(fields[4]);
+    schedule->tile_size = strtoull(fields[5], NULL, 10);
+
+    if (parse_schedule_strategy(fields[3], &schedule->strategy) != 0 || parse_kernel(fields[6], &schedule->kernel) != 0) {
+        return -1;
+    }
+
+    if (schedule->num_threads < 1 || schedule->tile_size == 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int load_tuned_schedule(const char* filename, const uint64_t grid_size, const uint64_t num_layers, schedule_t* schedule) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    char cpu_model[CPU_MODEL_LENGTH];
+    get_cpu_model(cpu_model, sizeof(cpu_model));
+
+    char line[LINE_LENGTH];
+    int found = -1;
+
+    while (found != 0 && fgets(line, sizeof(line), fp)) {
+        char line_cpu_model[CPU_MODEL_LENGTH];
+        uint64_t line_grid_size, line_num_layers;
+        schedule_t line_schedule;
+
+        if (parse_tuning_line(line, line_cpu_model, &line_grid_size, &line_num_layers, &line_schedule) != 0) {
+            continue;
+        }
+
+        if (strcmp(line_cpu_model, cpu_model) == 0 && line_grid_size == grid_size && line_num_layers == num_layers) {
+            *schedule = line_schedule;
+            found = 0;
+        }
+    }
+
+    fclose(fp);
+
+    return found;
+}
+
+int save_tuned_schedule(const char* filename, const uint64_t grid_size, const uint64_t num_layers, const schedule_t schedule) {
+    char cpu_model[CPU_MODEL_LENGTH];
+    get_cpu_model(cpu_model, sizeof(cpu_model));
+
+    // the new file is written aside and then renamed, so that a concurrent reader never sees it half written
+    char tmp_filename[LINE_LENGTH];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+    FILE* out = fopen(tmp_filename, "w");
+    if (!out) {
+        fprintf(stderr, "Could not open file %s for writing\n", tmp_filename);
+        return -1;
+    }
+
+    // keep the entries of the other configurations
+    FILE* in = fopen(filename, "r");
+    if (in) {
+        char line[LINE_LENGTH];
+        char copy[LINE_LENGTH];
+
+        while (fgets(line, sizeof(line), in)) {
+            char line_cpu_model[CPU_MODEL_LENGTH];
+            uint64_t line_grid_size, line_num_layers;
+            schedule_t line_schedule;
+
+            memcpy(copy, line, sizeof(line));
+            if (parse_tuning_line(copy, line_cpu_model, &line_grid_size, &line_num_layers, &line_schedule) != 0) {
+                continue;
+            }
+
+            if (strcmp(line_cpu_model, cpu_model) != 0 || line_grid_size != grid_size || line_num_layers != num_layers) {
+                fputs(line, out);
+            }
+        }
+
+        fclose(in);
+    }
+
+    fprintf(out, "%s\t%lu\t%lu\t%s\t%d\t%lu\t%s\n",
+        cpu_model, grid_size, num_layers, schedule_strategy_name(schedule.strategy), schedule.num_threads, schedule.tile_size, kernel_name(schedule.kernel));
+
+    fclose(out);
+
+    if (rename(tmp_filename, filename) != 0) {
+        fprintf(stderr, "Could not write file %s\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "batch.h"
+#include "ml_gol.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <omp.h>
+
+typedef struct {
+    uint64_t cost;
+    uint64_t run;
+} run_order_t;
+
+static int compare_run_cost(const void* a, const void* b) {
+    const run_order_t* first = (const run_order_t*) a;
+    const run_order_t* second = (const run_order_t*) b;
+
+    // descending cost, ties broken by the position in the configuration file
+    if (first->cost != second->cost) {
+        return first->cost < second->cost ? 1 : -1;
+    }
+
+    return first->run < second->run ? -1 : (first->run > second->run);
+}
+
+static void execute_run(const run_config_t* config, ml_gol_buffers_t* buffers, run_result_t* result) {
+    double tstart = omp_get_wtime();
+
+    ml_gol_t ml_gol;
+    init_ml_gol_with_buffers(&ml_gol, buffers, config->grid_size, config->num_layers, config->density, config->seed);
+
+    // the threads are already used by the concurrent runs
+    schedule_t schedule = default_schedule();
+    schedule.num_threads = 1;
+    set_schedule(&ml_gol, schedule);
+
+    step_ml_gol(&ml_gol, config->num_steps - 1);
+
+    result->elapsed_time = omp_get_wtime() - tstart;
+    result->thread = omp_get_thread_num();
+
+    result->alive_cells = 0;
+    for (uint64_t layer = 0; layer < ml_gol.num_layers; layer++) {
+        result->alive_cells += count_alive_cells(&ml_gol.layers[layer]);
+    }
+
+    // the dependent grid is grayscale, one channel is enough
+    double dependent_sum = 0;
+    for (uint64_t i = 0; i < ml_gol.grid_size * ml_gol.grid_size; i++) {
+        dependent_sum += ml_gol.dependent[i].r;
+    }
+    result->mean_dependent = dependent_sum / (ml_gol.grid_size * ml_gol.grid_size);
+}
+
+int start_batch(const char* config_filename, const char* summary_filename) {
+    run_config_t* configs = NULL;
+    int64_t num_runs = read_run_configs(config_filename, &configs);
+
+    if (num_runs < 0) {
+        return -1;
+    }
+
+    printf("Starting batch of %ld runs with %d threads\n", num_runs, omp_get_max_threads());
+
+    run_result_t* results = (run_result_t*) malloc(num_runs * sizeof(run_result_t));
+
+    run_batch(configs, num_runs, results);
+    write_batch_summary(summary_filename, configs, results, num_runs);
+
+    printf("Summary written to %s\n", summary_filename);
+
+    free(results);
+    free(configs);
+
+    return 0;
+}
+
+int64_t read_run_configs(const char* filename, run_config_t** configs) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for reading\n", filename);
+        return -1;
+    }
+
+    char line[256];
+    uint64_t line_number = 0;
+    int64_t num_runs = 0;
+    int64_t capacity = 16;
+    *configs = (run_config_t*) malloc(capacity * sizeof(run_config_t));
+
+    while (fgets(line, sizeof(line), fp)) {
+        line_number++;
+
+        // skip leading spaces, empty lines and comments
+        const char* start = line + strspn(line, " \t");
+        if (*start == '\0' || *start == '\n' || *start == '#') {
+            continue;
+        }
+
+        run_config_t config;
+        int read = sscanf(start, "%lu %lu %lu %f %lu", &config.grid_size, &config.num_layers, &config.num_steps, &config.density, &config.seed);
+
+        if (read != 5 || config.grid_size == 0 || config.num_layers == 0 || config.num_layers > MAX_NUM_LAYERS || config.num_steps == 0) {
+            fprintf(stderr, "Invalid run configuration at %s:%lu\n", filename, line_number);
+            fclose(fp);
+            free(*configs);
+            *configs = NULL;
+            return -1;
+        }
+
+        if (num_runs == capacity) {
+            capacity *= 2;
+            *configs = (run_config_t*) realloc(*configs, capacity * sizeof(run_config_t));
+        }
+
+        (*configs)[num_runs++] = config;
+    }
+
+    fclose(fp);
+
+    return num_runs;
+}
+
+void run_batch(const run_config_t* configs, const uint64_t num_runs, run_result_t* results) {
+    // longest runs first, so that the short ones fill the gaps at the end of the batch
+    run_order_t* order = (run_order_t*) malloc(num_runs * sizeof(run_order_t));
+    for (uint64_t r = 0; r < num_runs; r++) {
+        order[r].cost = configs[r].grid_size * configs[r].grid_size * configs[r].num_layers * configs[r].num_steps;
+        order[r].run = r;
+    }
+    qsort(order, num_runs, sizeof(run_order_t), compare_run_cost);
+
+    // one set of buffers per thread, reused by all the runs executed by that thread
+    const int num_threads = omp_get_max_threads();
+    ml_gol_buffers_t* pool = (ml_gol_buffers_t*) calloc(num_threads, sizeof(ml_gol_buffers_t));
+
+#pragma omp parallel
+    {
+        ml_gol_buffers_t* buffers = &pool[omp_get_thread_num()];
+
+#pragma omp for schedule(dynamic, 1)
+        for (uint64_t r = 0; r < num_runs; r++) {
+            const uint64_t run = order[r].run;
+            execute_run(&configs[run], buffers, &results[run]);
+        }
+    }
+
+    for (int t = 0; t < num_threads; t++) {
+        free_ml_gol_buffers(&pool[t]);
+    }
+
+    free(pool);
+    free(order);
+}
+
+void write_batch_summary(const char* filename, const run_config_t* configs, const run_result_t* results, const uint64_t num_runs) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for writing\n", filename);
+        abort();
+    }
+
+    fprintf(fp, "run,grid_size,num_layers,num_steps,density,seed,alive_cells,mean_dependent,elapsed_time,thread\n");
+
+    for (uint64_t r = 0; r < num_runs; r++) {
+        fprintf(fp, "%lu,%lu,%lu,%lu,%f,%lu,%lu,%f,%f,%d\n",
+            r,
+            configs[r].grid_size,
+            configs[r].num_layers,
+            configs[r].num_steps,
+            configs[r].density,
+            configs[r].seed,
+            results[r].alive_cells,
+            results[r].mean_dependent,
+            results[r].elapsed_time,
+            results[r].thread
+        );
+    }
+
+    fclose(fp);
+}
@@ -0,0 +1,408 @@
+#include "frame_server.h"
+#include "image.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// milliseconds between two checks of the slot while a request waits for a frame
+#define FRAME_WAIT_INTERVAL 5
+
+static const char* FRAME_PAGE =
+    "<!DOCTYPE html>\n<html><head><title>Multilayer Game of Life</title></head>\n"
+    "<body style=\"background: #000; margin: 0\">\n"
+    "<img id=\"combined\" src=\"/combined\"> <img id=\"dependent\" src=\"/dependent\">\n"
+    "<script>\nsetInterval(() => {\n"
+    "    for (const id of ['combined', 'dependent']) {\n"
+    "        document.getElementById(id).src = '/' + id + '?t=' + Date.now();\n"
+    "    }\n}, 1000);\n</script>\n</body></html>\n";
+
+void init_frame_server(frame_server_t* frame_server, const ml_gol_t* ml_gol, const uint64_t frame_size) {
+    for (int f = 0; f < FRAME_BUFFERS; f++) {
+        init_preview(&frame_server->frames[f], ml_gol, frame_size, 1);
+        frame_server->frame_steps[f] = 0;
+    }
+
+    frame_server->num_layers = ml_gol->num_layers;
+    frame_server->frame_size = frame_server->frames[0].size;
+    frame_server->layers_colors = (color_t*) malloc(ml_gol->num_layers * sizeof(color_t));
+    memcpy(frame_server->layers_colors, ml_gol->layers_colors, ml_gol->num_layers * sizeof(color_t));
+
+    // one plane per layer and one for the dependent grid
+    frame_server->scaled_density = (float*) malloc((ml_gol->num_layers + 1) * frame_server->frame_size * frame_server->frame_size * sizeof(float));
+
+    // the simulation owns the back frame, the server the front one, the slot holds the other one
+    frame_server->back = 0;
+    frame_server->front = 2;
+    frame_server->has_frame = false;
+    atomic_init(&frame_server->slot, 1);
+    atomic_init(&frame_server->wanted, false);
+    atomic_init(&frame_server->running, false);
+
+    frame_server->socket_fd = -1;
+    frame_server->socket_path[0] = '\0';
+}
+
+void frame_server_step_callback(const ml_gol_t* ml_gol, void* user_data) {
+    frame_server_t* frame_server = (frame_server_t*) user_data;
+
+    if (!atomic_load_explicit(&frame_server->wanted, memory_order_relaxed)) {
+        return;
+    }
+
+    atomic_store_explicit(&frame_server->wanted, false, memory_order_relaxed);
+
+    calculate_preview(&frame_server->frames[frame_server->back], ml_gol);
+    frame_server->frame_steps[frame_server->back] = ml_gol->step;
+
+    // the release publishes the frame with the slot, the frame that was there (taken or not) is the next back frame
+    int previous = atomic_exchange_explicit(&frame_server->slot, frame_server->back | FRAME_FRESH, memory_order_acq_rel);
+    frame_server->back = previous & (FRAME_FRESH - 1);
+}
+
+/**
+ * Asks the simulation for a frame and waits for it up to FRAME_WAIT milliseconds, then takes the latest fresh frame as the front one.
+ * The front frame stays the previous one when no frame was published in time (e.g. the steps are slow).
+ */
+static void take_latest_frame(frame_server_t* frame_server) {
+    atomic_store_explicit(&frame_server->wanted, true, memory_order_relaxed);
+
+    for (int waited = 0; waited < FRAME_WAIT && atomic_load_explicit(&frame_server->running, memory_order_relaxed); waited += FRAME_WAIT_INTERVAL) {
+        if (atomic_load_explicit(&frame_server->slot, memory_order_relaxed) & FRAME_FRESH) {
+            break;
+        }
+
+        usleep(FRAME_WAIT_INTERVAL * 1000);
+    }
+
+    if (atomic_load_explicit(&frame_server->slot, memory_order_relaxed) & FRAME_FRESH) {
+        int fresh = atomic_exchange_explicit(&frame_server->slot, frame_server->front, memory_order_acq_rel);
+        frame_server->front = fresh & (FRAME_FRESH - 1);
+        frame_server->has_frame = true;
+    }
+}
+
+/**
+ * Averages the pixels of a square plane in the pixels of a smaller one, each pixel over the block of source pixels it covers.
+ */
+static void scale_plane(const float* source, const uint64_t source_size, float* destination, const uint64_t size) {
+    for (uint64_t p = 0; p < size; p++) {
+        const uint64_t first_row = p * source_size / size;
+        const uint64_t last_row = (p + 1) * source_size / size;
+
+        for (uint64_t q = 0; q < size; q++) {
+            const uint64_t first_col = q * source_size / size;
+            const uint64_t last_col = (q + 1) * source_size / size;
+            float sum = 0;
+
+            for (uint64_t i = first_row; i < last_row; i++) {
+                for (uint64_t j = first_col; j < last_col; j++) {
+                    sum += source[i * source_size + j];
+                }
+            }
+
+            destination[p * size + q] = sum / ((last_row - first_row) * (last_col - first_col));
+        }
+    }
+}
+
+static uint8_t to_channel(const double value) {
+    return value >= 255 ? 255 : (uint8_t) (value + 0.5);
+}
+
+/**
+ * Colors the front frame at the given size in its buffer, like the PNGs of the previews.
+ */
+static void render_frame(frame_server_t* frame_server, const bool dependent, const uint64_t size) {
+    preview_t* frame = &frame_server->frames[frame_server->front];
+    const uint64_t pixels = size * size;
+    float* scaled = frame_server->scaled_density;
+
+    if (dependent) {
+        scale_plane(frame->dependent_density, frame->size, scaled, size);
+
+        for (uint64_t pixel = 0; pixel < pixels; pixel++) {
+            uint8_t value = to_channel(scaled[pixel] * 255);
+
+            frame->buffer[pixel * 3] =     value;
+            frame->buffer[pixel * 3 + 1] = value;
+            frame->buffer[pixel * 3 + 2] = value;
+        }
+        return;
+    }
+
+    for (uint64_t layer = 0; layer < frame_server->num_layers; layer++) {
+        scale_plane(frame->layers_density + layer * frame->size * frame->size, frame->size, scaled + layer * pixels, size);
+    }
+
+    // the combined color is the sum of the colors of the layers, weighted by their density
+    for (uint64_t pixel = 0; pixel < pixels; pixel++) {
+        double r = 0, g = 0, b = 0;
+
+        for (uint64_t layer = 0; layer < frame_server->num_layers; layer++) {
+            double density = scaled[layer * pixels + pixel];
+
+            r += density * frame_server->layers_colors[layer].r;
+            g += density * frame_server->layers_colors[layer].g;
+            b += density * frame_server->layers_colors[layer].b;
+        }
+
+        frame->buffer[pixel * 3] =     to_channel(r);
+        frame->buffer[pixel * 3 + 1] = to_channel(g);
+        frame->buffer[pixel * 3 + 2] = to_channel(b);
+    }
+}
+
+/**
+ * Sends a whole HTTP response, without SIGPIPE: a viewer that already left must not stop the run.
+ */
+static void send_response(const int client, const char* status, const char* content_type, const int64_t step, const void* body, const size_t length) {
+    char header[256];
+    int header_length = snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\nCache-Control: no-store\r\n",
+        status, content_type, length);
+
+    if (step >= 0) {
+        header_length += snprintf(header + header_length, sizeof(header) - header_length, "X-Step: %ld\r\n", step);
+    }
+
+    header_length += snprintf(header + header_length, sizeof(header) - header_length, "\r\n");
+
+    if (send(client, header, header_length, MSG_NOSIGNAL) == header_length && length > 0) {
+        send(client, body, length, MSG_NOSIGNAL);
+    }
+}
+
+static void send_error(const int client, const char* status) {
+    send_response(client, status, "text/plain", -1, status, strlen(status));
+}
+
+/**
+ * Reads the request line of a connection, up to the end of the headers or MAX_FRAME_REQUEST_LENGTH bytes.
+ * Returns -1 if the viewer closed the connection or sent nothing in FRAME_REQUEST_TIMEOUT milliseconds.
+ */
+static int read_request(const int client, char* request) {
+    struct timeval timeout = { FRAME_REQUEST_TIMEOUT / 1000, (FRAME_REQUEST_TIMEOUT % 1000) * 1000 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    size_t length = 0;
+    while (length < MAX_FRAME_REQUEST_LENGTH - 1) {
+        ssize_t received = recv(client, request + length, MAX_FRAME_REQUEST_LENGTH - 1 - length, 0);
+        if (received <= 0) {
+            break;
+        }
+
+        length += (size_t) received;
+        request[length] = '\0';
+
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+            break;
+        }
+    }
+
+    request[length] = '\0';
+
+    return length > 0 ? 0 : -1;
+}
+
+/**
+ * Answers a request: the page, or a frame at the size of the query (the frame size by default).
+ */
+static void handle_request(frame_server_t* frame_server, const int client) {
+    char request[MAX_FRAME_REQUEST_LENGTH];
+    char path[MAX_FRAME_REQUEST_LENGTH];
+
+    if (read_request(client, request) != 0) {
+        return;
+    }
+
+    if (sscanf(request, "GET %1023s", path) != 1) {
+        send_error(client, "405 Method Not Allowed");
+        return;
+    }
+
+    char* query = strchr(path, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+
+    if (strcmp(path, "/") == 0) {
+        send_response(client, "200 OK", "text/html", -1, FRAME_PAGE, strlen(FRAME_PAGE));
+        return;
+    }
+
+    const bool dependent = strcmp(path, "/dependent") == 0;
+    if (!dependent && strcmp(path, "/combined") != 0) {
+        send_error(client, "404 Not Found");
+        return;
+    }
+
+    uint64_t size = frame_server->frame_size;
+    const char* size_parameter = query ? strstr(query, "size=") : NULL;
+
+    if (size_parameter && (size_parameter == query || size_parameter[-1] == '&') && isdigit((unsigned char) size_parameter[5])) {
+        size = strtoull(size_parameter + 5, NULL, 10);
+        size = size == 0 ? 1 : (size > frame_server->frame_size ? frame_server->frame_size : size);
+    }
+
+    take_latest_frame(frame_server);
+
+    if (!frame_server->has_frame) {
+        send_error(client, "503 Service Unavailable");
+        return;
+    }
+
+    render_frame(frame_server, dependent, size);
+
+    char* png = NULL;
+    size_t length = 0;
+    FILE* fp = open_memstream(&png, &length);
+
+    if (!fp) {
+        send_error(client, "500 Internal Server Error");
+        return;
+    }
+
+    int written = write_png_stream(fp, size, size, frame_server->frames[frame_server->front].buffer);
+    fclose(fp);
+
+    if (written == 0) {
+        send_response(client, "200 OK", "image/png", (int64_t) frame_server->frame_steps[frame_server->front], png, length);
+    } else {
+        send_error(client, "500 Internal Server Error");
+    }
+
+    free(png);
+}
+
+/**
+ * Answers the connections one at a time until the server is stopped.
+ */
+static void* frame_server_thread(void* data) {
+    frame_server_t* frame_server = (frame_server_t*) data;
+    struct pollfd listener = { .fd = frame_server->socket_fd, .events = POLLIN };
+
+    while (atomic_load_explicit(&frame_server->running, memory_order_relaxed)) {
+        if (poll(&listener, 1, FRAME_POLL_INTERVAL) <= 0) {
+            continue;
+        }
+
+        int client = accept(frame_server->socket_fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        handle_request(frame_server, client);
+        close(client);
+    }
+
+    return NULL;
+}
+
+/**
+ * Creates the listening socket: on 127.0.0.1 if the address is a port number, on a unix socket otherwise.
+ */
+static int listen_on_address(frame_server_t* frame_server, const char* address) {
+    const bool is_port = address[0] != '\0' && strspn(address, "0123456789") == strlen(address);
+
+    if (is_port) {
+        const unsigned long port = strtoul(address, NULL, 10);
+        if (port == 0 || port > 65535) {
+            fprintf(stderr, "Invalid port %s\n", address);
+            return -1;
+        }
+
+        struct sockaddr_in inet_address;
+        memset(&inet_address, 0, sizeof(inet_address));
+        inet_address.sin_family = AF_INET;
+        inet_address.sin_port = htons((uint16_t) port);
+        inet_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        frame_server->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (frame_server->socket_fd < 0) {
+            return -1;
+        }
+
+        int reuse = 1;
+        setsockopt(frame_server->socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        return bind(frame_server->socket_fd, (struct sockaddr*) &inet_address, sizeof(inet_address));
+    }
+
+    struct sockaddr_un unix_address;
+    memset(&unix_address, 0, sizeof(unix_address));
+    unix_address.sun_family = AF_UNIX;
+
+    if (strlen(address) >= sizeof(unix_address.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", address);
+        return -1;
+    }
+
+    strcpy(unix_address.sun_path, address);
+
+    frame_server->socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (frame_server->socket_fd < 0) {
+        return -1;
+    }
+
+    unlink(address);
+    strcpy(frame_server->socket_path, address);
+
+    return bind(frame_server->socket_fd, (struct sockaddr*) &unix_address, sizeof(unix_address));
+}
+
+int start_frame_server(frame_server_t* frame_server, const char* address) {
+    if (listen_on_address(frame_server, address) != 0 || listen(frame_server->socket_fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Could not listen on %s\n", address);
+
+        if (frame_server->socket_fd >= 0) {
+            close(frame_server->socket_fd);
+            frame_server->socket_fd = -1;
+        }
+        return -1;
+    }
+
+    atomic_store(&frame_server->running, true);
+
+    if (pthread_create(&frame_server->server, NULL, frame_server_thread, frame_server) != 0) {
+        fprintf(stderr, "Could not start the frame server\n");
+        atomic_store(&frame_server->running, false);
+        stop_frame_server(frame_server);
+        return -1;
+    }
+
+    return 0;
+}
+
+void stop_frame_server(frame_server_t* frame_server) {
+    if (frame_server->socket_fd < 0) {
+        return;
+    }
+
+    if (atomic_exchange(&frame_server->running, false)) {
+        pthread_join(frame_server->server, NULL);
+    }
+
+    close(frame_server->socket_fd);
+    frame_server->socket_fd = -1;
+
+    if (frame_server->socket_path[0] != '\0') {
+        unlink(frame_server->socket_path);
+    }
+}
+
+void free_frame_server(frame_server_t* frame_server) {
+    for (int f = 0; f < FRAME_BUFFERS; f++) {
+        free_preview(&frame_server->frames[f]);
+    }
+
+    free(frame_server->layers_colors);
+    free(frame_server->scaled_density);
+}
@@ -1,24 +1,112 @@
 #include "game_of_life.h"
+#include "live_set.h"
 
+#include <string.h>
+#include <sys/mman.h>
 
-void init_gol(gol_t* gol, const uint64_t grid_size, const float density) {
+static const char* KERNEL_NAMES[NUM_KERNELS] = {
+    "neighbors",
+    "branchless",
+    "wrap"
+};
+
+static const char* REPRESENTATION_NAMES[NUM_REPRESENTATIONS] = {
+    "auto",
+    "dense",
+    "sparse"
+};
+
+void init_gol(gol_t* gol, const uint64_t grid_size, const float density, unsigned int* rng_state) {
+    size_t tiles_size = 2 * count_activity_tiles(grid_size) * sizeof(uint8_t);
+
+    bool* current = (bool*) allocate_grid(grid_size);
+    bool* next = (bool*) allocate_grid(grid_size);
+
+    init_gol_with_buffers(gol, grid_size, density, rng_state, current, next, (uint8_t*) malloc(tiles_size));
+
+    // the grids can be freed while the layer is sparse, see set_keep_grids
+    gol->owns_grids = true;
+
+    set_representation(gol, REPRESENTATION_AUTO);
+}
+
+void init_gol_with_buffers(gol_t* gol, const uint64_t grid_size, const float density, unsigned int* rng_state, bool* current, bool* next, uint8_t* tiles) {
     gol->size = grid_size;
+    gol->stride = get_grid_stride(grid_size);
+    gol->current = current;
+    gol->next = next;
+    gol->kernel = KERNEL_NEIGHBORS;
+    gol->rule = CONWAY_RULE;
+    gol->column_sums = NULL;
+    gol->next_column_sums = NULL;
+    gol->representation = REPRESENTATION_DENSE;
+    gol->live_set = NULL;
+    gol->owns_grids = false;
+    gol->keep_grids = true;
+
+    gol->tiles_per_side = (grid_size + ACTIVITY_TILE_SIZE - 1) / ACTIVITY_TILE_SIZE;
+    gol->changed_tiles = tiles;
+    gol->next_changed_tiles = tiles + count_activity_tiles(grid_size);
+    memset(tiles, 0, 2 * count_activity_tiles(grid_size) * sizeof(uint8_t));
+
+    init_grid(gol, density, rng_state);
+
+    memset(&gol->next_stats, 0, sizeof(gol_stats_t));
+    memset(&gol->stats, 0, sizeof(gol_stats_t));
+    gol->stats.alive = count_alive_cells(gol);
+}
+
+uint64_t get_grid_stride(const uint64_t grid_size) {
+    // the cells and the two ghost cells of a row
+    return (grid_size + 2 + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+}
+
+size_t count_grid_cells(const uint64_t grid_size) {
+    // the ghost rows and the padding before the first row, that holds the ghost cell (0, 0)
+    return (grid_size + 2) * get_grid_stride(grid_size) + GRID_ALIGNMENT;
+}
 
-    // size of the grid + 2 for the ghost cells
-    size_t size = (gol->size + 2) * (gol->size + 2) * sizeof(bool);
+void* allocate_grid(const uint64_t grid_size) {
+    void* grid = mmap(NULL, count_grid_cells(grid_size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-    gol->current = (bool*) malloc(size);
-    gol->next = (bool*) malloc(size);
+    return grid == MAP_FAILED ? NULL : grid;
+}
+
+void free_grid(void* grid, const uint64_t grid_size) {
+    if (grid) {
+        munmap(grid, count_grid_cells(grid_size));
+    }
+}
+
+uint64_t count_activity_tiles(const uint64_t grid_size) {
+    uint64_t tiles_per_side = (grid_size + ACTIVITY_TILE_SIZE - 1) / ACTIVITY_TILE_SIZE;
+    return tiles_per_side * tiles_per_side;
+}
+
+void init_grid(const gol_t* gol, const float density, unsigned int* rng_state) {
+    for (uint64_t i = 1; i < gol->size + 1; i++) {
+        for (uint64_t j = 1; j < gol->size + 1; j++) {
+            gol->current[idx(gol, i, j)] = ((float) rand_r(rng_state) / RAND_MAX) < density;
+        }
+    }
 
-    init_grid(gol, density);
+    fill_ghost_cells(gol);
 }
 
-void init_grid(const gol_t* gol, const float density) {
+uint64_t count_alive_cells(const gol_t* gol) {
+    if (!gol->current) {
+        return gol->live_set->num_cells;
+    }
+
+    uint64_t alive = 0;
+
     for (uint64_t i = 1; i < gol->size + 1; i++) {
         for (uint64_t j = 1; j < gol->size + 1; j++) {
-            gol->current[idx(gol, i, j)] = ((float) rand() / RAND_MAX) < density;
+            alive += gol->current[idx(gol, i, j)];
         }
     }
+
+    return alive;
 }
 
 uint8_t count_alive_neighbors(const gol_t* gol, const uint64_t i, const uint64_t j) {
@@ -31,34 +119,554 @@ void swap_grids(gol_t* gol) {
     bool* temp = gol->current;
     gol->current = gol->next;
     gol->next = temp;
+
+    uint8_t* temp_sums = gol->column_sums;
+    gol->column_sums = gol->next_column_sums;
+    gol->next_column_sums = temp_sums;
 }
 
 void step(gol_t* gol) {
-    fill_ghost_cells(gol);
+    if (gol->live_set) {
+        step_live_set(gol);
+        return;
+    }
 
-    for (uint64_t i = 1; i < gol->size + 1; i++) {
-        for (uint64_t j = 1; j < gol->size + 1; j++) {
+    step_block(gol, 1, gol->size + 1, 1, gol->size + 1);
+
+    complete_step(gol);
+}
+
+/**
+ * Flags the tile of the given cell as changed in the step being calculated.
+ * The flag is only written if not already set, to avoid invalidating the cache line of the other threads.
+ */
+static inline void mark_changed_tile(gol_t* gol, const uint64_t i, const uint64_t j) {
+    size_t tile = ((i - 1) / ACTIVITY_TILE_SIZE) * gol->tiles_per_side + (j - 1) / ACTIVITY_TILE_SIZE;
+    uint8_t changed;
+
+#pragma omp atomic read
+    changed = gol->next_changed_tiles[tile];
+
+    if (!changed) {
+#pragma omp atomic write
+        gol->next_changed_tiles[tile] = 1;
+    }
+}
+
+/**
+ * Adds the births and deaths of a block to the stats of the step being calculated.
+ */
+static inline void add_block_stats(gol_t* gol, const uint64_t births, const uint64_t deaths) {
+#pragma omp atomic
+    gol->next_stats.births += births;
+#pragma omp atomic
+    gol->next_stats.deaths += deaths;
+}
+
+/**
+ * Returns the column after the last column of the activity tile of the given column, limited to last_col.
+ */
+static inline uint64_t tile_end(const uint64_t j, const uint64_t last_col) {
+    uint64_t end = ((j - 1) / ACTIVITY_TILE_SIZE + 1) * ACTIVITY_TILE_SIZE + 1;
+    return end < last_col ? end : last_col;
+}
+
+static void step_block_neighbors(gol_t* gol, const uint64_t first_row, const uint64_t last_row, const uint64_t first_col, const uint64_t last_col) {
+    const rule_t rule = gol->rule;
+    uint64_t births = 0;
+    uint64_t deaths = 0;
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        for (uint64_t tile_first = first_col; tile_first < last_col; tile_first = tile_end(tile_first, last_col)) {
+            uint64_t changes = 0;
+
+            for (uint64_t j = tile_first; j < tile_end(tile_first, last_col); j++) {
+
+                uint8_t alive_neighbors = count_alive_neighbors(gol, i, j);
+
+                // The state of the current cell
+                bool is_alive = gol->current[idx(gol, i, j)];
+
+                // The state of the current cell in the next step based on the rule of the layer
+                bool next_state = ((is_alive ? rule.survive : rule.birth) >> alive_neighbors) & 1;
+
+                gol->next[idx(gol, i, j)] = next_state;
+
+                births += next_state && !is_alive;
+                deaths += is_alive && !next_state;
+                changes += next_state != is_alive;
+            }
+
+            if (changes) {
+                mark_changed_tile(gol, i, tile_first);
+            }
+        }
+    }
+
+    add_block_stats(gol, births, deaths);
+}
+
+static void step_block_branchless(gol_t* gol, const uint64_t first_row, const uint64_t last_row, const uint64_t first_col, const uint64_t last_col) {
+    // the alive cells count themselves, so the survive mask is shifted by one
+    const uint32_t birth = gol->rule.birth;
+    const uint32_t survive = (uint32_t) gol->rule.survive << 1;
+    uint64_t births = 0;
+    uint64_t deaths = 0;
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        const bool* restrict above = &gol->current[idx(gol, i - 1, 0)];
+        const bool* restrict row = &gol->current[idx(gol, i, 0)];
+        const bool* restrict below = &gol->current[idx(gol, i + 1, 0)];
+        bool* restrict next = &gol->next[idx(gol, i, 0)];
+
+        for (uint64_t tile_first = first_col; tile_first < last_col; tile_first = tile_end(tile_first, last_col)) {
+            const uint64_t tile_last = tile_end(tile_first, last_col);
+            uint32_t tile_births = 0;
+            uint32_t tile_deaths = 0;
 
-            uint8_t alive_neighbors = count_alive_neighbors(gol, i, j);
+            for (uint64_t j = tile_first; j < tile_last; j++) {
+                // alive cells in the 3x3 square, the cell included
+                uint8_t alive = above[j - 1] + above[j] + above[j + 1] +
+                                row[j - 1]   + row[j]   + row[j + 1] +
+                                below[j - 1] + below[j] + below[j + 1];
 
-            // The state of the current cell
-            bool is_alive = gol->current[idx(gol, i, j)];
+                uint8_t next_state = ((birth >> alive) & !row[j]) | ((survive >> alive) & row[j]);
+                next[j] = next_state;
 
-            // The state of the current cell in the next step based on the rules of the game of life
-            bool next_state = (is_alive && !(alive_neighbors < 2 || alive_neighbors > 3)) || (!is_alive && alive_neighbors == 3);
+                tile_births += next_state & !row[j];
+                tile_deaths += row[j] & !next_state;
+            }
 
-            gol->next[idx(gol, i, j)] = next_state;
+            if (tile_births | tile_deaths) {
+                mark_changed_tile(gol, i, tile_first);
+            }
+
+            births += tile_births;
+            deaths += tile_deaths;
+        }
+    }
+
+    add_block_stats(gol, births, deaths);
+}
+
+/**
+ * Returns the next state of a cell from the alive cells in its 3x3 square (the cell included) and its state,
+ * the survive mask is shifted by one since the alive cells count themselves.
+ * When the masks are constants the loop is unrolled and only the counts of the rule are compared,
+ * e.g. Conway's rule becomes (alive == 3) | (cell & (alive == 4)).
+ */
+static inline uint8_t apply_rule(const uint32_t birth, const uint32_t survive, const uint8_t alive, const uint8_t cell) {
+    uint8_t next_state = 0;
+
+    for (uint8_t k = 0; k <= 9; k++) {
+        const bool born = (birth >> k) & 1;
+        const bool survives = (survive >> k) & 1;
+
+        if (born && survives) {
+            next_state |= alive == k;
+        } else if (born) {
+            next_state |= (alive == k) & (cell ^ 1);
+        } else if (survives) {
+            next_state |= (alive == k) & cell;
+        }
+    }
+
+    return next_state;
+}
+
+/**
+ * Calculates the next state of the given columns of a row with the given masks (see apply_rule), the columns around them
+ * are read without wrapping, so the first and the last column of the grid must be left to step_edge_cell.
+ * The cells are read as bytes, the conversions from bool would prevent the vectorization of the loop.
+ */
+static inline void step_interior_cells(const uint8_t* restrict above, const uint8_t* restrict row, const uint8_t* restrict below, uint8_t* restrict next,
+        const uint64_t first_col, const uint64_t last_col, const uint32_t birth, const uint32_t survive, uint32_t* births, uint32_t* deaths) {
+    uint32_t cells_births = 0;
+    uint32_t cells_deaths = 0;
+
+    for (uint64_t j = first_col; j < last_col; j++) {
+        // alive cells in the 3x3 square, the cell included
+        uint8_t alive = above[j - 1] + above[j] + above[j + 1] +
+                        row[j - 1]   + row[j]   + row[j + 1] +
+                        below[j - 1] + below[j] + below[j + 1];
+
+        uint8_t next_state = apply_rule(birth, survive, alive, row[j]);
+        next[j] = next_state;
+
+        cells_births += next_state & (row[j] ^ 1);
+        cells_deaths += row[j] & (next_state ^ 1);
+    }
+
+    *births += cells_births;
+    *deaths += cells_deaths;
+}
+
+// most transitions compared by a generic interior kernel: of the 18 codes of a Life-like rule,
+// either the ones to an alive cell or the ones to a dead cell are at most 9
+#define MAX_RULE_TRANSITIONS 9
+
+/**
+ * The transitions of a rule compared by the generic interior kernels, see rule_transitions.
+ */
+typedef struct {
+    uint8_t codes[MAX_RULE_TRANSITIONS];
+    uint8_t inverted;
+} rule_transitions_t;
+
+/**
+ * Fills the codes with the transitions of a rule to an alive cell, or to a dead cell if they are fewer, and returns their number.
+ * The code of a cell is 2 * alive + cell, with alive the alive cells in its 3x3 square (the cell included) and cell its state,
+ * the unused codes never match. Inverted is set if the codes are the transitions to a dead cell.
+ */
+static uint64_t rule_transitions(const rule_t rule, rule_transitions_t* transitions) {
+    // the codes that a cell can have: a dead cell has at most 8 alive cells in its square, an alive one at least 1
+    const uint32_t valid = 0xbfffd;
+    uint32_t to_alive = 0;
+
+    for (uint32_t k = 0; k <= 8; k++) {
+        to_alive |= ((rule.birth >> k) & 1u) << (2 * k);
+        to_alive |= ((rule.survive >> k) & 1u) << (2 * (k + 1) + 1);
+    }
+
+    transitions->inverted = __builtin_popcount(to_alive) > MAX_RULE_TRANSITIONS;
+    const uint32_t matched = transitions->inverted ? valid & ~to_alive : to_alive;
+
+    uint64_t num_codes = 0;
+    for (uint8_t code = 0; code < 20; code++) {
+        if ((matched >> code) & 1) {
+            transitions->codes[num_codes++] = code;
+        }
+    }
+
+    for (uint64_t k = num_codes; k < MAX_RULE_TRANSITIONS; k++) {
+        transitions->codes[k] = UINT8_MAX;
+    }
+
+    return num_codes;
+}
+
+typedef void (*interior_cells_t)(const uint8_t* restrict above, const uint8_t* restrict row, const uint8_t* restrict below, uint8_t* restrict next,
+        uint64_t first_col, uint64_t last_col, const rule_transitions_t* transitions, uint32_t* births, uint32_t* deaths);
+
+/**
+ * Like step_interior_cells, for any rule: the masks are not known at compile time, so the code of each cell is compared
+ * with the given number of transitions of the rule, a constant in each generic kernel, so that the comparisons are unrolled
+ * and only as many as the transitions of the rule, on bytes like the ones of the specialized kernels.
+ */
+static inline void step_interior_cells_transitions(const uint8_t* restrict above, const uint8_t* restrict row, const uint8_t* restrict below, uint8_t* restrict next,
+        const uint64_t first_col, const uint64_t last_col, const rule_transitions_t* transitions, const uint64_t num_transitions, uint32_t* births, uint32_t* deaths) {
+    uint8_t codes[MAX_RULE_TRANSITIONS];
+    memcpy(codes, transitions->codes, sizeof(codes));
+
+    const uint8_t inverted = transitions->inverted;
+    uint32_t cells_births = 0;
+    uint32_t cells_deaths = 0;
+
+    for (uint64_t j = first_col; j < last_col; j++) {
+        uint8_t alive = above[j - 1] + above[j] + above[j + 1] +
+                        row[j - 1]   + row[j]   + row[j + 1] +
+                        below[j - 1] + below[j] + below[j + 1];
+        uint8_t code = 2 * alive + row[j];
+
+        uint8_t next_state = inverted;
+        for (uint64_t k = 0; k < num_transitions; k++) {
+            next_state ^= (code == codes[k]);
+        }
+        next[j] = next_state;
+
+        cells_births += next_state & (row[j] ^ 1);
+        cells_deaths += row[j] & (next_state ^ 1);
+    }
+
+    *births += cells_births;
+    *deaths += cells_deaths;
+}
+
+#define DEFINE_GENERIC_INTERIOR_CELLS(num_transitions) \
+    static void step_interior_cells_generic_##num_transitions(const uint8_t* restrict above, const uint8_t* restrict row, const uint8_t* restrict below, \
+            uint8_t* restrict next, const uint64_t first_col, const uint64_t last_col, const rule_transitions_t* transitions, uint32_t* births, uint32_t* deaths) { \
+        step_interior_cells_transitions(above, row, below, next, first_col, last_col, transitions, num_transitions, births, deaths); \
+    }
+
+DEFINE_GENERIC_INTERIOR_CELLS(0)
+DEFINE_GENERIC_INTERIOR_CELLS(1)
+DEFINE_GENERIC_INTERIOR_CELLS(2)
+DEFINE_GENERIC_INTERIOR_CELLS(3)
+DEFINE_GENERIC_INTERIOR_CELLS(4)
+DEFINE_GENERIC_INTERIOR_CELLS(5)
+DEFINE_GENERIC_INTERIOR_CELLS(6)
+DEFINE_GENERIC_INTERIOR_CELLS(7)
+DEFINE_GENERIC_INTERIOR_CELLS(8)
+DEFINE_GENERIC_INTERIOR_CELLS(9)
+
+// the generic interior kernels by number of transitions of the rule
+static const interior_cells_t GENERIC_INTERIOR_CELLS[MAX_RULE_TRANSITIONS + 1] = {
+    step_interior_cells_generic_0, step_interior_cells_generic_1, step_interior_cells_generic_2, step_interior_cells_generic_3, step_interior_cells_generic_4,
+    step_interior_cells_generic_5, step_interior_cells_generic_6, step_interior_cells_generic_7, step_interior_cells_generic_8, step_interior_cells_generic_9
+};
+
+// the rules with a specialized interior kernel: name, birth mask, survive mask
+#define SPECIALIZED_RULES(X) \
+    X(conway,            0x008, 0x00c) /* B3/S23 */ \
+    X(highlife,          0x048, 0x00c) /* B36/S23 */ \
+    X(seeds,             0x004, 0x000) /* B2/S */ \
+    X(life_without_death, 0x008, 0x1ff) /* B3/S012345678 */ \
+    X(day_and_night,     0x1c8, 0x1d8) /* B3678/S34678 */ \
+    X(two_by_two,        0x048, 0x026) /* B36/S125 */ \
+    X(diamoeba,          0x1e8, 0x1e0) /* B35678/S5678 */ \
+    X(morley,            0x148, 0x034) /* B368/S245 */ \
+    X(replicator,        0x0aa, 0x0aa) /* B1357/S1357 */ \
+    X(maze,              0x008, 0x03e) /* B3/S12345 */
+
+#define DEFINE_INTERIOR_CELLS(name, birth, survive) \
+    static void step_interior_cells_##name(const uint8_t* restrict above, const uint8_t* restrict row, const uint8_t* restrict below, uint8_t* restrict next, \
+            const uint64_t first_col, const uint64_t last_col, const rule_transitions_t* transitions, uint32_t* births, uint32_t* deaths) { \
+        (void) transitions; \
+        step_interior_cells(above, row, below, next, first_col, last_col, birth, (survive) << 1, births, deaths); \
+    }
+
+SPECIALIZED_RULES(DEFINE_INTERIOR_CELLS)
+
+#define SPECIALIZED_RULE_ENTRY(name, birth, survive) { { birth, survive, 1, false, 0, 0, 0, 0 }, step_interior_cells_##name },
+
+static const struct {
+    rule_t rule;
+    interior_cells_t cells;
+} SPECIALIZED_INTERIOR_CELLS[] = {
+    SPECIALIZED_RULES(SPECIALIZED_RULE_ENTRY)
+};
+
+#define NUM_SPECIALIZED_RULES (sizeof(SPECIALIZED_INTERIOR_CELLS) / sizeof(SPECIALIZED_INTERIOR_CELLS[0]))
+
+/**
+ * Returns the interior kernel specialized for the given rule, or NULL if there is none.
+ */
+static interior_cells_t find_specialized_interior_cells(const rule_t rule) {
+    for (uint64_t r = 0; r < NUM_SPECIALIZED_RULES; r++) {
+        if (rules_equal(SPECIALIZED_INTERIOR_CELLS[r].rule, rule)) {
+            return SPECIALIZED_INTERIOR_CELLS[r].cells;
         }
     }
 
+    return NULL;
+}
+
+/**
+ * Returns the interior kernel specialized for the given rule, or the generic one for the number of transitions of the rule,
+ * whose transitions are written in the given ones.
+ */
+static interior_cells_t find_interior_cells(const rule_t rule, rule_transitions_t* transitions) {
+    const interior_cells_t specialized = find_specialized_interior_cells(rule);
+    if (specialized) {
+        return specialized;
+    }
+
+    return GENERIC_INTERIOR_CELLS[rule_transitions(rule, transitions)];
+}
+
+bool has_specialized_kernel(const rule_t rule) {
+    return find_specialized_interior_cells(rule) != NULL;
+}
+
+/**
+ * Calculates the next state of a cell in the first or the last column of a row, the columns before and after it are given,
+ * so that they can be wrapped on the torus.
+ */
+static inline void step_edge_cell(const bool* above, const bool* row, const bool* below, bool* next, const rule_t rule,
+        const uint64_t j, const uint64_t left, const uint64_t right, uint32_t* births, uint32_t* deaths) {
+    uint8_t alive_neighbors = above[left] + above[j] + above[right] +
+                              row[left]               + row[right] +
+                              below[left] + below[j] + below[right];
+
+    uint8_t next_state = ((row[j] ? rule.survive : rule.birth) >> alive_neighbors) & 1;
+    next[j] = next_state;
+
+    *births += next_state & !row[j];
+    *deaths += row[j] & !next_state;
+}
+
+static void step_block_wrap(gol_t* gol, const uint64_t first_row, const uint64_t last_row, const uint64_t first_col, const uint64_t last_col) {
+    const uint64_t n = gol->size;
+    const rule_t rule = gol->rule;
+    rule_transitions_t transitions;
+    const interior_cells_t interior_cells = find_interior_cells(rule, &transitions);
+    uint64_t births = 0;
+    uint64_t deaths = 0;
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        // the rows around the first and the last one are wrapped on the torus
+        const bool* above = &gol->current[idx(gol, i == 1 ? n : i - 1, 0)];
+        const bool* row = &gol->current[idx(gol, i, 0)];
+        const bool* below = &gol->current[idx(gol, i == n ? 1 : i + 1, 0)];
+        bool* next = &gol->next[idx(gol, i, 0)];
+
+        for (uint64_t tile_first = first_col; tile_first < last_col; tile_first = tile_end(tile_first, last_col)) {
+            const uint64_t tile_last = tile_end(tile_first, last_col);
+            uint64_t interior_first = tile_first;
+            uint64_t interior_last = tile_last;
+            uint32_t tile_births = 0;
+            uint32_t tile_deaths = 0;
+
+            if (tile_first == 1) {
+                step_edge_cell(above, row, below, next, rule, 1, n, n == 1 ? 1 : 2, &tile_births, &tile_deaths);
+                interior_first = 2;
+            }
+
+            if (tile_last == n + 1 && n > 1) {
+                step_edge_cell(above, row, below, next, rule, n, n - 1, 1, &tile_births, &tile_deaths);
+                interior_last = n;
+            }
+
+            if (interior_first < interior_last) {
+                interior_cells((const uint8_t*) above, (const uint8_t*) row, (const uint8_t*) below, (uint8_t*) next,
+                    interior_first, interior_last, &transitions, &tile_births, &tile_deaths);
+            }
+
+            if (tile_births | tile_deaths) {
+                mark_changed_tile(gol, i, tile_first);
+            }
+
+            births += tile_births;
+            deaths += tile_deaths;
+        }
+    }
+
+    add_block_stats(gol, births, deaths);
+}
+
+/**
+ * Steps a block with a Larger than Life rule, a tile at a time: the squares of the cells of a row of the tile are counted
+ * from the column sums, the cell itself is removed from the count unless the rule includes it.
+ */
+static void step_block_larger_than_life(gol_t* gol, const uint64_t first_row, const uint64_t last_row, const uint64_t first_col, const uint64_t last_col) {
+    const rule_t rule = gol->rule;
+    const uint8_t exclude_middle = !rule.middle;
+    uint64_t births = 0;
+    uint64_t deaths = 0;
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        for (uint64_t tile_first = first_col; tile_first < last_col; tile_first = tile_end(tile_first, last_col)) {
+            const uint64_t tile_last = tile_end(tile_first, last_col);
+            const uint64_t width = tile_last - tile_first;
+            const uint8_t* restrict row = (const uint8_t*) &gol->current[idx(gol, i, tile_first)];
+            uint8_t* restrict next = (uint8_t*) &gol->next[idx(gol, i, tile_first)];
+            uint16_t counts[ACTIVITY_TILE_SIZE];
+            uint32_t tile_births = 0;
+            uint32_t tile_deaths = 0;
+
+            memset(counts, 0, width * sizeof(uint16_t));
+            add_square_counts(gol, i, rule.radius, tile_first, tile_last, counts);
+
+            for (uint64_t k = 0; k < width; k++) {
+                const uint16_t count = (uint16_t) (counts[k] - (row[k] & exclude_middle));
+                const uint8_t born = (count >= rule.birth_min) & (count <= rule.birth_max);
+                const uint8_t survives = (count >= rule.survive_min) & (count <= rule.survive_max);
+                const uint8_t next_state = (born & (row[k] ^ 1)) | (survives & row[k]);
+
+                next[k] = next_state;
+
+                tile_births += next_state & (row[k] ^ 1);
+                tile_deaths += row[k] & (next_state ^ 1);
+            }
+
+            if (tile_births | tile_deaths) {
+                mark_changed_tile(gol, i, tile_first);
+            }
+
+            births += tile_births;
+            deaths += tile_deaths;
+        }
+    }
+
+    add_block_stats(gol, births, deaths);
+}
+
+void step_block(gol_t* gol, const uint64_t first_row, const uint64_t last_row, const uint64_t first_col, const uint64_t last_col) {
+    if (gol->rule.radius > 1) {
+        step_block_larger_than_life(gol, first_row, last_row, first_col, last_col);
+        return;
+    }
+
+    switch (gol->kernel) {
+    case KERNEL_BRANCHLESS:
+        step_block_branchless(gol, first_row, last_row, first_col, last_col);
+        break;
+    case KERNEL_WRAP:
+        step_block_wrap(gol, first_row, last_row, first_col, last_col);
+        break;
+    default:
+        step_block_neighbors(gol, first_row, last_row, first_col, last_col);
+        break;
+    }
+}
+
+void complete_step(gol_t* gol) {
     swap_grids(gol);
+
+    // the ghost cells of the current grid are kept up to date for the kernels that read them, the live sets update the changed cells only
+    if (gol->kernel != KERNEL_WRAP && !gol->live_set) {
+        fill_ghost_cells(gol);
+    }
+
+    if (gol->column_sums && !gol->live_set) {
+        calculate_column_sums(gol, 1, gol->size + 1);
+    }
+
+    // publish the stats and the changed tiles of the step, then clear them for the next one
+    const uint64_t num_tiles = count_activity_tiles(gol->size);
+    uint8_t* changed_tiles = gol->next_changed_tiles;
+
+    gol->stats = collect_step_stats(gol);
+    memset(&gol->next_stats, 0, sizeof(gol_stats_t));
+
+    gol->next_changed_tiles = gol->changed_tiles;
+    gol->changed_tiles = changed_tiles;
+    memset(gol->next_changed_tiles, 0, num_tiles * sizeof(uint8_t));
+}
+
+gol_stats_t collect_step_stats(const gol_t* gol) {
+    const uint64_t num_tiles = count_activity_tiles(gol->size);
+    gol_stats_t stats = gol->next_stats;
+
+    stats.alive = gol->stats.alive + stats.births - stats.deaths;
+    stats.changed_tiles = 0;
+    for (uint64_t t = 0; t < num_tiles; t++) {
+        stats.changed_tiles += gol->next_changed_tiles[t];
+    }
+
+    return stats;
+}
+
+void refresh_gol(gol_t* gol) {
+    const uint64_t num_tiles = count_activity_tiles(gol->size);
+
+    restore_grids(gol);
+    fill_ghost_cells(gol);
+
+    if (gol->column_sums) {
+        calculate_column_sums(gol, 1, gol->size + 1);
+    }
+
+    memset(gol->changed_tiles, 1, num_tiles * sizeof(uint8_t));
+    memset(gol->next_changed_tiles, 0, num_tiles * sizeof(uint8_t));
+
+    memset(&gol->next_stats, 0, sizeof(gol_stats_t));
+    memset(&gol->stats, 0, sizeof(gol_stats_t));
+    gol->stats.alive = count_alive_cells(gol);
+    gol->stats.changed_tiles = num_tiles;
+
+    if (gol->live_set) {
+        build_live_set(gol);
+    }
+
+    update_representation(gol);
 }
 
 void fill_ghost_cells(const gol_t* gol) {
     const uint64_t TOP = 1;
-    const uint64_t BOTTOM = gol->size - 1;
+    const uint64_t BOTTOM = gol->size;
     const uint64_t LEFT = 1;
-    const uint64_t RIGHT = gol->size - 1;
+    const uint64_t RIGHT = gol->size;
     const uint64_t HALO_TOP = TOP - 1;
     const uint64_t HALO_BOTTOM = BOTTOM + 1;
     const uint64_t HALO_LEFT = LEFT - 1;
@@ -83,7 +691,191 @@ void fill_ghost_cells(const gol_t* gol) {
     gol->current[idx(gol, HALO_BOTTOM, HALO_RIGHT)] = gol->current[idx(gol, TOP, LEFT)];
 }
 
+void set_kernel(gol_t* gol, const kernel_t kernel) {
+    // the ghost cells are left behind by the steps of KERNEL_WRAP, the freed grids get them when they are restored
+    if (kernel != KERNEL_WRAP && gol->kernel == KERNEL_WRAP && gol->current) {
+        fill_ghost_cells(gol);
+    }
+
+    gol->kernel = kernel;
+}
+
+void set_rule(gol_t* gol, const rule_t rule) {
+    gol->rule = rule;
+
+    if (rule.radius > 1) {
+        enable_column_sums(gol);
+    }
+
+    update_representation(gol);
+}
+
+void enable_column_sums(gol_t* gol) {
+    // the freed grids get them when they are restored
+    if (!gol->current) {
+        gol->live_set->column_sums = true;
+        return;
+    }
+
+    if (gol->column_sums) {
+        return;
+    }
+
+    gol->column_sums = (uint8_t*) allocate_grid(gol->size);
+    gol->next_column_sums = (uint8_t*) allocate_grid(gol->size);
+
+    calculate_column_sums(gol, 1, gol->size + 1);
+
+    // the column sums of the next grid are only updated in the changed cells by the live sets
+    if (gol->live_set) {
+        build_live_set(gol);
+    }
+}
+
+void calculate_column_sums(const gol_t* gol, const uint64_t first_row, const uint64_t last_row) {
+    const uint64_t n = gol->size;
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        const uint8_t* restrict row = (const uint8_t*) &gol->current[idx(gol, i, 1)];
+        uint8_t* restrict sums = &gol->column_sums[idx(gol, i, 1)];
+
+        if ((i - 1) % COLUMN_SUMS_ROWS == 0) {
+            memcpy(sums, row, n * sizeof(uint8_t));
+            continue;
+        }
+
+        const uint8_t* restrict above = &gol->column_sums[idx(gol, i - 1, 1)];
+        for (uint64_t j = 0; j < n; j++) {
+            sums[j] = above[j] + row[j];
+        }
+    }
+}
+
+/**
+ * Adds to sums[k] the alive cells of the column first_col + k from first_row to last_row (included), for num_cols columns,
+ * from the column sums of the chunks of the rows. Neither the rows nor the columns are wrapped.
+ */
+static void add_column_ranges(const gol_t* gol, uint64_t first_row, const uint64_t last_row, const uint64_t first_col, const uint64_t num_cols, uint16_t* sums) {
+    while (first_row <= last_row) {
+        const uint64_t chunk_last = (first_row - 1) / COLUMN_SUMS_ROWS * COLUMN_SUMS_ROWS + COLUMN_SUMS_ROWS;
+        const uint64_t range_last = chunk_last < last_row ? chunk_last : last_row;
+        const uint8_t* last = &gol->column_sums[idx(gol, range_last, first_col)];
+
+        if ((first_row - 1) % COLUMN_SUMS_ROWS == 0) {
+            for (uint64_t k = 0; k < num_cols; k++) {
+                sums[k] += last[k];
+            }
+        } else {
+            // the sums wrap around at 256, their difference is still exact
+            const uint8_t* before = &gol->column_sums[idx(gol, first_row - 1, first_col)];
+            for (uint64_t k = 0; k < num_cols; k++) {
+                sums[k] += (uint8_t) (last[k] - before[k]);
+            }
+        }
+
+        first_row = range_last + 1;
+    }
+}
+
+/**
+ * Adds to sums[k] the alive cells of the column first_col - radius + k in the rows from i - radius to i + radius,
+ * for num_cols columns, the rows and the columns are wrapped on the torus (more than once if the grid is smaller than the window).
+ */
+static void add_window_columns(const gol_t* gol, const uint64_t i, const uint64_t radius, const uint64_t first_col, const uint64_t num_cols, uint16_t* sums) {
+    const uint64_t n = gol->size;
+    uint64_t row = (i - 1 + n - radius % n) % n + 1;
+
+    for (uint64_t rows_left = 2 * radius + 1; rows_left > 0; row = 1) {
+        const uint64_t rows = rows_left < n - row + 1 ? rows_left : n - row + 1;
+        uint64_t col = (first_col - 1 + n - radius % n) % n + 1;
+
+        for (uint64_t offset = 0; offset < num_cols; col = 1) {
+            const uint64_t cols = num_cols - offset < n - col + 1 ? num_cols - offset : n - col + 1;
+
+            add_column_ranges(gol, row, row + rows - 1, col, cols, sums + offset);
+            offset += cols;
+        }
+
+        rows_left -= rows;
+    }
+}
+
+void add_square_counts(const gol_t* gol, const uint64_t i, const uint64_t radius, const uint64_t first_col, const uint64_t last_col, uint16_t* counts) {
+    const uint64_t side = 2 * radius + 1;
+    const uint64_t width = last_col - first_col;
+
+    // prefix[k + 1] is the sum of the columns of the window up to the column first_col - radius + k, modulo 2^16
+    uint16_t prefix[ACTIVITY_TILE_SIZE + 2 * MAX_RULE_RADIUS + 1];
+
+    memset(prefix, 0, (width + side) * sizeof(uint16_t));
+    add_window_columns(gol, i, radius, first_col, width + side - 1, prefix + 1);
+
+    for (uint64_t k = 1; k < width + side; k++) {
+        prefix[k] += prefix[k - 1];
+    }
+
+    for (uint64_t k = 0; k < width; k++) {
+        counts[k] += (uint16_t) (prefix[k + side] - prefix[k]);
+    }
+}
+
+void fill_ghost_rows(const gol_t* gol, const uint64_t first_row, const uint64_t last_row) {
+    const uint64_t n = gol->size;
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        gol->current[idx(gol, i, 0)] = gol->current[idx(gol, i, n)];
+        gol->current[idx(gol, i, n + 1)] = gol->current[idx(gol, i, 1)];
+    }
+
+    // the ghost rows are copied with the ghost columns just filled, for the corners
+    if (last_row == n + 1) {
+        memcpy(&gol->current[idx(gol, 0, 0)], &gol->current[idx(gol, n, 0)], (n + 2) * sizeof(bool));
+    }
+
+    if (first_row == 1) {
+        memcpy(&gol->current[idx(gol, n + 1, 0)], &gol->current[idx(gol, 1, 0)], (n + 2) * sizeof(bool));
+    }
+}
+
+const char* kernel_name(const kernel_t kernel) {
+    return KERNEL_NAMES[kernel];
+}
+
+int parse_kernel(const char* name, kernel_t* kernel) {
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        if (strcmp(name, KERNEL_NAMES[k]) == 0) {
+            *kernel = (kernel_t) k;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+const char* representation_name(const representation_t representation) {
+    return REPRESENTATION_NAMES[representation];
+}
+
+int parse_representation(const char* name, representation_t* representation) {
+    for (int r = 0; r < NUM_REPRESENTATIONS; r++) {
+        if (strcmp(name, REPRESENTATION_NAMES[r]) == 0) {
+            *representation = (representation_t) r;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
 void free_gol(gol_t* gol) {
-    free(gol->current);
-    free(gol->next);
+    release_live_set(gol);
+
+    free_grid(gol->current, gol->size);
+    free_grid(gol->next, gol->size);
+
+    // the two arrays of flags are allocated together
+    free(gol->changed_tiles < gol->next_changed_tiles ? gol->changed_tiles : gol->next_changed_tiles);
+
+    free_grid(gol->column_sums, gol->size);
+    free_grid(gol->next_column_sums, gol->size);
 }
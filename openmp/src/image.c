@@ -10,21 +10,35 @@ void write_png_file(const char* filename, uint64_t width, uint64_t height, uint8
         abort();
     }
 
+    if (write_png_stream(fp, width, height, buffer) != 0) {
+        abort();
+    }
+
+    fclose(fp);
+}
+
+int write_png_stream(FILE* fp, uint64_t width, uint64_t height, uint8_t* buffer) {
     png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!png) {
         fprintf(stderr, "Could not create write struct\n");
-        abort();
+        return -1;
     }
 
     png_infop info = png_create_info_struct(png);
     if (!info) {
         fprintf(stderr, "Could not create info struct\n");
-        abort();
+        png_destroy_write_struct(&png, NULL);
+        return -1;
     }
 
+    // the rows are allocated before the jump point, so that they can be freed after an error
+    png_bytep* rows = (png_bytep*) malloc(height * sizeof(png_bytep));
+
     if (setjmp(png_jmpbuf(png))) {
         fprintf(stderr, "Error during png creation\n");
-        abort();
+        free(rows);
+        png_destroy_write_struct(&png, &info);
+        return -1;
     }
 
     png_init_io(png, fp);
@@ -46,8 +60,6 @@ void write_png_file(const char* filename, uint64_t width, uint64_t height, uint8
     );
     png_write_info(png, info);
 
-    png_bytep rows[height];
-
     for(uint64_t y = 0; y < height; y++) {
         rows[y] = &buffer[y * width * 3];
     }
@@ -55,7 +67,8 @@ void write_png_file(const char* filename, uint64_t width, uint64_t height, uint8
     png_write_image(png, rows);
     png_write_end(png, NULL);
 
-    fclose(fp);
-
+    free(rows);
     png_destroy_write_struct(&png, &info);
-}
\ No newline at end of file
+
+    return 0;
+}
@@ -0,0 +1,505 @@
+#include "live_set.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// initial capacity of the arrays of positions, they double when full
+#define LIVE_SET_INITIAL_CAPACITY 1024
+
+bool can_use_live_set(const gol_t* gol) {
+    return gol->rule.radius == 1 && !(gol->rule.birth & 1) && gol->size >= LIVE_SET_MIN_SIZE;
+}
+
+/**
+ * Appends a position to an array, doubling it when full.
+ */
+static inline void push_position(uint64_t** positions, uint64_t* count, uint64_t* capacity, const uint64_t position) {
+    if (*count == *capacity) {
+        *capacity *= 2;
+        *positions = (uint64_t*) realloc(*positions, *capacity * sizeof(uint64_t));
+    }
+
+    (*positions)[(*count)++] = position;
+}
+
+/**
+ * Returns a capacity of at least the given count, LIVE_SET_INITIAL_CAPACITY at least.
+ */
+static uint64_t positions_capacity(const uint64_t count) {
+    uint64_t capacity = LIVE_SET_INITIAL_CAPACITY;
+
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+/**
+ * Allocates an empty live set for a grid of the given size.
+ */
+static live_set_t* create_live_set(const uint64_t size) {
+    live_set_t* set = (live_set_t*) malloc(sizeof(live_set_t));
+
+    set->num_cells = 0;
+    set->cells_capacity = LIVE_SET_INITIAL_CAPACITY;
+    set->cells = (uint64_t*) malloc(set->cells_capacity * sizeof(uint64_t));
+    set->num_next_cells = 0;
+    set->next_cells_capacity = LIVE_SET_INITIAL_CAPACITY;
+    set->next_cells = (uint64_t*) malloc(set->next_cells_capacity * sizeof(uint64_t));
+    set->num_changes = 0;
+    set->changes_capacity = LIVE_SET_INITIAL_CAPACITY;
+    set->changes = (uint64_t*) malloc(set->changes_capacity * sizeof(uint64_t));
+    set->num_next_changes = 0;
+    set->next_changes_capacity = LIVE_SET_INITIAL_CAPACITY;
+    set->next_changes = (uint64_t*) malloc(set->next_changes_capacity * sizeof(uint64_t));
+    set->rows = (uint64_t*) malloc(size * sizeof(uint64_t));
+    set->num_rows = 0;
+    set->row_begins = (uint64_t*) calloc(size + 1, sizeof(uint64_t));
+    set->row_ends = (uint64_t*) calloc(size + 1, sizeof(uint64_t));
+    set->visited_rows = (uint64_t*) malloc((size + 2) * sizeof(uint64_t));
+    set->columns = (int64_t*) malloc((size + 2) * sizeof(int64_t));
+    set->column_counts = (uint8_t*) malloc((size + 2) * sizeof(uint8_t));
+    set->column_sums = false;
+
+    return set;
+}
+
+void build_live_set(gol_t* gol) {
+    const uint64_t n = gol->size;
+
+    if (!gol->live_set) {
+        gol->live_set = create_live_set(n);
+    }
+
+    live_set_t* set = gol->live_set;
+
+    // the alive cells of each row are counted first, so that the rows can write their cells concurrently
+#pragma omp parallel for
+    for (uint64_t i = 1; i < n + 1; i++) {
+        const bool* row = &gol->current[idx(gol, i, 1)];
+        uint64_t alive = 0;
+
+        for (uint64_t j = 0; j < n; j++) {
+            alive += row[j];
+        }
+
+        set->row_begins[i] = alive;
+    }
+
+    set->row_begins[0] = 0;
+    for (uint64_t r = 1; r < n + 1; r++) {
+        set->row_begins[r] += set->row_begins[r - 1];
+    }
+
+    set->num_cells = set->row_begins[n];
+    if (set->num_cells > set->cells_capacity) {
+        set->cells_capacity = positions_capacity(set->num_cells);
+        free(set->cells);
+        set->cells = (uint64_t*) malloc(set->cells_capacity * sizeof(uint64_t));
+    }
+
+#pragma omp parallel for
+    for (uint64_t r = 0; r < n; r++) {
+        const bool* row = &gol->current[idx(gol, r + 1, 1)];
+        uint64_t position = set->row_begins[r];
+
+        for (uint64_t j = 0; j < n; j++) {
+            if (row[j]) {
+                set->cells[position++] = r * n + j;
+            }
+        }
+    }
+
+    // from now on the next grid only differs from the current one in the changes
+    memcpy(gol->next, gol->current, count_grid_cells(n) * sizeof(bool));
+
+    if (gol->column_sums) {
+        memcpy(gol->next_column_sums, gol->column_sums, count_grid_cells(n) * sizeof(uint8_t));
+    }
+
+    // the ranges of the rows are found again by the steps, they are empty outside the rows of a step
+    memset(set->row_begins, 0, (n + 1) * sizeof(uint64_t));
+    memset(set->row_ends, 0, (n + 1) * sizeof(uint64_t));
+    set->num_rows = 0;
+    set->num_changes = 0;
+}
+
+/**
+ * Frees the grids and the column sums of a sparse layer, unless they are kept or not owned by the layer.
+ */
+static void drop_grids(gol_t* gol) {
+    if (!gol->live_set || !gol->current || !gol->owns_grids || gol->keep_grids) {
+        return;
+    }
+
+    gol->live_set->column_sums = gol->column_sums != NULL;
+
+    free_grid(gol->current, gol->size);
+    free_grid(gol->next, gol->size);
+    free_grid(gol->column_sums, gol->size);
+    free_grid(gol->next_column_sums, gol->size);
+
+    gol->current = NULL;
+    gol->next = NULL;
+    gol->column_sums = NULL;
+    gol->next_column_sums = NULL;
+}
+
+void restore_grids(gol_t* gol) {
+    live_set_t* set = gol->live_set;
+
+    if (!set || gol->current) {
+        return;
+    }
+
+    const uint64_t n = gol->size;
+    const size_t size = count_grid_cells(n) * sizeof(bool);
+
+    gol->current = (bool*) allocate_grid(n);
+    gol->next = (bool*) allocate_grid(n);
+
+    for (uint64_t c = 0; c < set->num_cells; c++) {
+        gol->current[idx(gol, set->cells[c] / n + 1, set->cells[c] % n + 1)] = true;
+    }
+
+    fill_ghost_cells(gol);
+
+    // the next grid holds the previous state, the current one without the changes of the last step
+    memcpy(gol->next, gol->current, size);
+
+    for (uint64_t c = 0; c < set->num_changes; c++) {
+        const size_t cell = idx(gol, set->changes[c] / n + 1, set->changes[c] % n + 1);
+
+        gol->next[cell] = !gol->next[cell];
+    }
+
+    if (set->column_sums) {
+        gol->column_sums = (uint8_t*) allocate_grid(n);
+        gol->next_column_sums = (uint8_t*) allocate_grid(n);
+        calculate_column_sums(gol, 1, n + 1);
+
+        // the column sums of the next grid are calculated with the grids swapped
+        swap_grids(gol);
+        calculate_column_sums(gol, 1, n + 1);
+        swap_grids(gol);
+    }
+}
+
+void set_keep_grids(gol_t* gol, const bool keep) {
+    gol->keep_grids = keep;
+
+    if (keep) {
+        restore_grids(gol);
+    } else {
+        drop_grids(gol);
+    }
+}
+
+void release_live_set(gol_t* gol) {
+    live_set_t* set = gol->live_set;
+
+    if (!set) {
+        return;
+    }
+
+    // the dense kernels that read the ghost cells expect them up to date
+    restore_grids(gol);
+    fill_ghost_cells(gol);
+
+    free(set->cells);
+    free(set->next_cells);
+    free(set->changes);
+    free(set->next_changes);
+    free(set->rows);
+    free(set->row_begins);
+    free(set->row_ends);
+    free(set->visited_rows);
+    free(set->columns);
+    free(set->column_counts);
+    free(set);
+
+    gol->live_set = NULL;
+}
+
+void update_representation(gol_t* gol) {
+    const uint64_t cells = gol->size * gol->size;
+    bool sparse = gol->representation != REPRESENTATION_DENSE && can_use_live_set(gol);
+
+    if (sparse && gol->representation == REPRESENTATION_AUTO) {
+        sparse = gol->live_set ? gol->stats.alive * SPARSE_EXIT_RATIO <= cells : gol->stats.alive * SPARSE_ENTER_RATIO < cells;
+    }
+
+    if (sparse && !gol->live_set) {
+        build_live_set(gol);
+    } else if (!sparse && gol->live_set) {
+        release_live_set(gol);
+    }
+
+    if (sparse) {
+        drop_grids(gol);
+    }
+}
+
+void set_representation(gol_t* gol, const representation_t representation) {
+    gol->representation = representation;
+
+    update_representation(gol);
+}
+
+/**
+ * Sets a cell (i, j) of the next grid, the column sums of the next grid are updated from the cell to the end of its chunk.
+ */
+static inline void set_next_cell(const gol_t* gol, const uint64_t i, const uint64_t j, const bool alive) {
+    const size_t cell = idx(gol, i, j);
+
+    if (gol->next[cell] == alive) {
+        return;
+    }
+
+    gol->next[cell] = alive;
+
+    if (gol->next_column_sums) {
+        const uint64_t chunk_last = (i - 1) / COLUMN_SUMS_ROWS * COLUMN_SUMS_ROWS + COLUMN_SUMS_ROWS;
+        const uint64_t last_row = chunk_last < gol->size ? chunk_last : gol->size;
+        const uint8_t delta = alive ? 1 : (uint8_t) -1;
+
+        for (uint64_t r = i; r <= last_row; r++) {
+            gol->next_column_sums[idx(gol, r, j)] += delta;
+        }
+    }
+}
+
+/**
+ * Calculates the next state of the columns of row t (from 0) next to an alive cell of the rows around it,
+ * the alive cells and the changes are appended to the next cells and the next changes. Returns the births among the changes.
+ */
+static uint64_t step_live_row(const gol_t* gol, live_set_t* set, const uint64_t t) {
+    const uint64_t n = gol->size;
+    const uint64_t rows[3] = { (t + n - 1) % n, t, (t + 1) % n };
+    uint64_t heads[3], ends[3];
+
+    for (int r = 0; r < 3; r++) {
+        heads[r] = set->row_begins[rows[r]];
+        ends[r] = set->row_ends[rows[r]];
+    }
+
+    // the columns with an alive cell in the 3 rows and how many of the 3 rows have it, from index 1
+    int64_t* columns = set->columns;
+    uint8_t* counts = set->column_counts;
+    uint64_t m = 0;
+
+    while (heads[0] < ends[0] || heads[1] < ends[1] || heads[2] < ends[2]) {
+        uint64_t column = n;
+
+        for (int r = 0; r < 3; r++) {
+            if (heads[r] < ends[r] && set->cells[heads[r]] - rows[r] * n < column) {
+                column = set->cells[heads[r]] - rows[r] * n;
+            }
+        }
+
+        uint8_t count = 0;
+        for (int r = 0; r < 3; r++) {
+            if (heads[r] < ends[r] && set->cells[heads[r]] - rows[r] * n == column) {
+                heads[r]++;
+                count++;
+            }
+        }
+
+        columns[1 + m] = (int64_t) column;
+        counts[1 + m] = count;
+        m++;
+    }
+
+    // the last and the first column are repeated on the other side, so that the squares at the edges are wrapped
+    uint64_t first = 1;
+    uint64_t last = 1 + m;
+
+    if (columns[m] == (int64_t) n - 1) {
+        columns[0] = -1;
+        counts[0] = counts[m];
+        first = 0;
+    }
+
+    if (columns[1] == 0) {
+        columns[last] = (int64_t) n;
+        counts[last] = counts[1];
+        last++;
+    }
+
+    const rule_t rule = gol->rule;
+    const uint64_t* alive = set->cells + set->row_begins[t];
+    const uint64_t* alive_end = set->cells + set->row_ends[t];
+    int64_t previous = -1;
+    uint64_t window = first;
+    uint64_t births = 0;
+
+    // the columns next to the merged ones, in order: the square of a column only holds merged columns at most 1 away from it
+    for (uint64_t k = first; k < last; k++) {
+        for (int64_t x = columns[k] - 1; x <= columns[k] + 1; x++) {
+            if (x <= previous || x < 0 || x >= (int64_t) n) {
+                continue;
+            }
+            previous = x;
+
+            while (columns[window] < x - 1) {
+                window++;
+            }
+
+            // alive cells of the 3x3 square, the cell included
+            uint8_t square = 0;
+            for (uint64_t w = window; w < last && columns[w] <= x + 1; w++) {
+                square += counts[w];
+            }
+
+            const uint64_t position = t * n + (uint64_t) x;
+            while (alive < alive_end && *alive < position) {
+                alive++;
+            }
+
+            const bool is_alive = alive < alive_end && *alive == position;
+            const bool next_state = is_alive ? (rule.survive >> (square - 1)) & 1 : (rule.birth >> square) & 1;
+
+            if (next_state) {
+                push_position(&set->next_cells, &set->num_next_cells, &set->next_cells_capacity, position);
+            }
+
+            if (next_state != is_alive) {
+                push_position(&set->next_changes, &set->num_next_changes, &set->next_changes_capacity, position);
+                births += next_state;
+            }
+        }
+    }
+
+    return births;
+}
+
+void step_live_set(gol_t* gol) {
+    live_set_t* set = gol->live_set;
+    const uint64_t n = gol->size;
+
+    // the next grid becomes a copy of the current one again, it only differed in the cells changed by the last step
+    for (uint64_t c = 0; gol->current && c < set->num_changes; c++) {
+        const uint64_t i = set->changes[c] / n + 1;
+        const uint64_t j = set->changes[c] % n + 1;
+
+        set_next_cell(gol, i, j, gol->current[idx(gol, i, j)]);
+    }
+
+    // the ranges of the rows of the last step are emptied, then the ones of the rows of the cells are set, the cells are in order
+    for (uint64_t r = 0; r < set->num_rows; r++) {
+        set->row_begins[set->rows[r]] = 0;
+        set->row_ends[set->rows[r]] = 0;
+    }
+
+    set->num_rows = 0;
+    for (uint64_t c = 0; c < set->num_cells; c++) {
+        const uint64_t row = set->cells[c] / n;
+
+        if (set->num_rows == 0 || set->rows[set->num_rows - 1] != row) {
+            set->rows[set->num_rows++] = row;
+            set->row_begins[row] = c;
+        }
+        set->row_ends[row] = c + 1;
+    }
+
+    // the rows next to an alive cell, in order: the last row wraps to the first one and the first to the last one
+    uint64_t num_visited = 0;
+    int64_t last_visited = -1;
+
+    if (set->num_rows > 0 && set->rows[set->num_rows - 1] == n - 1) {
+        set->visited_rows[num_visited++] = 0;
+        last_visited = 0;
+    }
+
+    for (uint64_t r = 0; r < set->num_rows; r++) {
+        for (int64_t t = (int64_t) set->rows[r] - 1; t <= (int64_t) set->rows[r] + 1; t++) {
+            if (t > last_visited && t < (int64_t) n) {
+                set->visited_rows[num_visited++] = (uint64_t) t;
+                last_visited = t;
+            }
+        }
+    }
+
+    if (set->num_rows > 0 && set->rows[0] == 0 && last_visited < (int64_t) n - 1) {
+        set->visited_rows[num_visited++] = n - 1;
+    }
+
+    set->num_next_cells = 0;
+    set->num_next_changes = 0;
+
+    uint64_t births = 0;
+    for (uint64_t v = 0; v < num_visited; v++) {
+        births += step_live_row(gol, set, set->visited_rows[v]);
+    }
+
+    // the changes are written to the next grid, if the layer has its grids
+    for (uint64_t k = 0; k < set->num_next_changes; k++) {
+        const uint64_t i = set->next_changes[k] / n + 1;
+        const uint64_t j = set->next_changes[k] % n + 1;
+
+        if (gol->next) {
+            set_next_cell(gol, i, j, !gol->current[idx(gol, i, j)]);
+        }
+        gol->next_changed_tiles[((i - 1) / ACTIVITY_TILE_SIZE) * gol->tiles_per_side + (j - 1) / ACTIVITY_TILE_SIZE] = 1;
+    }
+
+    gol->next_stats.births += births;
+    gol->next_stats.deaths += set->num_next_changes - births;
+
+    uint64_t* cells = set->cells;
+    set->cells = set->next_cells;
+    set->next_cells = cells;
+    set->num_cells = set->num_next_cells;
+
+    uint64_t capacity = set->cells_capacity;
+    set->cells_capacity = set->next_cells_capacity;
+    set->next_cells_capacity = capacity;
+
+    uint64_t* changes = set->changes;
+    set->changes = set->next_changes;
+    set->next_changes = changes;
+    set->num_changes = set->num_next_changes;
+
+    capacity = set->changes_capacity;
+    set->changes_capacity = set->next_changes_capacity;
+    set->next_changes_capacity = capacity;
+
+    complete_step(gol);
+}
+
+/**
+ * Returns the index of the first cell of the live set at or after the given position.
+ */
+static uint64_t lower_bound_cell(const live_set_t* set, const uint64_t position) {
+    uint64_t low = 0;
+    uint64_t high = set->num_cells;
+
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+
+        if (set->cells[middle] < position) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+void add_live_set_columns(const gol_t* gol, const uint64_t i, const uint64_t radius, uint16_t* sums) {
+    const live_set_t* set = gol->live_set;
+    const uint64_t n = gol->size;
+
+    // the rows are wrapped on the torus, more than once if the window is larger than the grid
+    for (uint64_t d = 0; d < 2 * radius + 1; d++) {
+        const uint64_t row = (i - 1 + (d + (radius / n + 1) * n - radius)) % n;
+        const uint64_t first = lower_bound_cell(set, row * n);
+        const uint64_t last = lower_bound_cell(set, (row + 1) * n);
+
+        for (uint64_t c = first; c < last; c++) {
+            sums[set->cells[c] - row * n]++;
+        }
+    }
+}
@@ -7,31 +7,249 @@
  * Check the Makefile for more details.
  * 
  * How to run (from the openmp directory):
- * ./bin/multilayer-game-of-life <grid_size> <num_layers> <density> <num_steps> <seed>
+ * ./bin/multilayer-game-of-life <grid_size> <num_layers> <num_steps> <create_png> <density> <seed>
  * The parameters are optional, if not provided, the default values are used.
+ * With --stats <file> [--stats-histogram-interval <steps>] the stats of each step are written to the file (binary if it ends with .bin, CSV otherwise),
+ * with the dependent histogram every given steps.
+ * With --preview <size> [--preview-levels <levels>] downsampled PNGs of each step are written to output/preview.
+ * With --viewport <row>,<col>,<height>,<width> (repeatable) the PNGs of the region are written to output/viewport.
+ * With --replay <file> [--keyframe-interval <steps>] the whole run is recorded in a delta-encoded replay file.
+ * With --rule <rule>[,<rule>...] the layers use the given Life-like rules (e.g. B36/S23), repeated over the layers,
+ * the option can be repeated, e.g. for Larger than Life rules (R5,C0,M1,S34..58,B34..45,NM) that already contain commas.
+ * With --dependent-radius <radius> the neighborhoods of the dependent grid are the squares of the given radius.
+ * With --telemetry <socket> the progress of the run is served on a unix socket, a JSON snapshot per connection.
+ * With --serve <port|socket> [--serve-size <pixels>] the latest frames are served over HTTP on 127.0.0.1 or a unix socket.
+ * With --workload <file> the initial state is set by the workload file (soups and RLE or plaintext patterns, see the workloads directory).
+ *
+ * To run many configurations in a single process (batch mode):
+ * ./bin/multilayer-game-of-life --batch <config_file> [summary_file]
+ *
+ * To create the PNGs of a step of a replay file (in output/combined and output/dependent):
+ * ./bin/multilayer-game-of-life --replay-frame <replay_file> <step>
+ *
+ * To tune the schedule of a configuration on this machine (used by the following runs):
+ * ./bin/multilayer-game-of-life --autotune <grid_size> <num_layers>
+ *
+ * To run a strong and weak scaling study and write its JSON report:
+ * ./bin/multilayer-game-of-life --scaling <grid_size> <num_layers> <num_steps> [report_file]
+ *
+ * To check the state hashes and the timings of the fixed workloads against the golden and baseline files (make perfcheck),
+ * or to write them from this build:
+ * ./bin/multilayer-game-of-life --perfcheck <golden_file> <baseline_file> [tolerance] [--strict]
+ * ./bin/multilayer-game-of-life --perfcheck-update <golden_file> <baseline_file>
  */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 #include <omp.h>
 
 #include "converter.h"
 #include "ml_gol.h"
+#include "batch.h"
+#include "autotune.h"
+#include "replay.h"
+#include "stats.h"
+#include "scaling.h"
+#include "frame_server.h"
+#include "perfcheck.h"
 
 #define DEFAULT_GRID_SIZE 128
 #define DEFAULT_NUM_LAYERS 3
 #define DEFAULT_NUM_STEPS 64
 #define DEFAULT_CREATE_PNG true
 #define DEFAULT_DENSITY 0.3
+#define DEFAULT_BATCH_SUMMARY "output/batch_summary.csv"
+#define DEFAULT_SCALING_REPORT "output/scaling.json"
+#define DEFAULT_PREVIEW_LEVELS 1
+#define MAX_RULES 16
 
 int main(int argc, char *argv[]) {
+
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s --batch <config_file> [summary_file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        double tstart = omp_get_wtime();
+
+        if (start_batch(argv[2], argc > 3 ? argv[3] : DEFAULT_BATCH_SUMMARY) != 0) {
+            return EXIT_FAILURE;
+        }
+
+        printf("Elapsed time: %f\n", omp_get_wtime() - tstart);
+
+        return EXIT_SUCCESS;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--replay-frame") == 0) {
+        if (argc < 4) {
+            fprintf(stderr, "Usage: %s --replay-frame <replay_file> <step>\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        replay_reader_t reader;
+        if (open_replay_reader(&reader, argv[2]) != 0) {
+            return EXIT_FAILURE;
+        }
+
+        uint64_t replay_step = strtoull(argv[3], NULL, 10);
+        if (seek_replay(&reader, replay_step) != 0) {
+            fprintf(stderr, "Step %ld is not in %s (last step %ld)\n", replay_step, argv[2], get_replay_last_step(&reader));
+            close_replay_reader(&reader);
+            return EXIT_FAILURE;
+        }
+
+        create_png_for_step(get_replay_ml_gol(&reader), replay_step);
+        printf("Created the PNGs of step %ld of %s\n", replay_step, argv[2]);
+
+        close_replay_reader(&reader);
+
+        return EXIT_SUCCESS;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--autotune") == 0) {
+        uint64_t tune_grid_size = argc > 2 ? atouint64(argv[2]) : DEFAULT_GRID_SIZE;
+        uint64_t tune_num_layers = argc > 3 ? atouint64(argv[3]) : DEFAULT_NUM_LAYERS;
+
+        if (tune_grid_size == 0 || tune_num_layers == 0 || tune_num_layers > MAX_NUM_LAYERS) {
+            fprintf(stderr, "Usage: %s --autotune <grid_size> <num_layers>\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        printf("Tuning grid size %ld with %ld layers and up to %d threads\n", tune_grid_size, tune_num_layers, omp_get_max_threads());
+
+        schedule_t schedule = autotune_schedule(tune_grid_size, tune_num_layers, omp_get_max_threads());
+
+        if (save_tuned_schedule(tuning_cache_filename(), tune_grid_size, tune_num_layers, schedule) != 0) {
+            return EXIT_FAILURE;
+        }
+
+        printf("Best schedule: %s, %d threads, tile %ld, %s kernel (saved to %s)\n",
+            schedule_strategy_name(schedule.strategy), schedule.num_threads, schedule.tile_size, kernel_name(schedule.kernel), tuning_cache_filename());
+
+        return EXIT_SUCCESS;
+    }
     
+    if (argc > 1 && (strcmp(argv[1], "--perfcheck") == 0 || strcmp(argv[1], "--perfcheck-update") == 0)) {
+        const bool update = strcmp(argv[1], "--perfcheck-update") == 0;
+        const bool strict = argc > 4 && strcmp(argv[argc - 1], "--strict") == 0;
+        double tolerance = argc > 4 + strict ? atof(argv[4]) : DEFAULT_PERF_TOLERANCE;
+
+        if (argc < 4 || argc > 5 + strict || tolerance <= 0) {
+            fprintf(stderr, "Usage: %s --perfcheck <golden_file> <baseline_file> [tolerance] [--strict]\n", argv[0]);
+            fprintf(stderr, "       %s --perfcheck-update <golden_file> <baseline_file>\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        int result = update ? update_perfcheck(argv[2], argv[3]) : run_perfcheck(argv[2], argv[3], tolerance, strict);
+
+        return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--scaling") == 0) {
+        uint64_t scaling_grid_size = argc > 2 ? atouint64(argv[2]) : DEFAULT_GRID_SIZE;
+        uint64_t scaling_num_layers = argc > 3 ? atouint64(argv[3]) : DEFAULT_NUM_LAYERS;
+        uint64_t scaling_num_steps = argc > 4 ? atouint64(argv[4]) : DEFAULT_NUM_STEPS;
+        const char* report_filename = argc > 5 ? argv[5] : DEFAULT_SCALING_REPORT;
+
+        if (scaling_grid_size == 0 || scaling_num_layers == 0 || scaling_num_layers > MAX_NUM_LAYERS || scaling_num_steps == 0) {
+            fprintf(stderr, "Usage: %s --scaling <grid_size> <num_layers> <num_steps> [report_file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        printf("Scaling study of grid size %ld with %ld layers and up to %d threads\n", scaling_grid_size, scaling_num_layers, omp_get_max_threads());
+
+        scaling_report_t report;
+        run_scaling_study(&report, scaling_grid_size, scaling_num_layers, scaling_num_steps, omp_get_max_threads());
+
+        int result = write_scaling_report(report_filename, &report);
+        free_scaling_report(&report);
+
+        if (result != 0) {
+            return EXIT_FAILURE;
+        }
+
+        printf("Report written to %s\n", report_filename);
+
+        return EXIT_SUCCESS;
+    }
+
     uint64_t grid_size = DEFAULT_GRID_SIZE;
     uint64_t num_layers = DEFAULT_NUM_LAYERS;
     uint64_t num_steps = DEFAULT_NUM_STEPS;
     bool create_png = DEFAULT_CREATE_PNG;
     float density = DEFAULT_DENSITY;
     uint64_t seed = time(NULL);
+    const char* stats_filename = NULL;
+    uint64_t stats_histogram_interval = DEFAULT_STATS_HISTOGRAM_INTERVAL;
+    uint64_t preview_size = 0;
+    uint64_t preview_levels = DEFAULT_PREVIEW_LEVELS;
+    viewport_t viewports[MAX_VIEWPORTS];
+    uint64_t num_viewports = 0;
+    const char* replay_filename = NULL;
+    uint64_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+    rule_t rules[MAX_RULES];
+    uint64_t num_rules = 0;
+    uint64_t dependent_radius = 1;
+    const char* telemetry_socket = NULL;
+    const char* frame_server_address = NULL;
+    uint64_t frame_size = DEFAULT_FRAME_SIZE;
+    const char* workload_filename = NULL;
+
+    // the options can be anywhere, the other arguments are positional
+    int num_args = 1;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--stats") == 0 && a + 1 < argc) {
+            stats_filename = argv[++a];
+        } else if (strcmp(argv[a], "--stats-histogram-interval") == 0 && a + 1 < argc) {
+            stats_histogram_interval = atouint64(argv[++a]);
+        } else if (strcmp(argv[a], "--preview") == 0 && a + 1 < argc) {
+            preview_size = atouint64(argv[++a]);
+        } else if (strcmp(argv[a], "--preview-levels") == 0 && a + 1 < argc) {
+            preview_levels = atouint64(argv[++a]);
+        } else if (strcmp(argv[a], "--viewport") == 0 && a + 1 < argc) {
+            if (num_viewports == MAX_VIEWPORTS || parse_viewport(argv[++a], &viewports[num_viewports]) != 0) {
+                fprintf(stderr, "Invalid viewport %s, the format is <row>,<col>,<height>,<width> (at most %d)\n", argv[a], MAX_VIEWPORTS);
+                return EXIT_FAILURE;
+            }
+            num_viewports++;
+        } else if (strcmp(argv[a], "--replay") == 0 && a + 1 < argc) {
+            replay_filename = argv[++a];
+        } else if (strcmp(argv[a], "--keyframe-interval") == 0 && a + 1 < argc) {
+            keyframe_interval = atouint64(argv[++a]);
+        } else if (strcmp(argv[a], "--rule") == 0 && a + 1 < argc) {
+            // a Larger than Life rule is a single rule with commas, the other ones are lists of rules
+            if (num_rules < MAX_RULES && parse_rule(argv[a + 1], &rules[num_rules]) == 0) {
+                num_rules++;
+                a++;
+                continue;
+            }
+
+            char* save = NULL;
+            for (char* rule = strtok_r(argv[++a], ",", &save); rule; rule = strtok_r(NULL, ",", &save)) {
+                if (num_rules == MAX_RULES || parse_rule(rule, &rules[num_rules]) != 0) {
+                    fprintf(stderr, "Invalid rule %s, the format is B<counts>/S<counts> or R<radius>,C0,M<0|1>,S<min>..<max>,B<min>..<max>,NM (at most %d)\n", rule, MAX_RULES);
+                    return EXIT_FAILURE;
+                }
+                num_rules++;
+            }
+        } else if (strcmp(argv[a], "--dependent-radius") == 0 && a + 1 < argc) {
+            dependent_radius = atouint64(argv[++a]);
+        } else if (strcmp(argv[a], "--telemetry") == 0 && a + 1 < argc) {
+            telemetry_socket = argv[++a];
+        } else if (strcmp(argv[a], "--serve") == 0 && a + 1 < argc) {
+            frame_server_address = argv[++a];
+        } else if (strcmp(argv[a], "--serve-size") == 0 && a + 1 < argc) {
+            frame_size = atouint64(argv[++a]);
+        } else if (strcmp(argv[a], "--workload") == 0 && a + 1 < argc) {
+            workload_filename = argv[++a];
+        } else {
+            argv[num_args++] = argv[a];
+        }
+    }
+    argc = num_args;
 
     if (argc > 1) {
         grid_size = atouint64(argv[1]);
@@ -50,14 +268,14 @@ int main(int argc, char *argv[]) {
     }
 
     if (argc > 5) {
-        density = atof(argv[4]);
+        density = atof(argv[5]);
     }
 
     if (argc > 6) {
-        seed = atouint64(argv[4]);
+        seed = atouint64(argv[6]);
     }
 
-    if (grid_size == 0 || num_layers == 0 || num_steps == 0) {
+    if (grid_size == 0 || num_layers == 0 || num_steps == 0 || frame_size == 0) {
         fprintf(stderr, "Invalid input\n");
         return EXIT_FAILURE;
     }
@@ -68,7 +286,12 @@ int main(int argc, char *argv[]) {
     double tstart, tstop;
     tstart = omp_get_wtime();
 
-    start_game(grid_size, num_layers, num_steps, create_png, density, seed);
+    output_options_t outputs = { create_png, stats_filename, stats_histogram_interval, preview_size, preview_levels, viewports, num_viewports, replay_filename, keyframe_interval, telemetry_socket,
+        frame_server_address, frame_size };
+    rule_options_t rule_options = { rules, num_rules, dependent_radius, workload_filename };
+    if (start_game(grid_size, num_layers, num_steps, outputs, rule_options, density, seed) != 0) {
+        return EXIT_FAILURE;
+    }
 
     tstop = omp_get_wtime();
     printf("Elapsed time: %f\n", tstop - tstart);
@@ -1,53 +1,836 @@
 #include "ml_gol.h"
+#include "autotune.h"
+#include "stats.h"
+#include "preview.h"
+#include "viewport.h"
+#include "replay.h"
+#include "frame_server.h"
+#include "pattern.h"
+#include "live_set.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <omp.h>
 
-void start_game(const uint64_t grid_size, const uint64_t num_layers, const uint64_t num_steps, const bool create_png, const float density, const uint64_t seed) {
-    ml_gol_t* ml_gol = (ml_gol_t*) malloc(sizeof(ml_gol_t));
+// the rows of the thread histograms are padded to a cache line, so that the threads do not share them
+#define HISTOGRAM_ALIGNMENT 8
+
+/**
+ * Returns the number of cells in the neighborhoods of the dependent grid with the given radius.
+ */
+static uint64_t neighborhood_cells(const uint64_t radius) {
+    return (2 * radius + 1) * (2 * radius + 1);
+}
+
+/**
+ * Returns the distance between two rows of the histograms, padded to a cache line.
+ * They have room for the bins of the largest dependent radius, so that the radius can be changed.
+ */
+static uint64_t histogram_stride(const uint64_t num_layers) {
+    uint64_t bins = neighborhood_cells(MAX_RULE_RADIUS) * num_layers + 1;
+    return (bins + HISTOGRAM_ALIGNMENT - 1) / HISTOGRAM_ALIGNMENT * HISTOGRAM_ALIGNMENT;
+}
+
+/**
+ * Returns the number of histograms (the merged one and one per thread) of an instance.
+ */
+static size_t count_histograms(void) {
+    return 1 + omp_get_max_threads();
+}
+
+/**
+ * Points the dependent histogram and the thread histograms to the given buffer and clears them.
+ */
+static void init_histograms(ml_gol_t* ml_gol, uint64_t* histograms, const size_t num_histograms) {
+    const uint64_t stride = histogram_stride(ml_gol->num_layers);
+
+    ml_gol->dependent_histogram = histograms;
+    ml_gol->thread_histograms = histograms + stride;
+    ml_gol->num_thread_histograms = (int) (num_histograms - 1);
+
+    memset(histograms, 0, num_histograms * stride * sizeof(uint64_t));
+}
+
+static void png_step_callback(const ml_gol_t* ml_gol, void* user_data) {
+    (void) user_data;
+
+    create_png_for_step(ml_gol, ml_gol->step);
+}
+
+int start_game(const uint64_t grid_size, const uint64_t num_layers, const uint64_t num_steps, const output_options_t outputs,
+        const rule_options_t rules, const float density, const uint64_t seed) {
+    if (num_layers > MAX_NUM_LAYERS) {
+        fprintf(stderr, "Too many layers %ld, the dependent counts fit at most %d\n", num_layers, MAX_NUM_LAYERS);
+        return -1;
+    }
+
+    // the server is started first, so that the setup can be observed too (the step 0 is the initial state, the last one is num_steps - 1)
+    telemetry_t telemetry;
+    bool serve_telemetry = false;
+
+    if (outputs.telemetry_socket) {
+        init_telemetry(&telemetry, num_layers, num_steps - 1);
+        serve_telemetry = start_telemetry_server(&telemetry, outputs.telemetry_socket) == 0;
+
+        if (serve_telemetry) {
+            printf("Telemetry available on %s\n", outputs.telemetry_socket);
+        } else {
+            free_telemetry(&telemetry);
+        }
+    }
+
+    // the full resolution grids are only needed by the full frames, the stats calculate the histogram of the dependent grid when they need it
+    ml_gol_t* ml_gol = create_ml_gol_with_derived_grids(grid_size, num_layers, density, seed, outputs.create_png);
+
+    for (uint64_t layer = 0; rules.rules && rules.num_rules > 0 && layer < num_layers; layer++) {
+        set_layer_rule(ml_gol, layer, rules.rules[layer % rules.num_rules]);
+    }
+
+    if (rules.dependent_radius > 1 && set_dependent_radius(ml_gol, rules.dependent_radius) != 0) {
+        fprintf(stderr, "Invalid dependent radius %ld, using 1\n", rules.dependent_radius);
+    }
+
+    // the workload is loaded once the rules are set, so that the refresh calculates the state of the dependent grid with its radius
+    if (rules.workload_filename && load_workload(ml_gol, rules.workload_filename) != 0) {
+        if (serve_telemetry) {
+            stop_telemetry_server(&telemetry);
+            free_telemetry(&telemetry);
+        }
+
+        free_ml_gol(ml_gol);
+        return -1;
+    }
+
+    if (rules.workload_filename) {
+        printf("Loaded workload %s\n", rules.workload_filename);
+    }
+
+    printf("Initialized multilayer game of life with %ld layers and grid size %ld\n", num_layers, grid_size);
+    
+    print_layers_colors(ml_gol);
+    print_layers_rules(ml_gol);
+
+    if (outputs.create_png) {
+        create_png_for_step(ml_gol, 0);
+        add_step_callback(ml_gol, png_step_callback, NULL);
+    }
+
+    stats_writer_t stats_writer;
+    bool write_stats = outputs.stats_filename && open_stats_writer(&stats_writer, outputs.stats_filename, ml_gol, outputs.stats_histogram_interval) == 0;
+
+    if (write_stats) {
+        write_stats_record(&stats_writer, ml_gol);
+        add_step_callback(ml_gol, stats_step_callback, &stats_writer);
+    }
+
+    preview_t preview;
+    if (outputs.preview_size > 0) {
+        init_preview(&preview, ml_gol, outputs.preview_size, outputs.preview_levels);
+        preview_step_callback(ml_gol, &preview);
+        add_step_callback(ml_gol, preview_step_callback, &preview);
+    }
+
+    viewport_output_t viewport_output;
+    if (outputs.num_viewports > 0) {
+        init_viewport_output(&viewport_output, ml_gol, outputs.viewports, outputs.num_viewports);
+        viewports_step_callback(ml_gol, &viewport_output);
+        add_step_callback(ml_gol, viewports_step_callback, &viewport_output);
+    }
+
+    replay_writer_t replay_writer;
+    bool write_replay = outputs.replay_filename && open_replay_writer(&replay_writer, outputs.replay_filename, ml_gol, outputs.keyframe_interval) == 0;
+
+    if (write_replay) {
+        add_step_callback(ml_gol, replay_step_callback, &replay_writer);
+    }
+
+    // the frames are only calculated when a viewer asks for them
+    frame_server_t frame_server;
+    bool serve_frames = false;
+
+    if (outputs.frame_server_address) {
+        init_frame_server(&frame_server, ml_gol, outputs.frame_size);
+        serve_frames = start_frame_server(&frame_server, outputs.frame_server_address) == 0;
+
+        if (serve_frames) {
+            printf("Serving live frames on %s\n", outputs.frame_server_address);
+            add_step_callback(ml_gol, frame_server_step_callback, &frame_server);
+        } else {
+            free_frame_server(&frame_server);
+        }
+    }
+
+    // the sparse layers only keep their live sets when no output reads their grids at each step
+    set_layers_grids(ml_gol, outputs.preview_size > 0 || outputs.num_viewports > 0 || write_replay || serve_frames);
+
+    // a schedule tuned on this machine is preferred to the one predicted by the cost model
+    schedule_t schedule;
+    if (load_tuned_schedule(tuning_cache_filename(), grid_size, num_layers, &schedule) == 0) {
+        printf("Loaded tuned schedule from %s\n", tuning_cache_filename());
+
+        if (schedule.num_threads > omp_get_max_threads()) {
+            schedule.num_threads = omp_get_max_threads();
+        }
+    } else {
+        cost_model_t model;
+        measure_cost_model(&model, omp_get_max_threads());
+        schedule = choose_schedule(&model, grid_size, num_layers);
+        free_cost_model(&model);
+    }
+    set_schedule(ml_gol, schedule);
+
+    // the strategy can be forced, e.g. to compare it with the chosen one
+    const char* forced_strategy = getenv("MLGOL_SCHEDULE");
+    if (forced_strategy && parse_schedule_strategy(forced_strategy, &ml_gol->schedule.strategy) != 0) {
+        fprintf(stderr, "Unknown schedule %s, using %s\n", forced_strategy, schedule_strategy_name(ml_gol->schedule.strategy));
+    }
+
+    // and the representation of the layers, e.g. to compare the live sets with the dense kernels
+    const char* forced_representation = getenv("MLGOL_REPRESENTATION");
+    representation_t representation;
+
+    if (forced_representation && parse_representation(forced_representation, &representation) == 0) {
+        set_layers_representation(ml_gol, representation);
+    } else if (forced_representation) {
+        fprintf(stderr, "Unknown representation %s, using %s\n", forced_representation, representation_name(REPRESENTATION_AUTO));
+    }
+
+    printf("Starting simulation with %ld steps, %s schedule, %s kernel and %d threads\n", num_steps, schedule_strategy_name(ml_gol->schedule.strategy), kernel_name(ml_gol->schedule.kernel), ml_gol->schedule.num_threads);
+
+    if (serve_telemetry) {
+        set_telemetry(ml_gol, &telemetry);
+    }
+
+    step_ml_gol(ml_gol, num_steps - 1);
+
+    if (serve_telemetry) {
+        stop_telemetry_server(&telemetry);
+        free_telemetry(&telemetry);
+    }
+
+    if (write_stats) {
+        close_stats_writer(&stats_writer);
+    }
+
+    if (outputs.preview_size > 0) {
+        free_preview(&preview);
+    }
+
+    if (outputs.num_viewports > 0) {
+        free_viewport_output(&viewport_output);
+    }
+
+    if (write_replay) {
+        close_replay_writer(&replay_writer);
+    }
+
+    if (serve_frames) {
+        stop_frame_server(&frame_server);
+        free_frame_server(&frame_server);
+    }
+    
+    free_ml_gol(ml_gol);
+
+    return 0;
+}
+
+/**
+ * Applies the changes of the last step to the dependent counts, the rows are split among the threads of the current team.
+ * The changes of a row touch the row before and the row after it, so the rows are updated in three phases (by row modulo 3)
+ * and the rows updated at the same time never touch the same cells. The last rows, when the size is not a multiple of 3,
+ * and small grids are updated by a single thread. It must be called by all the threads of the team.
+ */
+static void update_dependent_in_team(const ml_gol_t* ml_gol) {
+    const uint64_t size = ml_gol->grid_size;
+    const uint64_t phased_rows = size < 9 ? 0 : size - size % 3;
+
+    for (uint64_t phase = 0; phase < 3; phase++) {
+#pragma omp for schedule(static)
+        for (uint64_t i = phase; i < phased_rows; i += 3) {
+            update_dependent_row(ml_gol, i + 1);
+        }
+    }
+
+#pragma omp single
+    for (uint64_t i = phased_rows; i < size; i++) {
+        update_dependent_row(ml_gol, i + 1);
+    }
+}
+
+/**
+ * Returns whether at least one layer is stepped from a live set.
+ */
+static bool has_live_sets(const ml_gol_t* ml_gol) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        if (ml_gol->layers[layer].live_set) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Returns whether all the layers are stepped from live sets, so that the derived grids can be updated from their changes.
+ */
+static bool has_only_live_sets(const ml_gol_t* ml_gol) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        if (!ml_gol->layers[layer].live_set) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Steps all the layers and calculates the derived grids, the work is split in blocks among the threads of the current team.
+ * The layers with a live set are stepped whole, by one thread each. It must be called by all the threads of the team.
+ */
+static void step_blocks_in_team(ml_gol_t* ml_gol, const uint64_t block_rows, const uint64_t block_cols) {
+    const uint64_t size = ml_gol->grid_size;
+    const uint64_t row_blocks = (size + block_rows - 1) / block_rows;
+    const uint64_t col_blocks = (size + block_cols - 1) / block_cols;
+
+#pragma omp for collapse(3) schedule(static)
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        for (uint64_t rb = 0; rb < row_blocks; rb++) {
+            for (uint64_t cb = 0; cb < col_blocks; cb++) {
+                uint64_t first_row = 1 + rb * block_rows;
+                uint64_t first_col = 1 + cb * block_cols;
+                uint64_t last_row = first_row + block_rows > size + 1 ? size + 1 : first_row + block_rows;
+                uint64_t last_col = first_col + block_cols > size + 1 ? size + 1 : first_col + block_cols;
+
+                if (ml_gol->layers[layer].live_set) {
+                    continue;
+                }
+
+                step_block(&ml_gol->layers[layer], first_row, last_row, first_col, last_col);
+            }
+        }
+    }
+
+#pragma omp for
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        gol_t* gol = &ml_gol->layers[layer];
+
+        if (gol->live_set) {
+            step_live_set(gol);
+        } else {
+            complete_step(gol);
+        }
+    }
+
+    if (!ml_gol->derived_grids) {
+        return;
+    }
+
+    // the changes of the live sets are few, a single thread applies them
+    if (has_only_live_sets(ml_gol)) {
+#pragma omp single
+        update_derived_from_live_sets(ml_gol);
+        return;
+    }
+
+    // the dependent grid does not read the combined one, the threads can go on without waiting
+    if (ml_gol->combined_grid) {
+#pragma omp for schedule(static) nowait
+        for (uint64_t i = 1; i < size + 1; i++) {
+            update_combined_row(ml_gol, i);
+        }
+    }
+
+    update_dependent_in_team(ml_gol);
+}
+
+static void step_layers_schedule(ml_gol_t* ml_gol) {
+#pragma omp parallel for num_threads(ml_gol->schedule.num_threads)
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        step(&ml_gol->layers[layer]);
+    }
+
+    if (!ml_gol->derived_grids) {
+        return;
+    }
+
+    if (has_only_live_sets(ml_gol)) {
+        update_derived_from_live_sets(ml_gol);
+        return;
+    }
+
+#pragma omp parallel num_threads(ml_gol->schedule.num_threads)
+    {
+        if (ml_gol->combined_grid) {
+#pragma omp for schedule(static) nowait
+            for (uint64_t i = 1; i < ml_gol->grid_size + 1; i++) {
+                update_combined_row(ml_gol, i);
+            }
+        }
+
+        update_dependent_in_team(ml_gol);
+    }
+}
 
-    init_ml_gol(ml_gol, grid_size, num_layers, create_png, density, seed);
+static void end_of_step(ml_gol_t* ml_gol) {
+    ml_gol->step++;
+
+    if (ml_gol->derived_grids) {
+        merge_dependent_histograms(ml_gol);
+    }
+
+    if (ml_gol->telemetry) {
+        record_step_telemetry(ml_gol->telemetry, ml_gol->step, ml_gol->layers);
+    }
+
+    for (int c = 0; c < ml_gol->num_step_callbacks; c++) {
+        ml_gol->step_callbacks[c](ml_gol, ml_gol->callbacks_data[c]);
+    }
+
+    if (ml_gol->telemetry && ml_gol->num_step_callbacks > 0) {
+        record_outputs_telemetry(ml_gol->telemetry);
+    }
+
+    // after the callbacks, that can read the previous state in the next grids (e.g. the replay)
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        update_representation(&ml_gol->layers[layer]);
+    }
+}
+
+static void step_persistent_schedule(ml_gol_t* ml_gol, const uint64_t num_steps) {
+#pragma omp parallel num_threads(ml_gol->schedule.num_threads)
+    for (uint64_t s = 0; s < num_steps; s++) {
+        step_blocks_in_team(ml_gol, 1, ml_gol->grid_size);
+
+        // the callback is called by one thread, the others wait at the end of the single
+#pragma omp single
+        end_of_step(ml_gol);
+    }
+}
+
+/**
+ * Steps the given rows in all the layers, from the grids of the given views to the ones of the next views.
+ * The flags of the tiles of the rows are cleared first, they still hold the step before the previous one.
+ */
+static void step_band(const ml_gol_t* ml_gol, gol_t* views, const gol_t* next_views, const uint64_t first_row, const uint64_t last_row) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        gol_t* gol = &views[layer];
+        const uint64_t first_tile = (first_row - 1) / ACTIVITY_TILE_SIZE * gol->tiles_per_side;
+        const uint64_t last_tile = (last_row - 2) / ACTIVITY_TILE_SIZE * gol->tiles_per_side + gol->tiles_per_side;
+
+        memset(gol->next_changed_tiles + first_tile, 0, (last_tile - first_tile) * sizeof(uint8_t));
+
+        step_block(gol, first_row, last_row, 1, ml_gol->grid_size + 1);
+
+        if (gol->kernel != KERNEL_WRAP) {
+            fill_ghost_rows(&next_views[layer], first_row, last_row);
+        }
+
+        // the bands are whole chunks of the column sums
+        if (gol->column_sums) {
+            calculate_column_sums(&next_views[layer], first_row, last_row);
+        }
+    }
+}
+
+static void update_derived_band(const ml_gol_t* ml_gol, const uint64_t first_row, const uint64_t last_row) {
+    for (uint64_t i = first_row; i < last_row; i++) {
+        if (ml_gol->combined_grid) {
+            update_combined_row(ml_gol, i);
+        }
+        update_dependent_row(ml_gol, i);
+    }
+}
+
+/**
+ * Publishes the stats of the given step from the given views in the next views, and clears them for the step after the next one.
+ * The step is recorded in the telemetry here, since the graph only ends after all its steps.
+ */
+static void publish_band_stats(const ml_gol_t* ml_gol, gol_t* views, gol_t* next_views, const uint64_t step) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        next_views[layer].stats = collect_step_stats(&views[layer]);
+        memset(&views[layer].next_stats, 0, sizeof(gol_stats_t));
+    }
+
+    if (ml_gol->telemetry) {
+        record_step_telemetry(ml_gol->telemetry, step, next_views);
+    }
+}
+
+/**
+ * Performs the given number of steps as a single graph of tasks, the rows are split in bands of TASK_BAND_ROWS.
+ * Each step has a task per band that steps it in all the layers, a task per band that updates its derived grids
+ * and a task that publishes the stats; the dependencies are on the bands each task reads and writes.
+ * The grids are not swapped between the steps: views[0] steps from the current grids of the layers to the next ones and
+ * views[1] the other way around, so a band can start the next step while the other bands are still in the previous one.
+ * The dependent counts of a band are also updated by the bands around it, so their derived tasks are never concurrent,
+ * and they read the bands around it of the new grids for the neighborhoods of a larger dependent radius.
+ */
+static void run_task_graph(ml_gol_t* ml_gol, const uint64_t num_steps) {
+    const uint64_t n = ml_gol->grid_size;
+    const uint64_t num_layers = ml_gol->num_layers;
+    const uint64_t num_bands = (n + TASK_BAND_ROWS - 1) / TASK_BAND_ROWS;
+
+    gol_t* views[2];
+    views[0] = (gol_t*) malloc(2 * num_layers * sizeof(gol_t));
+    views[1] = views[0] + num_layers;
+
+    for (uint64_t layer = 0; layer < num_layers; layer++) {
+        const gol_t* gol = &ml_gol->layers[layer];
+
+        views[0][layer] = *gol;
+        views[1][layer] = *gol;
+        views[1][layer].current = gol->next;
+        views[1][layer].next = gol->current;
+        views[1][layer].column_sums = gol->next_column_sums;
+        views[1][layer].next_column_sums = gol->column_sums;
+        views[1][layer].changed_tiles = gol->next_changed_tiles;
+        views[1][layer].next_changed_tiles = gol->changed_tiles;
+    }
+
+    // the derived grids of a step are updated through the views of its new grids
+    ml_gol_t derived_views[2] = { *ml_gol, *ml_gol };
+    derived_views[0].layers = views[0];
+    derived_views[1].layers = views[1];
+
+    // the objects of the dependencies: the bands of the two grids, the bands of the dependent counts and the stats of the two views
+    char* grid_bands = (char*) malloc(2 * num_bands * sizeof(char));
+    char* count_bands = (char*) malloc(num_bands * sizeof(char));
+    char* stats = (char*) malloc(2 * sizeof(char));
+
+#pragma omp parallel num_threads(ml_gol->schedule.num_threads)
+#pragma omp single
+    for (uint64_t s = 0; s < num_steps; s++) {
+        const uint64_t p = s % 2;
+        gol_t* from = views[p];
+        gol_t* to = views[1 - p];
+        const uint64_t from_bands = p * num_bands;
+        const uint64_t to_bands = (1 - p) * num_bands;
+
+        for (uint64_t b = 0; b < num_bands; b++) {
+            const uint64_t previous = (b + num_bands - 1) % num_bands;
+            const uint64_t next = (b + 1) % num_bands;
+            const uint64_t first_row = 1 + b * TASK_BAND_ROWS;
+            const uint64_t last_row = first_row + TASK_BAND_ROWS < n + 1 ? first_row + TASK_BAND_ROWS : n + 1;
+
+#pragma omp task depend(in: grid_bands[from_bands + previous], grid_bands[from_bands + b], grid_bands[from_bands + next], stats[p]) \
+    depend(out: grid_bands[to_bands + b])
+            step_band(ml_gol, from, to, first_row, last_row);
+        }
+
+        for (uint64_t b = 0; ml_gol->derived_grids && b < num_bands; b++) {
+            const uint64_t previous = (b + num_bands - 1) % num_bands;
+            const uint64_t next = (b + 1) % num_bands;
+            const uint64_t first_row = 1 + b * TASK_BAND_ROWS;
+            const uint64_t last_row = first_row + TASK_BAND_ROWS < n + 1 ? first_row + TASK_BAND_ROWS : n + 1;
+
+#pragma omp task depend(in: grid_bands[from_bands + b], grid_bands[to_bands + previous], grid_bands[to_bands + b], grid_bands[to_bands + next]) \
+    depend(inout: count_bands[previous], count_bands[b], count_bands[next])
+            update_derived_band(&derived_views[1 - p], first_row, last_row);
+        }
+
+        // after all the bands of the step, that read the stats of the view, and before the step after the next one
+#pragma omp task depend(in: stats[1 - p]) depend(inout: stats[p])
+        publish_band_stats(ml_gol, from, to, ml_gol->step + s + 1);
+    }
+
+    // the layers continue from the views of the new grids, the flags of the other step are cleared
+    const gol_t* last_views = views[num_steps % 2];
+
+    for (uint64_t layer = 0; layer < num_layers; layer++) {
+        ml_gol->layers[layer] = last_views[layer];
+        memset(ml_gol->layers[layer].next_changed_tiles, 0, count_activity_tiles(n) * sizeof(uint8_t));
+    }
+
+    free(views[0]);
+    free(grid_bands);
+    free(count_bands);
+    free(stats);
+}
+
+static void step_tasks_schedule(ml_gol_t* ml_gol, const uint64_t num_steps) {
+    for (uint64_t s = 0; s < num_steps;) {
+        // the graph steps the layers by bands, while a layer has a live set the bands are blocks of the rows schedule
+        if (has_live_sets(ml_gol)) {
+#pragma omp parallel num_threads(ml_gol->schedule.num_threads)
+            step_blocks_in_team(ml_gol, TASK_BAND_ROWS, ml_gol->grid_size);
+
+            end_of_step(ml_gol);
+            s++;
+            continue;
+        }
+
+        // the callbacks need the whole state of every step, the steps can only overlap without them,
+        // in graphs of at most TASK_GRAPH_STEPS steps so that the representations are chosen again between them
+        const uint64_t graph_steps = ml_gol->num_step_callbacks > 0 ? 1 : num_steps - s < TASK_GRAPH_STEPS ? num_steps - s : TASK_GRAPH_STEPS;
+
+        run_task_graph(ml_gol, graph_steps);
+
+        ml_gol->step += graph_steps - 1;
+        end_of_step(ml_gol);
+        s += graph_steps;
+    }
+}
+
+void step_ml_gol(ml_gol_t* ml_gol, const uint64_t num_steps) {
+    if (ml_gol->schedule.strategy == SCHEDULE_PERSISTENT) {
+        step_persistent_schedule(ml_gol, num_steps);
+        return;
+    }
+
+    if (ml_gol->schedule.strategy == SCHEDULE_TASKS) {
+        step_tasks_schedule(ml_gol, num_steps);
+        return;
+    }
+
+    for (uint64_t s = 0; s < num_steps; s++) {
+        switch (ml_gol->schedule.strategy) {
+        case SCHEDULE_LAYERS:
+            step_layers_schedule(ml_gol);
+            break;
+        case SCHEDULE_ROWS:
+#pragma omp parallel num_threads(ml_gol->schedule.num_threads)
+            step_blocks_in_team(ml_gol, 1, ml_gol->grid_size);
+            break;
+        case SCHEDULE_TILES:
+#pragma omp parallel num_threads(ml_gol->schedule.num_threads)
+            step_blocks_in_team(ml_gol, ml_gol->schedule.tile_size, ml_gol->schedule.tile_size);
+            break;
+        default:
+            break;
+        }
+
+        end_of_step(ml_gol);
+    }
+}
+
+void set_schedule(ml_gol_t* ml_gol, const schedule_t schedule) {
+    ml_gol->schedule = schedule;
+
+    // each thread needs its own histogram
+    if (ml_gol->schedule.num_threads > ml_gol->num_thread_histograms) {
+        ml_gol->schedule.num_threads = ml_gol->num_thread_histograms;
+    }
+
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        set_kernel(&ml_gol->layers[layer], schedule.kernel);
+    }
+}
+
+/**
+ * Allocates the derived grids that are calculated and frees the ones that are not, unless they are pooled buffers.
+ */
+static void update_derived_buffers(ml_gol_t* ml_gol) {
+    if (!ml_gol->owns_buffers) {
+        return;
+    }
+
+    const size_t cells = ml_gol->grid_size * ml_gol->grid_size;
+    const bool combined = ml_gol->derived_grids && ml_gol->combined_grid;
+
+    if (combined && !ml_gol->combined) {
+        ml_gol->combined = (color_t*) malloc(cells * sizeof(color_t));
+    } else if (!combined) {
+        free(ml_gol->combined);
+        ml_gol->combined = NULL;
+    }
+
+    if (ml_gol->derived_grids && !ml_gol->dependent) {
+        ml_gol->dependent = (color_t*) malloc(cells * sizeof(color_t));
+        ml_gol->dependent_counts = (uint16_t*) malloc(cells * sizeof(uint16_t));
+    } else if (!ml_gol->derived_grids) {
+        free(ml_gol->dependent);
+        free(ml_gol->dependent_counts);
+        ml_gol->dependent = NULL;
+        ml_gol->dependent_counts = NULL;
+    }
+}
+
+/**
+ * Sets whether the sparse layers keep their grids: the derived grids are calculated from them.
+ */
+static void update_layers_grids(const ml_gol_t* ml_gol) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        set_keep_grids(&ml_gol->layers[layer], ml_gol->derived_grids || ml_gol->layers_grids);
+    }
+}
+
+void set_derived_grids(ml_gol_t* ml_gol, const bool derived_grids) {
+    const bool enabled = derived_grids && !ml_gol->derived_grids;
+
+    ml_gol->derived_grids = derived_grids;
+    update_derived_buffers(ml_gol);
+    update_layers_grids(ml_gol);
+
+    if (enabled) {
+        if (ml_gol->combined_grid) {
+            calculate_combined(ml_gol);
+        }
+        calculate_dependent(ml_gol);
+    }
+}
+
+void set_combined_grid(ml_gol_t* ml_gol, const bool combined_grid) {
+    const bool enabled = combined_grid && !ml_gol->combined_grid && ml_gol->derived_grids;
+
+    ml_gol->combined_grid = combined_grid;
+    update_derived_buffers(ml_gol);
+
+    if (enabled) {
+        calculate_combined(ml_gol);
+    }
+}
+
+void set_layers_grids(ml_gol_t* ml_gol, const bool layers_grids) {
+    ml_gol->layers_grids = layers_grids;
+    update_layers_grids(ml_gol);
+}
+
+void set_step_callback(ml_gol_t* ml_gol, const step_callback_t callback, void* user_data) {
+    ml_gol->num_step_callbacks = 0;
+
+    if (callback) {
+        add_step_callback(ml_gol, callback, user_data);
+    }
+}
+
+int add_step_callback(ml_gol_t* ml_gol, const step_callback_t callback, void* user_data) {
+    if (ml_gol->num_step_callbacks == MAX_STEP_CALLBACKS) {
+        return -1;
+    }
+
+    ml_gol->step_callbacks[ml_gol->num_step_callbacks] = callback;
+    ml_gol->callbacks_data[ml_gol->num_step_callbacks] = user_data;
+    ml_gol->num_step_callbacks++;
+
+    return 0;
+}
+
+void set_telemetry(ml_gol_t* ml_gol, telemetry_t* telemetry) {
+    ml_gol->telemetry = telemetry;
+
+    if (telemetry) {
+        begin_telemetry_steps(telemetry);
+    }
+}
+
+void set_layers_representation(ml_gol_t* ml_gol, const representation_t representation) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        set_representation(&ml_gol->layers[layer], representation);
+    }
+}
+
+void set_layer_rule(ml_gol_t* ml_gol, const uint64_t layer, const rule_t rule) {
+    set_rule(&ml_gol->layers[layer], rule);
+}
+
+int set_dependent_radius(ml_gol_t* ml_gol, const uint64_t radius) {
+    if (radius == 0 || radius > MAX_RULE_RADIUS || neighborhood_cells(radius) * ml_gol->num_layers > UINT16_MAX) {
+        return -1;
+    }
+
+    ml_gol->dependent_radius = radius;
+
+    for (uint64_t layer = 0; radius > 1 && layer < ml_gol->num_layers; layer++) {
+        enable_column_sums(&ml_gol->layers[layer]);
+    }
+
+    if (ml_gol->derived_grids) {
+        calculate_dependent(ml_gol);
+    }
+
+    return 0;
+}
+
+void refresh_ml_gol(ml_gol_t* ml_gol) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        refresh_gol(&ml_gol->layers[layer]);
+    }
 
-    printf("Starting simulation with %ld steps and %d threads\n", num_steps, omp_get_max_threads());
+    if (ml_gol->derived_grids && ml_gol->combined_grid) {
+        calculate_combined(ml_gol);
+    }
 
-    for (uint64_t s = 1; s < num_steps; s++) {
-#pragma omp parallel for
-        for (uint64_t layer = 0; layer < num_layers; layer++) {
-            step(&ml_gol->layers[layer]);
-        }
-       
-        calculate_combined(ml_gol); 
+    if (ml_gol->derived_grids) {
         calculate_dependent(ml_gol);
+    }
+}
 
-        if (create_png) {
-            create_png_for_step(ml_gol, s);
-        }
+rule_t get_layer_rule(const ml_gol_t* ml_gol, const uint64_t layer) {
+    return ml_gol->layers[layer].rule;
+}
+
+const gol_stats_t* get_layer_stats(const ml_gol_t* ml_gol, const uint64_t layer) {
+    return &ml_gol->layers[layer].stats;
+}
+
+const uint64_t* get_dependent_histogram(const ml_gol_t* ml_gol) {
+    return ml_gol->dependent_histogram;
+}
+
+uint64_t get_dependent_histogram_bins(const ml_gol_t* ml_gol) {
+    return neighborhood_cells(ml_gol->dependent_radius) * ml_gol->num_layers + 1;
+}
+
+const bool* get_layer_grid(const ml_gol_t* ml_gol, const uint64_t layer) {
+    gol_t* gol = &ml_gol->layers[layer];
+
+    restore_grids(gol);
+
+    // skip the ghost cells
+    return &gol->current[idx(gol, 1, 1)];
+}
 
-        reset_combined_and_dependent(ml_gol);
+void restore_layers_grids(const ml_gol_t* ml_gol) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        restore_grids(&ml_gol->layers[layer]);
     }
-    
-    free_ml_gol(ml_gol);
 }
 
+uint64_t get_layer_grid_stride(const ml_gol_t* ml_gol) {
+    return ml_gol->layers[0].stride;
+}
+
+const color_t* get_combined_grid(const ml_gol_t* ml_gol) {
+    return ml_gol->combined;
+}
+
+const color_t* get_dependent_grid(const ml_gol_t* ml_gol) {
+    return ml_gol->dependent;
+}
 
 void calculate_combined(const ml_gol_t* ml_gol) {
-    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
-#pragma omp parallel for collapse(2)
-        for (uint64_t i = 1; i < ml_gol->grid_size + 1; i++) {
-            for (uint64_t j = 1; j < ml_gol->grid_size + 1; j++) {
-                size_t grid_idx = idx(&ml_gol->layers[layer], i, j);
-                size_t combined_idx = (i - 1) * ml_gol->grid_size + (j - 1);
-                
-                // If the cell is alive in the current layer, add the color of the layer to the combined grid
-                if (ml_gol->layers[layer].current[grid_idx]) {
-                    ml_gol->combined[combined_idx] = add_colors(ml_gol->combined[combined_idx], ml_gol->layers_colors[layer]);
-                }
+#pragma omp parallel for
+    for (uint64_t i = 1; i < ml_gol->grid_size + 1; i++) {
+        calculate_combined_rows(ml_gol, i, i + 1);
+    }
+}
+
+/**
+ * Calculates the given columns (starting from 1, the last excluded) of a row of the combined grid.
+ */
+static void calculate_combined_cells(const ml_gol_t* ml_gol, const uint64_t i, const uint64_t first_col, const uint64_t last_col) {
+    for (uint64_t j = first_col; j < last_col; j++) {
+        size_t grid_idx = idx(&ml_gol->layers[0], i, j);
+        size_t combined_idx = (i - 1) * ml_gol->grid_size + (j - 1);
+        color_t color = BLACK;
+
+        for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+            // If the cell is alive in the current layer, add the color of the layer to the combined grid
+            if (ml_gol->layers[layer].current[grid_idx]) {
+                color = add_colors(color, ml_gol->layers_colors[layer]);
             }
         }
+
+        ml_gol->combined[combined_idx] = color;
     }
 }
 
+void calculate_combined_rows(const ml_gol_t* ml_gol, const uint64_t first_row, const uint64_t last_row) {
+    for (uint64_t i = first_row; i < last_row; i++) {
+        calculate_combined_cells(ml_gol, i, 1, ml_gol->grid_size + 1);
+    }
+}
 
 void create_png_for_grid(const color_t* grid, const uint64_t grid_size, const uint64_t step, const char* folder) {
     char filename[50];
@@ -95,37 +878,204 @@ void print_layers_colors(const ml_gol_t* ml_gol) {
     }
 }
 
-void init_ml_gol(ml_gol_t* ml_gol, const uint64_t grid_size, const uint64_t num_layers, const bool create_png, const float density, const uint64_t seed) {
-    srand(seed);
+void print_layers_rules(const ml_gol_t* ml_gol) {
+    char rule[MAX_RULE_LENGTH];
+    printf("Rules for the layers:\n");
+    for (uint64_t i = 0; i < ml_gol->num_layers; i++) {
+        rule_to_string(ml_gol->layers[i].rule, rule);
+        const rule_t layer_rule = ml_gol->layers[i].rule;
+        const char* kernel = layer_rule.radius > 1 ? "larger than life" : has_specialized_kernel(layer_rule) ? "specialized" : "generic";
+
+        printf("Layer %ld: %s (%s kernel)\n", i, rule, kernel);
+    }
+
+    if (ml_gol->dependent_radius > 1) {
+        printf("Dependent radius: %ld\n", ml_gol->dependent_radius);
+    }
+}
+
+/**
+ * Initializes the multilayer game of life structure, the derived grids are only allocated and calculated if they are enabled,
+ * otherwise the sparse layers do not keep their grids either.
+ */
+static int init_ml_gol_with_derived_grids(ml_gol_t* ml_gol, const uint64_t grid_size, const uint64_t num_layers, const float density, const uint64_t seed,
+        const bool derived_grids) {
+    // each instance has its own generator state, so that instances can be initialized concurrently
+    unsigned int rng_state = (unsigned int) seed;
+
+    if (num_layers == 0 || num_layers > MAX_NUM_LAYERS) {
+        return -1;
+    }
 
     ml_gol->num_layers = num_layers;
     ml_gol->layers = (gol_t*) malloc(num_layers * sizeof(gol_t));
     ml_gol->layers_colors = (color_t*) malloc(num_layers * sizeof(color_t));
 
     ml_gol->grid_size = grid_size;
+    ml_gol->step = 0;
+    ml_gol->num_step_callbacks = 0;
+    ml_gol->derived_grids = derived_grids;
+    ml_gol->combined_grid = true;
+    ml_gol->layers_grids = derived_grids;
+    ml_gol->owns_buffers = true;
+    ml_gol->dependent_radius = 1;
+    ml_gol->telemetry = NULL;
+
+    // a sparse layer frees its grids before the next one is initialized, if nothing reads them
+    for (uint64_t i = 0; i < ml_gol->num_layers; i++) {
+        init_gol(&ml_gol->layers[i], grid_size, density, &rng_state);
+        set_keep_grids(&ml_gol->layers[i], ml_gol->layers_grids);
+        ml_gol->layers_colors[i] = get_color_for_layer(i, num_layers);
+    }
+
+    const size_t num_histograms = count_histograms();
+    init_histograms(ml_gol, (uint64_t*) malloc(num_histograms * histogram_stride(num_layers) * sizeof(uint64_t)), num_histograms);
+
+    set_schedule(ml_gol, default_schedule());
+
+    ml_gol->combined = NULL;
+    ml_gol->dependent = NULL;
+    ml_gol->dependent_counts = NULL;
+    ml_gol->dependent_deltas = (int16_t*) calloc(ml_gol->num_thread_histograms * (ml_gol->grid_size + 2), sizeof(int16_t));
+    update_derived_buffers(ml_gol);
+
+    if (derived_grids) {
+        calculate_combined(ml_gol);
+        calculate_dependent(ml_gol);
+    }
+
+    return 0;
+}
+
+ml_gol_t* create_ml_gol_with_derived_grids(const uint64_t grid_size, const uint64_t num_layers, const float density, const uint64_t seed,
+        const bool derived_grids) {
+    ml_gol_t* ml_gol = (ml_gol_t*) malloc(sizeof(ml_gol_t));
+
+    if (init_ml_gol_with_derived_grids(ml_gol, grid_size, num_layers, density, seed, derived_grids) != 0) {
+        free(ml_gol);
+        return NULL;
+    }
+
+    return ml_gol;
+}
+
+ml_gol_t* create_ml_gol(const uint64_t grid_size, const uint64_t num_layers, const float density, const uint64_t seed) {
+    return create_ml_gol_with_derived_grids(grid_size, num_layers, density, seed, true);
+}
+
+int init_ml_gol(ml_gol_t* ml_gol, const uint64_t grid_size, const uint64_t num_layers, const float density, const uint64_t seed) {
+    return init_ml_gol_with_derived_grids(ml_gol, grid_size, num_layers, density, seed, true);
+}
+
+int init_ml_gol_with_buffers(ml_gol_t* ml_gol, ml_gol_buffers_t* buffers, const uint64_t grid_size, const uint64_t num_layers, const float density, const uint64_t seed) {
+    unsigned int rng_state = (unsigned int) seed;
+
+    if (num_layers == 0 || num_layers > MAX_NUM_LAYERS) {
+        return -1;
+    }
+
+    reserve_ml_gol_buffers(buffers, grid_size, num_layers);
+
+    ml_gol->num_layers = num_layers;
+    ml_gol->grid_size = grid_size;
+    ml_gol->step = 0;
+    ml_gol->num_step_callbacks = 0;
+    ml_gol->derived_grids = true;
+    ml_gol->combined_grid = true;
+    ml_gol->layers_grids = true;
+    ml_gol->owns_buffers = false;
+    ml_gol->dependent_radius = 1;
+    ml_gol->telemetry = NULL;
+    ml_gol->layers = buffers->layers;
+    ml_gol->layers_colors = buffers->layers_colors;
+    ml_gol->combined = buffers->combined;
+    ml_gol->dependent = buffers->dependent;
+    ml_gol->dependent_counts = buffers->dependent_counts;
+    ml_gol->dependent_deltas = buffers->deltas;
+
+    // two grids (current and next) and two arrays of tile flags per layer, one after the other
+    const size_t grid_cells = count_grid_cells(grid_size);
+    const size_t layer_tiles = 2 * count_activity_tiles(grid_size);
 
     for (uint64_t i = 0; i < ml_gol->num_layers; i++) {
-        init_gol(&ml_gol->layers[i], grid_size, density);
+        bool* current = buffers->grids + (2 * i) * grid_cells;
+        bool* next = buffers->grids + (2 * i + 1) * grid_cells;
+        uint8_t* tiles = buffers->tiles + i * layer_tiles;
+
+        init_gol_with_buffers(&ml_gol->layers[i], grid_size, density, &rng_state, current, next, tiles);
         ml_gol->layers_colors[i] = get_color_for_layer(i, num_layers);
     }
 
-    size_t size = (ml_gol->grid_size) * (ml_gol->grid_size) * sizeof(color_t);
+    init_histograms(ml_gol, buffers->histograms, count_histograms());
+    memset(buffers->deltas, 0, buffers->deltas_capacity * sizeof(int16_t));
 
-    ml_gol->combined = (color_t*) malloc(size * sizeof(color_t));
-    ml_gol->dependent = (color_t*) malloc(size * sizeof(color_t));
+    set_schedule(ml_gol, default_schedule());
 
     calculate_combined(ml_gol); 
     calculate_dependent(ml_gol);
 
-    if (create_png) {
-        create_png_for_step(ml_gol, 0);
+    return 0;
+}
+
+void reserve_ml_gol_buffers(ml_gol_buffers_t* buffers, const uint64_t grid_size, const uint64_t num_layers) {
+    const size_t grids_size = 2 * num_layers * count_grid_cells(grid_size);
+    const size_t colors_size = grid_size * grid_size;
+    const size_t tiles_size = 2 * num_layers * count_activity_tiles(grid_size);
+    const size_t histograms_size = count_histograms() * histogram_stride(num_layers);
+    const size_t deltas_size = count_histograms() * (grid_size + 2);
+
+    if (num_layers > buffers->layers_capacity) {
+        buffers->layers = (gol_t*) realloc(buffers->layers, num_layers * sizeof(gol_t));
+        buffers->layers_colors = (color_t*) realloc(buffers->layers_colors, num_layers * sizeof(color_t));
+        buffers->layers_capacity = num_layers;
     }
 
-    reset_combined_and_dependent(ml_gol);
+    if (grids_size > buffers->grids_capacity) {
+        // the content is overwritten by the next instance, no need to copy it, the grids keep the alignment of the buffer
+        free(buffers->grids);
+        buffers->grids = (bool*) aligned_alloc(GRID_ALIGNMENT, grids_size * sizeof(bool));
+        buffers->grids_capacity = grids_size;
+    }
 
-    printf("Initialized multilayer game of life with %ld layers and grid size %ld\n", num_layers, grid_size);
-    
-    print_layers_colors(ml_gol);
+    if (colors_size > buffers->colors_capacity) {
+        free(buffers->combined);
+        free(buffers->dependent);
+        free(buffers->dependent_counts);
+        buffers->combined = (color_t*) malloc(colors_size * sizeof(color_t));
+        buffers->dependent = (color_t*) malloc(colors_size * sizeof(color_t));
+        buffers->dependent_counts = (uint16_t*) malloc(colors_size * sizeof(uint16_t));
+        buffers->colors_capacity = colors_size;
+    }
+
+    if (tiles_size > buffers->tiles_capacity) {
+        free(buffers->tiles);
+        buffers->tiles = (uint8_t*) malloc(tiles_size * sizeof(uint8_t));
+        buffers->tiles_capacity = tiles_size;
+    }
+
+    if (histograms_size > buffers->histograms_capacity) {
+        free(buffers->histograms);
+        buffers->histograms = (uint64_t*) malloc(histograms_size * sizeof(uint64_t));
+        buffers->histograms_capacity = histograms_size;
+    }
+
+    if (deltas_size > buffers->deltas_capacity) {
+        free(buffers->deltas);
+        buffers->deltas = (int16_t*) malloc(deltas_size * sizeof(int16_t));
+        buffers->deltas_capacity = deltas_size;
+    }
+}
+
+void free_ml_gol_buffers(ml_gol_buffers_t* buffers) {
+    free(buffers->layers);
+    free(buffers->grids);
+    free(buffers->layers_colors);
+    free(buffers->combined);
+    free(buffers->dependent);
+    free(buffers->dependent_counts);
+    free(buffers->tiles);
+    free(buffers->histograms);
+    free(buffers->deltas);
 }
 
 color_t get_color_for_layer(const uint64_t layer, const uint64_t num_layers) {
@@ -140,12 +1090,33 @@ color_t get_color_for_layer(const uint64_t layer, const uint64_t num_layers) {
     return hsv_to_rgb(hsv_color);
 }
 
-uint8_t count_dependent_alive_neighbors(const ml_gol_t* ml_gol, const uint64_t i, const uint64_t j) {
-    uint8_t count = 0;
+/**
+ * Returns the color of a cell of the dependent grid with the given number of alive cells in its neighborhood.
+ */
+static inline color_t dependent_color(const ml_gol_t* ml_gol, const uint16_t alive_neighbors) {
+    uint8_t channel_value = (uint8_t) ((((float) alive_neighbors) / (get_dependent_histogram_bins(ml_gol) - 1)) * 255);
+    return (color_t){channel_value, channel_value, channel_value};
+}
+
+uint16_t count_dependent_alive_neighbors(const ml_gol_t* ml_gol, const uint64_t i, const uint64_t j) {
+    const uint64_t n = ml_gol->grid_size;
+    uint16_t count = 0;
+
+    if (ml_gol->dependent_radius > 1) {
+        for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+            add_square_counts(&ml_gol->layers[layer], i, ml_gol->dependent_radius, j, j + 1, &count);
+        }
+
+        return count;
+    }
+
+    // the neighbors are wrapped on the torus, the ghost cells are not up to date with all the kernels
+    const uint64_t rows[3] = { i == 1 ? n : i - 1, i, i == n ? 1 : i + 1 };
+    const uint64_t cols[3] = { j == 1 ? n : j - 1, j, j == n ? 1 : j + 1 };
 
-    for (int32_t x = -1; x <= 1; x++) {
-        for (int32_t y = -1; y <= 1; y++) {
-            uint64_t layer_idx = idx(&ml_gol->layers[0], i + x, j + y);
+    for (int x = 0; x < 3; x++) {
+        for (int y = 0; y < 3; y++) {
+            uint64_t layer_idx = idx(&ml_gol->layers[0], rows[x], cols[y]);
 
             for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
                 if (ml_gol->layers[layer].current[layer_idx]) {
@@ -159,18 +1130,421 @@ uint8_t count_dependent_alive_neighbors(const ml_gol_t* ml_gol, const uint64_t i
 }
 
 void calculate_dependent(const ml_gol_t* ml_gol) {
-#pragma omp parallel for collapse(2)
-    for (uint64_t i = 1; i < ml_gol->grid_size - 1; i++) {
-        for (uint64_t j = 1; j < ml_gol->grid_size - 1; j++) {
-            uint64_t idx = i * ml_gol->grid_size + j;
-            
-            uint8_t alive_neighbors = count_dependent_alive_neighbors(ml_gol, i, j);
+    // the histogram is calculated from scratch, the thread histograms are added to it
+    memset(ml_gol->dependent_histogram, 0, get_dependent_histogram_bins(ml_gol) * sizeof(uint64_t));
 
-            uint8_t channel_value = (uint8_t) ((((float) alive_neighbors) / (9 * ml_gol->num_layers)) * 255);
-            
-            ml_gol->dependent[idx] = (color_t){channel_value, channel_value, channel_value};
+#pragma omp parallel for num_threads(ml_gol->num_thread_histograms)
+    for (uint64_t i = 1; i < ml_gol->grid_size + 1; i++) {
+        calculate_dependent_rows(ml_gol, i, i + 1);
+    }
+
+    merge_dependent_histograms(ml_gol);
+}
+
+/**
+ * Calculates the counts of the neighborhoods of the given columns of a row (starting from 1, the last excluded,
+ * at most ACTIVITY_TILE_SIZE columns) from the column sums of the layers, for a dependent radius larger than 1.
+ */
+static void count_dependent_squares(const ml_gol_t* ml_gol, const uint64_t i, const uint64_t first_col, const uint64_t last_col, uint16_t* counts) {
+    memset(counts, 0, (last_col - first_col) * sizeof(uint16_t));
+
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        add_square_counts(&ml_gol->layers[layer], i, ml_gol->dependent_radius, first_col, last_col, counts);
+    }
+}
+
+/**
+ * Adds to sums[j - 1] the alive cells of the column j of the 3 given rows of a layer, for all the columns of the grid.
+ */
+static inline void add_column_sums(const gol_t* gol, const uint64_t above, const uint64_t i, const uint64_t below, uint16_t* restrict sums) {
+    const uint8_t* restrict row_above = (const uint8_t*) &gol->current[idx(gol, above, 1)];
+    const uint8_t* restrict row = (const uint8_t*) &gol->current[idx(gol, i, 1)];
+    const uint8_t* restrict row_below = (const uint8_t*) &gol->current[idx(gol, below, 1)];
+
+    for (uint64_t j = 0; j < gol->size; j++) {
+        sums[j] += row_above[j] + row[j] + row_below[j];
+    }
+}
+
+void calculate_dependent_histogram(const ml_gol_t* ml_gol) {
+    const uint64_t n = ml_gol->grid_size;
+    const uint64_t r = ml_gol->dependent_radius;
+    const uint64_t bins = get_dependent_histogram_bins(ml_gol);
+
+    memset(ml_gol->dependent_histogram, 0, bins * sizeof(uint64_t));
+
+#pragma omp parallel num_threads(ml_gol->num_thread_histograms)
+    {
+        uint64_t* histogram = ml_gol->thread_histograms + omp_get_thread_num() * histogram_stride(ml_gol->num_layers);
+        uint16_t* sums = (uint16_t*) malloc((n + 2 * r) * sizeof(uint16_t));
+        uint16_t* counts = (uint16_t*) malloc((n + ACTIVITY_TILE_SIZE) * sizeof(uint16_t));
+
+#pragma omp for schedule(static)
+        for (uint64_t i = 1; i < n + 1; i++) {
+            // the sums of the columns of the rows of the window over the layers without their grids (read from the live sets)
+            // or with radius 1, wrapped on the torus without the ghost cells, not kept by the wrap kernel and the live sets;
+            // the layers with their grids and a larger radius add the counts of their squares from the column sums
+            const uint64_t above = i == 1 ? n : i - 1;
+            const uint64_t below = i == n ? 1 : i + 1;
+            bool has_sums = false;
+
+            memset(sums, 0, (n + 2 * r) * sizeof(uint16_t));
+            memset(counts, 0, n * sizeof(uint16_t));
+
+            for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+                const gol_t* gol = &ml_gol->layers[layer];
+
+                if (!gol->current) {
+                    add_live_set_columns(gol, i, r, sums + r);
+                    has_sums = true;
+                } else if (r == 1) {
+                    add_column_sums(gol, above, i, below, sums + 1);
+                    has_sums = true;
+                } else {
+                    for (uint64_t first_col = 1; first_col < n + 1; first_col += ACTIVITY_TILE_SIZE) {
+                        const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+                        add_square_counts(gol, i, r, first_col, last_col, counts + first_col - 1);
+                    }
+                }
+            }
+
+            if (has_sums) {
+                // the columns are wrapped on the torus, more than once if the window is larger than the grid
+                for (uint64_t k = 0; k < r; k++) {
+                    sums[k] = sums[r + (k + (r / n + 1) * n - r) % n];
+                    sums[n + r + k] = sums[r + k % n];
+                }
+
+                for (uint64_t j = 0; j < n; j++) {
+                    uint16_t count = counts[j];
+
+                    for (uint64_t d = 0; d < 2 * r + 1; d++) {
+                        count += sums[j + d];
+                    }
+
+                    counts[j] = count;
+                }
+            }
+
+            for (uint64_t j = 0; j < n; j++) {
+                histogram[counts[j]]++;
+            }
+        }
+
+        free(sums);
+        free(counts);
+    }
+
+    merge_dependent_histograms(ml_gol);
+}
+
+/**
+ * Calculates the given rows of the dependent grid from the column sums of the layers, a tile of columns at a time.
+ */
+static void calculate_dependent_squares(const ml_gol_t* ml_gol, uint64_t* histogram, const uint64_t first_row, const uint64_t last_row) {
+    const uint64_t n = ml_gol->grid_size;
+    uint16_t counts[ACTIVITY_TILE_SIZE];
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        for (uint64_t first_col = 1; first_col < n + 1; first_col += ACTIVITY_TILE_SIZE) {
+            const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+            count_dependent_squares(ml_gol, i, first_col, last_col, counts);
+
+            for (uint64_t j = first_col; j < last_col; j++) {
+                size_t dependent_idx = (i - 1) * n + (j - 1);
+                uint16_t alive_neighbors = counts[j - first_col];
+
+                ml_gol->dependent_counts[dependent_idx] = alive_neighbors;
+                ml_gol->dependent[dependent_idx] = dependent_color(ml_gol, alive_neighbors);
+                histogram[alive_neighbors]++;
+            }
+        }
+    }
+}
+
+void calculate_dependent_rows(const ml_gol_t* ml_gol, const uint64_t first_row, const uint64_t last_row) {
+    uint64_t* histogram = ml_gol->thread_histograms + omp_get_thread_num() * histogram_stride(ml_gol->num_layers);
+
+    if (ml_gol->dependent_radius > 1) {
+        calculate_dependent_squares(ml_gol, histogram, first_row, last_row);
+        return;
+    }
+
+    for (uint64_t i = first_row; i < last_row; i++) {
+        for (uint64_t j = 1; j < ml_gol->grid_size + 1; j++) {
+            size_t dependent_idx = (i - 1) * ml_gol->grid_size + (j - 1);
             
+            uint16_t alive_neighbors = count_dependent_alive_neighbors(ml_gol, i, j);
+
+            ml_gol->dependent_counts[dependent_idx] = alive_neighbors;
+            ml_gol->dependent[dependent_idx] = dependent_color(ml_gol, alive_neighbors);
+            histogram[alive_neighbors]++;
+        }
+    }
+}
+
+/**
+ * Adds the given change to the count of a cell of the dependent grid, then updates its color and the histogram of the thread.
+ */
+static inline void update_dependent_cell(const ml_gol_t* ml_gol, uint64_t* histogram, const size_t dependent_idx, const int delta) {
+    uint16_t count = ml_gol->dependent_counts[dependent_idx];
+    uint16_t new_count = (uint16_t) (count + delta);
+
+    ml_gol->dependent_counts[dependent_idx] = new_count;
+    ml_gol->dependent[dependent_idx] = dependent_color(ml_gol, new_count);
+
+    // the thread histograms hold the changes of the step, they wrap around when negative but their sum is exact
+    histogram[count]--;
+    histogram[new_count]++;
+}
+
+/**
+ * Returns whether the given tile of the given row changed in the last step in at least one layer.
+ */
+static inline bool is_row_tile_changed(const ml_gol_t* ml_gol, const uint64_t i, const uint64_t tile) {
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        const gol_t* gol = &ml_gol->layers[layer];
+
+        if (gol->changed_tiles[((i - 1) / ACTIVITY_TILE_SIZE) * gol->tiles_per_side + tile]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Adds the changes of the given columns (starting from 1, the last excluded) to the counts of the cells in the 3 given rows.
+ * The change of a column is the sum of the changes of the cells in the 3 columns around it.
+ */
+static void update_dependent_columns(const ml_gol_t* ml_gol, uint64_t* histogram, const uint64_t rows[3], const int16_t* deltas, const uint64_t first_col, const uint64_t last_col) {
+    for (uint64_t j = first_col; j < last_col; j++) {
+        const int delta = deltas[j - 1] + deltas[j] + deltas[j + 1];
+
+        if (delta == 0) {
+            continue;
+        }
+
+        for (int x = 0; x < 3; x++) {
+            update_dependent_cell(ml_gol, histogram, rows[x] * ml_gol->grid_size + j - 1, delta);
+        }
+    }
+}
+
+/**
+ * Returns whether the neighborhoods of the cells of the given tile of the given row include a cell changed in the last step,
+ * for a dependent radius larger than 1: the tile and the two next to it are checked in the tile rows crossed by the neighborhoods.
+ */
+static bool is_square_tile_changed(const ml_gol_t* ml_gol, const uint64_t i, const uint64_t tile) {
+    const uint64_t n = ml_gol->grid_size;
+    const uint64_t radius = ml_gol->dependent_radius;
+    const uint64_t tiles_per_side = ml_gol->layers[0].tiles_per_side;
+    uint64_t row = (i - 1 + n - radius % n) % n + 1;
+
+    for (uint64_t rows_left = 2 * radius + 1; rows_left > 0;) {
+        const uint64_t tile_last_row = ((row - 1) / ACTIVITY_TILE_SIZE + 1) * ACTIVITY_TILE_SIZE < n ? ((row - 1) / ACTIVITY_TILE_SIZE + 1) * ACTIVITY_TILE_SIZE : n;
+        const uint64_t rows = rows_left < tile_last_row - row + 1 ? rows_left : tile_last_row - row + 1;
+
+        if (is_row_tile_changed(ml_gol, row, (tile + tiles_per_side - 1) % tiles_per_side) ||
+                is_row_tile_changed(ml_gol, row, tile) || is_row_tile_changed(ml_gol, row, (tile + 1) % tiles_per_side)) {
+            return true;
+        }
+
+        rows_left -= rows;
+        row = tile_last_row == n ? 1 : tile_last_row + 1;
+    }
+
+    return false;
+}
+
+/**
+ * Calculates again the counts of the tiles of the given row with a change in their neighborhoods, for a dependent radius larger than 1.
+ * Only the cells of the row are written, the changes of the histogram are added to the given thread histogram.
+ */
+static void update_dependent_squares(const ml_gol_t* ml_gol, uint64_t* histogram, const uint64_t i) {
+    const uint64_t n = ml_gol->grid_size;
+    uint16_t counts[ACTIVITY_TILE_SIZE];
+
+    for (uint64_t tile = 0; tile < ml_gol->layers[0].tiles_per_side; tile++) {
+        if (!is_square_tile_changed(ml_gol, i, tile)) {
+            continue;
+        }
+
+        const uint64_t first_col = tile * ACTIVITY_TILE_SIZE + 1;
+        const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+        count_dependent_squares(ml_gol, i, first_col, last_col, counts);
+
+        for (uint64_t j = first_col; j < last_col; j++) {
+            const size_t dependent_idx = (i - 1) * n + (j - 1);
+            const int delta = counts[j - first_col] - ml_gol->dependent_counts[dependent_idx];
+
+            if (delta != 0) {
+                update_dependent_cell(ml_gol, histogram, dependent_idx, delta);
+            }
+        }
+    }
+}
+
+void update_dependent_row(const ml_gol_t* ml_gol, const uint64_t i) {
+    const uint64_t n = ml_gol->grid_size;
+    const uint64_t tiles_per_side = ml_gol->layers[0].tiles_per_side;
+    const int thread = omp_get_thread_num();
+    uint64_t* histogram = ml_gol->thread_histograms + thread * histogram_stride(ml_gol->num_layers);
+
+    if (ml_gol->dependent_radius > 1) {
+        update_dependent_squares(ml_gol, histogram, i);
+        return;
+    }
+
+    // changes of the cells of the row over all the layers, with a ghost column on each side, they are all 0 between two calls
+    int16_t* deltas = ml_gol->dependent_deltas + thread * (n + 2);
+
+    // the rows of the 3x3 squares around the cells of the row, on the torus
+    const uint64_t rows[3] = { (i + n - 2) % n, i - 1, i % n };
+
+    bool changed = false;
+
+    for (uint64_t tile = 0; tile < tiles_per_side; tile++) {
+        if (!is_row_tile_changed(ml_gol, i, tile)) {
+            continue;
+        }
+
+        const uint64_t first_col = tile * ACTIVITY_TILE_SIZE + 1;
+        const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+        // the next grid holds the previous step, the grids are swapped at the end of the step
+        for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+            const gol_t* gol = &ml_gol->layers[layer];
+            const bool* current = &gol->current[idx(gol, i, 0)];
+            const bool* previous = &gol->next[idx(gol, i, 0)];
+
+            for (uint64_t j = first_col; j < last_col; j++) {
+                deltas[j] += current[j] - previous[j];
+            }
+        }
+
+        changed = true;
+    }
+
+    if (!changed) {
+        return;
+    }
+
+    deltas[0] = deltas[n];
+    deltas[n + 1] = deltas[1];
+
+    // a column changes if a cell changed in the 3 columns around it: all the columns of a changed tile
+    // and the columns at the borders of the tiles next to a changed one
+    for (uint64_t tile = 0; tile < tiles_per_side; tile++) {
+        const uint64_t first_col = tile * ACTIVITY_TILE_SIZE + 1;
+        const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+        if (is_row_tile_changed(ml_gol, i, tile)) {
+            update_dependent_columns(ml_gol, histogram, rows, deltas, first_col, last_col);
+            continue;
+        }
+
+        const bool previous_changed = is_row_tile_changed(ml_gol, i, (tile + tiles_per_side - 1) % tiles_per_side);
+        const bool next_changed = is_row_tile_changed(ml_gol, i, (tile + 1) % tiles_per_side);
+
+        if (previous_changed) {
+            update_dependent_columns(ml_gol, histogram, rows, deltas, first_col, first_col + 1);
+        }
+
+        // a tile of a single column was already updated as the first one
+        if (next_changed && !(previous_changed && last_col - 1 == first_col)) {
+            update_dependent_columns(ml_gol, histogram, rows, deltas, last_col - 1, last_col);
+        }
+    }
+
+    for (uint64_t tile = 0; tile < tiles_per_side; tile++) {
+        if (is_row_tile_changed(ml_gol, i, tile)) {
+            const uint64_t first_col = tile * ACTIVITY_TILE_SIZE + 1;
+            const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+            memset(deltas + first_col, 0, (last_col - first_col) * sizeof(int16_t));
+        }
+    }
+
+    deltas[0] = 0;
+    deltas[n + 1] = 0;
+}
+
+void update_combined_row(const ml_gol_t* ml_gol, const uint64_t i) {
+    const uint64_t n = ml_gol->grid_size;
+
+    for (uint64_t tile = 0; tile < ml_gol->layers[0].tiles_per_side; tile++) {
+        if (is_row_tile_changed(ml_gol, i, tile)) {
+            const uint64_t first_col = tile * ACTIVITY_TILE_SIZE + 1;
+            const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+            calculate_combined_cells(ml_gol, i, first_col, last_col);
+        }
+    }
+}
+
+/**
+ * Adds the given change to the counts of the cells of the dependent grid whose neighborhood contains the cell (i, j),
+ * wrapped on the torus (more than once if the neighborhood is larger than the grid).
+ */
+static void update_dependent_square(const ml_gol_t* ml_gol, uint64_t* histogram, const uint64_t i, const uint64_t j, const int delta) {
+    const int64_t n = (int64_t) ml_gol->grid_size;
+    const int64_t radius = (int64_t) ml_gol->dependent_radius;
+
+    for (int64_t di = -radius; di <= radius; di++) {
+        const int64_t row = (((int64_t) i - 1 + di) % n + n) % n;
+
+        for (int64_t dj = -radius; dj <= radius; dj++) {
+            const int64_t col = (((int64_t) j - 1 + dj) % n + n) % n;
+
+            update_dependent_cell(ml_gol, histogram, (size_t) (row * n + col), delta);
+        }
+    }
+}
+
+void update_derived_from_live_sets(const ml_gol_t* ml_gol) {
+    const uint64_t n = ml_gol->grid_size;
+    uint64_t* histogram = ml_gol->thread_histograms + omp_get_thread_num() * histogram_stride(ml_gol->num_layers);
+
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        const gol_t* gol = &ml_gol->layers[layer];
+        const live_set_t* set = gol->live_set;
+
+        for (uint64_t c = 0; c < set->num_changes; c++) {
+            const uint64_t i = set->changes[c] / n + 1;
+            const uint64_t j = set->changes[c] % n + 1;
+
+            if (ml_gol->combined_grid) {
+                calculate_combined_cells(ml_gol, i, j, j + 1);
+            }
+            update_dependent_square(ml_gol, histogram, i, j, gol->current[idx(gol, i, j)] ? 1 : -1);
+        }
+    }
+}
+
+void update_dependent(const ml_gol_t* ml_gol) {
+#pragma omp parallel num_threads(ml_gol->num_thread_histograms)
+    update_dependent_in_team(ml_gol);
+
+    merge_dependent_histograms(ml_gol);
+}
+
+void merge_dependent_histograms(const ml_gol_t* ml_gol) {
+    const uint64_t stride = histogram_stride(ml_gol->num_layers);
+    const uint64_t bins = get_dependent_histogram_bins(ml_gol);
+
+    for (uint64_t k = 0; k < bins; k++) {
+        uint64_t count = 0;
+
+        for (int t = 0; t < ml_gol->num_thread_histograms; t++) {
+            count += ml_gol->thread_histograms[t * stride + k];
+            ml_gol->thread_histograms[t * stride + k] = 0;
         }
+
+        ml_gol->dependent_histogram[k] += count;
     }
 }
 
@@ -180,7 +1554,11 @@ void free_ml_gol(ml_gol_t* ml_gol) {
     }
 
     free(ml_gol->layers);
+    free(ml_gol->layers_colors);
     free(ml_gol->combined);
     free(ml_gol->dependent);
+    free(ml_gol->dependent_counts);
+    free(ml_gol->dependent_deltas);
+    free(ml_gol->dependent_histogram);
     free(ml_gol);
 }
\ No newline at end of file
@@ -0,0 +1,515 @@
+#include "pattern.h"
+#include "live_set.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// the largest count of a run, so that the positions cannot overflow
+#define MAX_RLE_COUNT (1ULL << 40)
+
+/**
+ * Structure to represent a chunk of the body of an RLE pattern. After the measure, rows is the number of rows it ends and
+ * col the column where it ends: from the start of the row if it ends a row (new_row), from its starting column otherwise.
+ */
+typedef struct {
+    const char* start;
+    const char* end;
+    uint64_t rows;
+    uint64_t col;
+    bool new_row;
+    uint64_t first_row;
+    uint64_t first_col;
+} rle_chunk_t;
+
+static bool is_rle_cell_tag(const char c) {
+    return isalpha((unsigned char) c) || c == '.';
+}
+
+static bool is_rle_tag(const char c) {
+    return c == '$' || is_rle_cell_tag(c);
+}
+
+/**
+ * Reads the next run of a chunk (<count><tag>) from the given position and moves it after the run.
+ * Returns 1 if a run was read, 0 at the end of the chunk, -1 if the chunk has a character that is not part of a run or a count without a tag.
+ */
+static int next_rle_run(const char** position, const char* end, char* tag, uint64_t* count) {
+    bool has_count = false;
+
+    *count = 0;
+    for (const char* p = *position; p < end; p++) {
+        if (isdigit((unsigned char) *p)) {
+            *count = *count * 10 + (uint64_t) (*p - '0');
+            has_count = true;
+
+            if (*count > MAX_RLE_COUNT) {
+                return -1;
+            }
+        } else if (is_rle_tag(*p)) {
+            *tag = *p;
+            *count = has_count ? *count : 1;
+            *position = p + 1;
+            return 1;
+        } else if (!isspace((unsigned char) *p)) {
+            return -1;
+        }
+    }
+
+    *position = end;
+
+    return has_count ? -1 : 0;
+}
+
+static int measure_rle_chunk(rle_chunk_t* chunk) {
+    chunk->rows = 0;
+    chunk->col = 0;
+    chunk->new_row = false;
+
+    const char* p = chunk->start;
+    char tag;
+    uint64_t count;
+    int result;
+
+    while ((result = next_rle_run(&p, chunk->end, &tag, &count)) > 0) {
+        if (tag == '$') {
+            chunk->rows += count;
+            chunk->col = 0;
+            chunk->new_row = true;
+        } else {
+            chunk->col += count;
+        }
+    }
+
+    return result;
+}
+
+static int decode_rle_chunk(const rle_chunk_t* chunk, pattern_t* pattern) {
+    uint64_t row = chunk->first_row;
+    uint64_t col = chunk->first_col;
+
+    const char* p = chunk->start;
+    char tag;
+    uint64_t count;
+    int result;
+
+    while ((result = next_rle_run(&p, chunk->end, &tag, &count)) > 0) {
+        if (tag == '$') {
+            row += count;
+            col = 0;
+        } else {
+            // the dead cells are already cleared, they can also run past the width (e.g. up to the end of the line)
+            if (tag != 'b' && tag != '.') {
+                if (row >= pattern->height || col + count > pattern->width) {
+                    return -1;
+                }
+
+                memset(pattern->cells + row * pattern->width + col, 1, count);
+            }
+
+            col += count;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Returns the start of the next line of the text, or its end.
+ */
+static const char* next_line(const char* line, const char* end) {
+    const char* newline = memchr(line, '\n', (size_t) (end - line));
+    return newline ? newline + 1 : end;
+}
+
+int parse_rle_pattern(const char* text, const size_t length, pattern_t* pattern) {
+    const char* end = text + length;
+    const char* line = text;
+
+    // comments and empty lines before the header
+    while (line < end && (*line == '#' || *line == '\n' || *line == '\r')) {
+        line = next_line(line, end);
+    }
+
+    char header[MAX_WORKLOAD_LINE_LENGTH];
+    const char* body = next_line(line, end);
+    size_t header_length = (size_t) (body - line) < sizeof(header) - 1 ? (size_t) (body - line) : sizeof(header) - 1;
+
+    memcpy(header, line, header_length);
+    header[header_length] = '\0';
+
+    if (sscanf(header, " x = %lu , y = %lu", &pattern->width, &pattern->height) != 2 || pattern->width == 0 || pattern->height == 0) {
+        return -1;
+    }
+
+    const char* stop = memchr(body, '!', (size_t) (end - body));
+    const char* body_end = stop ? stop : end;
+    const size_t body_length = (size_t) (body_end - body);
+
+    // one chunk per PATTERN_CHUNK_SIZE bytes for the large bodies, each ending after a tag so that no run is split
+    const uint64_t num_chunks = body_length >= PARALLEL_DECODE_SIZE ? (body_length + PATTERN_CHUNK_SIZE - 1) / PATTERN_CHUNK_SIZE : 1;
+    rle_chunk_t* chunks = (rle_chunk_t*) malloc(num_chunks * sizeof(rle_chunk_t));
+
+    const char* chunk_start = body;
+    for (uint64_t c = 0; c < num_chunks; c++) {
+        const char* chunk_end = c + 1 < num_chunks ? body + (c + 1) * PATTERN_CHUNK_SIZE : body_end;
+
+        chunk_end = chunk_end < chunk_start ? chunk_start : chunk_end;
+        while (chunk_end < body_end && !is_rle_tag(chunk_end[-1])) {
+            chunk_end++;
+        }
+
+        chunks[c].start = chunk_start;
+        chunks[c].end = chunk_end;
+        chunk_start = chunk_end;
+    }
+
+    int invalid = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(|: invalid) if (num_chunks > 1)
+    for (uint64_t c = 0; c < num_chunks; c++) {
+        invalid |= measure_rle_chunk(&chunks[c]) != 0;
+    }
+
+    // the starting position of each chunk follows from the moves of the chunks before it
+    uint64_t row = 0;
+    uint64_t col = 0;
+    for (uint64_t c = 0; c < num_chunks; c++) {
+        chunks[c].first_row = row;
+        chunks[c].first_col = col;
+
+        row += chunks[c].rows;
+        col = chunks[c].new_row ? chunks[c].col : col + chunks[c].col;
+    }
+
+    pattern->cells = (uint8_t*) calloc(pattern->width * pattern->height, sizeof(uint8_t));
+
+#pragma omp parallel for schedule(dynamic) reduction(|: invalid) if (num_chunks > 1)
+    for (uint64_t c = 0; c < num_chunks; c++) {
+        invalid |= decode_rle_chunk(&chunks[c], pattern) != 0;
+    }
+
+    free(chunks);
+
+    if (invalid) {
+        free_pattern(pattern);
+        return -1;
+    }
+
+    return 0;
+}
+
+int parse_plaintext_pattern(const char* text, const size_t length, pattern_t* pattern) {
+    const char* end = text + length;
+    uint64_t capacity = 64;
+    const char** rows = (const char**) malloc(capacity * sizeof(const char*));
+    uint64_t* lengths = (uint64_t*) malloc(capacity * sizeof(uint64_t));
+
+    pattern->width = 0;
+    pattern->height = 0;
+
+    for (const char* line = text; line < end; line = next_line(line, end)) {
+        if (*line == '!') {
+            continue;
+        }
+
+        uint64_t line_length = (uint64_t) (next_line(line, end) - line);
+        while (line_length > 0 && (line[line_length - 1] == '\n' || line[line_length - 1] == '\r')) {
+            line_length--;
+        }
+
+        if (pattern->height == capacity) {
+            capacity *= 2;
+            rows = (const char**) realloc(rows, capacity * sizeof(const char*));
+            lengths = (uint64_t*) realloc(lengths, capacity * sizeof(uint64_t));
+        }
+
+        rows[pattern->height] = line;
+        lengths[pattern->height] = line_length;
+        pattern->height++;
+
+        pattern->width = line_length > pattern->width ? line_length : pattern->width;
+    }
+
+    int invalid = pattern->width == 0;
+
+    if (!invalid) {
+        pattern->cells = (uint8_t*) calloc(pattern->width * pattern->height, sizeof(uint8_t));
+
+#pragma omp parallel for reduction(|: invalid)
+        for (uint64_t i = 0; i < pattern->height; i++) {
+            for (uint64_t j = 0; j < lengths[i]; j++) {
+                const char c = rows[i][j];
+
+                invalid |= c != 'O' && c != '*' && c != '.';
+                pattern->cells[i * pattern->width + j] = c == 'O' || c == '*';
+            }
+        }
+
+        if (invalid) {
+            free_pattern(pattern);
+        }
+    }
+
+    free(rows);
+    free(lengths);
+
+    return invalid ? -1 : 0;
+}
+
+int load_pattern(const char* filename, pattern_t* pattern) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for reading\n", filename);
+        return -1;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char* text = (char*) malloc(size > 0 ? (size_t) size : 1);
+    size_t length = size > 0 ? fread(text, 1, (size_t) size, fp) : 0;
+    fclose(fp);
+
+    // the first line that is not a comment is the header of an RLE pattern, or the first row of a plaintext one
+    const char* line = text;
+    while (line < text + length && (*line == '#' || *line == '!')) {
+        line = next_line(line, text + length);
+    }
+
+    const bool rle = line + strspn(line, " \t") < text + length && line[strspn(line, " \t")] == 'x';
+    int result = rle ? parse_rle_pattern(text, length, pattern) : parse_plaintext_pattern(text, length, pattern);
+
+    free(text);
+
+    if (result != 0) {
+        fprintf(stderr, "Invalid pattern in %s\n", filename);
+    }
+
+    return result;
+}
+
+void free_pattern(pattern_t* pattern) {
+    free(pattern->cells);
+    pattern->cells = NULL;
+}
+
+/**
+ * Adds the alive cells of a row of the pattern to the given row of the grid (from 0), from the given column, wrapping around the torus.
+ */
+static void stamp_pattern_row(gol_t* gol, const pattern_t* pattern, const uint64_t r, const uint64_t row, const uint64_t col) {
+    const uint64_t n = gol->size;
+    const uint8_t* cells = pattern->cells + r * pattern->width;
+    bool* grid_row = gol->current + idx(gol, row % n + 1, 1);
+
+    for (uint64_t c = 0; c < pattern->width; c++) {
+        if (cells[c]) {
+            grid_row[(col + c) % n] = true;
+        }
+    }
+}
+
+int place_pattern(ml_gol_t* ml_gol, const uint64_t layer, const pattern_t* pattern, const uint64_t row, const uint64_t col) {
+    gol_t* gol = &ml_gol->layers[layer];
+
+    if (pattern->width > gol->size || pattern->height > gol->size) {
+        return -1;
+    }
+
+    restore_grids(gol);
+
+#pragma omp parallel for
+    for (uint64_t r = 0; r < pattern->height; r++) {
+        stamp_pattern_row(gol, pattern, r, row + r, col);
+    }
+
+    return 0;
+}
+
+int tile_pattern(ml_gol_t* ml_gol, const uint64_t layer, const pattern_t* pattern, const uint64_t row_spacing, const uint64_t col_spacing,
+        const uint64_t row, const uint64_t col) {
+    gol_t* gol = &ml_gol->layers[layer];
+    const uint64_t n = gol->size;
+
+    if (row_spacing < pattern->height || col_spacing < pattern->width || pattern->width > n || pattern->height > n) {
+        return -1;
+    }
+
+    restore_grids(gol);
+
+    // the last copy is at least a spacing away from the first one, across the border of the torus
+    const uint64_t copies_per_col = n / row_spacing > 0 ? n / row_spacing : 1;
+    const uint64_t copies_per_row = n / col_spacing > 0 ? n / col_spacing : 1;
+
+    // the rows of copies never share a row of the grid
+#pragma omp parallel for
+    for (uint64_t a = 0; a < copies_per_col; a++) {
+        for (uint64_t b = 0; b < copies_per_row; b++) {
+            for (uint64_t r = 0; r < pattern->height; r++) {
+                stamp_pattern_row(gol, pattern, r, row + a * row_spacing + r, col + b * col_spacing);
+            }
+        }
+    }
+
+    return 0;
+}
+
+void fill_soup(ml_gol_t* ml_gol, const uint64_t layer, const float density, const uint64_t seed) {
+    unsigned int rng_state = (unsigned int) seed;
+
+    restore_grids(&ml_gol->layers[layer]);
+    init_grid(&ml_gol->layers[layer], density, &rng_state);
+}
+
+/**
+ * Parses a number of cells or a percentage of the grid size (e.g. 50%).
+ */
+static int parse_cells(const char* token, const uint64_t grid_size, uint64_t* cells) {
+    char* end;
+    const double value = strtod(token, &end);
+
+    if (end == token || value < 0 || (*end != '\0' && strcmp(end, "%") != 0)) {
+        return -1;
+    }
+
+    *cells = (uint64_t) (*end == '%' ? value * grid_size / 100 : value);
+
+    return 0;
+}
+
+/**
+ * Parses the layers of a command: a number (modulo the number of layers) or '*' for all of them.
+ */
+static int parse_layers(const char* token, const uint64_t num_layers, uint64_t* first, uint64_t* last) {
+    if (strcmp(token, "*") == 0) {
+        *first = 0;
+        *last = num_layers;
+        return 0;
+    }
+
+    char* end;
+    const unsigned long long layer = strtoull(token, &end, 10);
+
+    if (end == token || *end != '\0') {
+        return -1;
+    }
+
+    *first = layer % num_layers;
+    *last = *first + 1;
+
+    return 0;
+}
+
+/**
+ * Loads the pattern of a command, its path is relative to the directory of the workload file.
+ */
+static int load_workload_pattern(const char* workload_filename, const char* path, pattern_t* pattern) {
+    char filename[MAX_PATTERN_PATH_LENGTH];
+    const char* slash = strrchr(workload_filename, '/');
+
+    if (path[0] == '/' || !slash) {
+        snprintf(filename, sizeof(filename), "%s", path);
+    } else {
+        snprintf(filename, sizeof(filename), "%.*s/%s", (int) (slash - workload_filename), workload_filename, path);
+    }
+
+    return load_pattern(filename, pattern);
+}
+
+/**
+ * Applies a command of a workload file, returns -1 if it is not valid.
+ */
+static int apply_workload_command(ml_gol_t* ml_gol, const char* filename, const char* line) {
+    char command[16], layers[16], args[5][MAX_WORKLOAD_LINE_LENGTH];
+    const int read = sscanf(line, "%15s %15s %511s %511s %511s %511s %511s", command, layers, args[0], args[1], args[2], args[3], args[4]);
+    const uint64_t n = ml_gol->grid_size;
+    uint64_t first, last;
+
+    if (read < 2 || parse_layers(layers, ml_gol->num_layers, &first, &last) != 0) {
+        return -1;
+    }
+
+    if (strcmp(command, "soup") == 0) {
+        char* end;
+        const float density = strtof(args[0], &end);
+
+        if (read != 4 || *end != '\0' || density < 0 || density > 1) {
+            return -1;
+        }
+
+        const uint64_t seed = strtoull(args[1], NULL, 10);
+        for (uint64_t layer = first; layer < last; layer++) {
+            fill_soup(ml_gol, layer, density, seed + (strcmp(layers, "*") == 0 ? layer : 0));
+        }
+
+        return 0;
+    }
+
+    const bool place = strcmp(command, "place") == 0;
+    const bool tile = strcmp(command, "tile") == 0;
+    uint64_t values[4] = { 0, 0, 0, 0 };
+
+    if ((!place && !tile) || (place && read != 5) || (tile && read != 5 && read != 7)) {
+        return -1;
+    }
+
+    for (int v = 0; v < read - 3; v++) {
+        if (parse_cells(args[v + 1], n, &values[v]) != 0) {
+            return -1;
+        }
+    }
+
+    pattern_t pattern;
+    if (load_workload_pattern(filename, args[0], &pattern) != 0) {
+        return -1;
+    }
+
+    int result = 0;
+    for (uint64_t layer = first; layer < last && result == 0; layer++) {
+        result = place ? place_pattern(ml_gol, layer, &pattern, values[0], values[1]) :
+            tile_pattern(ml_gol, layer, &pattern, values[0], values[1], values[2], values[3]);
+    }
+
+    if (result != 0) {
+        fprintf(stderr, "Pattern %s does not fit in the grid\n", args[0]);
+    }
+
+    free_pattern(&pattern);
+
+    return result;
+}
+
+int load_workload(ml_gol_t* ml_gol, const char* filename) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for reading\n", filename);
+        return -1;
+    }
+
+    char line[MAX_WORKLOAD_LINE_LENGTH];
+    uint64_t line_number = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        line_number++;
+
+        // skip leading spaces, empty lines and comments
+        const char* start = line + strspn(line, " \t");
+        if (*start == '\0' || *start == '\n' || *start == '#') {
+            continue;
+        }
+
+        if (apply_workload_command(ml_gol, filename, start) != 0) {
+            fprintf(stderr, "Invalid workload command at %s:%lu\n", filename, line_number);
+            fclose(fp);
+            return -1;
+        }
+    }
+
+    fclose(fp);
+
+    refresh_ml_gol(ml_gol);
+
+    return 0;
+}
@@ -0,0 +1,570 @@
+#include "perfcheck.h"
+#include "state_hash.h"
+#include "autotune.h"
+#include "ml_gol.h"
+#include "pattern.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#define CPU_MODEL_LENGTH 128
+#define MAX_PERF_RULES_LENGTH 256
+
+// the grids are chosen to cover the edge cases of the kernels and of the schedules: sizes that are not multiples of the tiles,
+// of the task bands and of the vectors, a grid smaller than a tile, Life-like and Larger than Life rules, dependent radii
+// and sparse layers seeded with spaceships and guns, that keep a low but never empty population for the whole run
+static const perf_workload_t PERF_WORKLOADS[] = {
+    { "conway-1024", 1024, 3, 16, 1, 0.3f, NULL, 1, NULL },
+    { "conway-1000", 1000, 2, 16, 2, 0.3f, NULL, 1, NULL },
+    { "conway-97", 97, 4, 128, 3, 0.5f, NULL, 1, NULL },
+    { "life-like-515", 515, 3, 32, 4, 0.3f, "B36/S23;B3678/S34678;B2/S", 1, NULL },
+    { "dependent-radius-300", 300, 3, 24, 5, 0.3f, NULL, 3, NULL },
+    { "larger-than-life-256", 256, 2, 24, 6, 0.5f, "R5,C0,M1,S34..58,B34..45,NM;B3/S23", 2, NULL },
+    { "sparse-gliders-500", 500, 4, 64, 7, 0.0f, "B3/S23;B36/S23", 1, "workloads/sparse-gliders.workload" },
+    { "breeders-radius-2-400", 400, 4, 64, 8, 0.0f, NULL, 2, "workloads/breeders.workload" },
+};
+
+const perf_workload_t* get_perf_workloads(uint64_t* num_workloads) {
+    *num_workloads = sizeof(PERF_WORKLOADS) / sizeof(PERF_WORKLOADS[0]);
+    return PERF_WORKLOADS;
+}
+
+/**
+ * Returns the step of the given checkpoint of a workload.
+ */
+static uint64_t checkpoint_step(const perf_workload_t* workload, const uint64_t checkpoint) {
+    return workload->num_steps * checkpoint / (PERF_CHECKPOINTS - 1);
+}
+
+/**
+ * Creates the multilayer game of life of a workload with the given schedule and representation of the layers,
+ * returns NULL if its rules are not valid.
+ */
+static ml_gol_t* create_workload(const perf_workload_t* workload, const schedule_t schedule, const representation_t representation) {
+    ml_gol_t* ml_gol = create_ml_gol(workload->grid_size, workload->num_layers, workload->density, workload->seed);
+
+    if (workload->rules) {
+        char rules[MAX_PERF_RULES_LENGTH];
+        rule_t parsed[PERF_MAX_LAYERS];
+        uint64_t num_rules = 0;
+        char* save = NULL;
+
+        snprintf(rules, sizeof(rules), "%s", workload->rules);
+
+        for (char* rule = strtok_r(rules, ";", &save); rule; rule = strtok_r(NULL, ";", &save)) {
+            if (num_rules == PERF_MAX_LAYERS || parse_rule(rule, &parsed[num_rules]) != 0) {
+                fprintf(stderr, "Invalid rule %s of workload %s\n", rule, workload->name);
+                free_ml_gol(ml_gol);
+                return NULL;
+            }
+            num_rules++;
+        }
+
+        for (uint64_t layer = 0; num_rules > 0 && layer < workload->num_layers; layer++) {
+            set_layer_rule(ml_gol, layer, parsed[layer % num_rules]);
+        }
+    }
+
+    if (workload->dependent_radius > 1 && set_dependent_radius(ml_gol, workload->dependent_radius) != 0) {
+        fprintf(stderr, "Invalid dependent radius %ld of workload %s\n", workload->dependent_radius, workload->name);
+        free_ml_gol(ml_gol);
+        return NULL;
+    }
+
+    if (workload->workload_filename && load_workload(ml_gol, workload->workload_filename) != 0) {
+        fprintf(stderr, "Invalid workload file %s of workload %s\n", workload->workload_filename, workload->name);
+        free_ml_gol(ml_gol);
+        return NULL;
+    }
+
+    set_schedule(ml_gol, schedule);
+    set_layers_representation(ml_gol, representation);
+
+    return ml_gol;
+}
+
+static void hash_state(const ml_gol_t* ml_gol, uint64_t* hashes) {
+    hashes[0] = hash_combined_state(ml_gol);
+    hashes[1] = hash_dependent_state(ml_gol);
+
+    for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+        hashes[2 + layer] = hash_layer_state(ml_gol, layer);
+    }
+}
+
+/**
+ * Steps a workload with the given schedule and representation and hashes its states at the checkpoints.
+ * The steps between two checkpoints are a single call, so that the task graph can overlap them.
+ */
+static int hash_workload(const perf_workload_t* workload, const schedule_t schedule, const representation_t representation,
+        uint64_t hashes[PERF_CHECKPOINTS][PERF_MAX_HASHES]) {
+    ml_gol_t* ml_gol = create_workload(workload, schedule, representation);
+    if (!ml_gol) {
+        return -1;
+    }
+
+    for (uint64_t c = 0; c < PERF_CHECKPOINTS; c++) {
+        step_ml_gol(ml_gol, checkpoint_step(workload, c) - ml_gol->step);
+        hash_state(ml_gol, hashes[c]);
+    }
+
+    free_ml_gol(ml_gol);
+
+    return 0;
+}
+
+/**
+ * Returns the name of the hash at the given position of a state.
+ */
+static void hash_name(const uint64_t h, char* name, const size_t length) {
+    if (h < 2) {
+        snprintf(name, length, "%s", h == 0 ? "combined" : "dependent");
+    } else {
+        snprintf(name, length, "layer %lu", h - 2);
+    }
+}
+
+/**
+ * Steps a workload with every schedule strategy and kernel on dense layers, then with every schedule strategy on sparse layers
+ * (the layers that can be), and compares its hashes with the expected ones, the first difference of each run is printed.
+ * Returns the number of runs that differ.
+ */
+static int check_workload_hashes(const perf_workload_t* workload, uint64_t expected[PERF_CHECKPOINTS][PERF_MAX_HASHES]) {
+    const uint64_t num_hashes = 2 + workload->num_layers;
+    int failures = 0;
+
+    for (int s = 0; s < NUM_SCHEDULE_STRATEGIES; s++) {
+        // the last run of each schedule steps the sparse layers, the kernel is only used by the dense ones
+        for (int k = 0; k <= NUM_KERNELS; k++) {
+            const representation_t representation = k < NUM_KERNELS ? REPRESENTATION_DENSE : REPRESENTATION_SPARSE;
+            schedule_t schedule = default_schedule();
+            schedule.strategy = (schedule_strategy_t) s;
+            schedule.kernel = k < NUM_KERNELS ? (kernel_t) k : schedule.kernel;
+
+            uint64_t hashes[PERF_CHECKPOINTS][PERF_MAX_HASHES];
+            if (hash_workload(workload, schedule, representation, hashes) != 0) {
+                return NUM_SCHEDULE_STRATEGIES * (NUM_KERNELS + 1);
+            }
+
+            bool match = true;
+            for (uint64_t c = 0; match && c < PERF_CHECKPOINTS; c++) {
+                for (uint64_t h = 0; match && h < num_hashes; h++) {
+                    if (hashes[c][h] == expected[c][h]) {
+                        continue;
+                    }
+
+                    char name[PERF_NAME_LENGTH];
+                    hash_name(h, name, sizeof(name));
+
+                    printf("  %-22s  %-10s %-10s  step %4lu  %-9s %016lx, expected %016lx  FAIL\n", workload->name,
+                        schedule_strategy_name(schedule.strategy), k < NUM_KERNELS ? kernel_name(schedule.kernel) : representation_name(representation),
+                        checkpoint_step(workload, c),
+                        name, hashes[c][h], expected[c][h]);
+                    match = false;
+                }
+            }
+
+            failures += match ? 0 : 1;
+        }
+    }
+
+    if (failures == 0) {
+        printf("  %-22s  %d schedules, kernels and representations match at %d steps\n", workload->name,
+            NUM_SCHEDULE_STRATEGIES * (NUM_KERNELS + 1), PERF_CHECKPOINTS);
+    }
+
+    return failures;
+}
+
+int64_t read_perf_golden(const char* filename, perf_golden_t** golden) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for reading\n", filename);
+        return -1;
+    }
+
+    char line[512];
+    uint64_t line_number = 0;
+    int64_t num_golden = 0;
+    int64_t capacity = 16;
+    *golden = (perf_golden_t*) malloc(capacity * sizeof(perf_golden_t));
+
+    while (fgets(line, sizeof(line), fp)) {
+        line_number++;
+
+        // skip leading spaces, empty lines and comments
+        const char* start = line + strspn(line, " \t");
+        if (*start == '\0' || *start == '\n' || *start == '#') {
+            continue;
+        }
+
+        perf_golden_t record;
+        int offset = 0;
+
+        if (sscanf(start, "%31s %lu%n", record.name, &record.step, &offset) != 2) {
+            fprintf(stderr, "Invalid golden hashes at %s:%lu\n", filename, line_number);
+            fclose(fp);
+            free(*golden);
+            *golden = NULL;
+            return -1;
+        }
+
+        record.num_hashes = 0;
+        const char* hashes = start + offset;
+        int read = 0;
+
+        while (record.num_hashes < PERF_MAX_HASHES && sscanf(hashes, "%lx%n", &record.hashes[record.num_hashes], &read) == 1) {
+            record.num_hashes++;
+            hashes += read;
+        }
+
+        if (num_golden == capacity) {
+            capacity *= 2;
+            *golden = (perf_golden_t*) realloc(*golden, capacity * sizeof(perf_golden_t));
+        }
+
+        (*golden)[num_golden++] = record;
+    }
+
+    fclose(fp);
+
+    return num_golden;
+}
+
+/**
+ * Finds the golden hashes of the checkpoints of a workload, returns -1 if some of them are missing.
+ */
+static int find_workload_golden(const perf_workload_t* workload, const perf_golden_t* golden, const int64_t num_golden,
+        uint64_t expected[PERF_CHECKPOINTS][PERF_MAX_HASHES]) {
+    for (uint64_t c = 0; c < PERF_CHECKPOINTS; c++) {
+        int64_t found = -1;
+
+        for (int64_t g = 0; g < num_golden && found < 0; g++) {
+            if (strcmp(golden[g].name, workload->name) == 0 && golden[g].step == checkpoint_step(workload, c)) {
+                found = g;
+            }
+        }
+
+        if (found < 0 || golden[found].num_hashes != 2 + workload->num_layers) {
+            return -1;
+        }
+
+        memcpy(expected[c], golden[found].hashes, golden[found].num_hashes * sizeof(uint64_t));
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the time per step of a workload with the default schedule, averaged over runs of its steps from the initial state
+ * (after one step of warm up) until they add up to PERF_MIN_TIME seconds, so that every run steps the same states.
+ */
+static double time_workload(const perf_workload_t* workload) {
+    double total_time = 0;
+    uint64_t num_runs = 0;
+
+    while (total_time < PERF_MIN_TIME) {
+        ml_gol_t* ml_gol = create_workload(workload, default_schedule(), REPRESENTATION_AUTO);
+        if (!ml_gol) {
+            return INFINITY;
+        }
+
+        step_ml_gol(ml_gol, 1);
+
+        double tstart = omp_get_wtime();
+        step_ml_gol(ml_gol, workload->num_steps);
+        total_time += omp_get_wtime() - tstart;
+        num_runs++;
+
+        free_ml_gol(ml_gol);
+    }
+
+    return total_time / (num_runs * workload->num_steps);
+}
+
+static int compare_times(const void* a, const void* b) {
+    const double x = *(const double*) a;
+    const double y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Times all the workloads PERF_REPETITIONS times, one workload after the other in each repetition, so that a slow period of the machine
+ * spreads over all of them, and writes the median time per step of each one and its noise: the median distance of the repetitions
+ * from the median, relative to it.
+ */
+static void time_workloads(const perf_workload_t* workloads, const uint64_t num_workloads, double* medians, double* noises) {
+    double (*times)[PERF_REPETITIONS] = malloc(num_workloads * sizeof(*times));
+
+    for (int r = 0; r < PERF_REPETITIONS; r++) {
+        for (uint64_t w = 0; w < num_workloads; w++) {
+            times[w][r] = time_workload(&workloads[w]);
+        }
+    }
+
+    for (uint64_t w = 0; w < num_workloads; w++) {
+        double deviations[PERF_REPETITIONS];
+
+        qsort(times[w], PERF_REPETITIONS, sizeof(double), compare_times);
+        medians[w] = times[w][PERF_REPETITIONS / 2];
+
+        for (int r = 0; r < PERF_REPETITIONS; r++) {
+            deviations[r] = fabs(times[w][r] - medians[w]);
+        }
+
+        qsort(deviations, PERF_REPETITIONS, sizeof(double), compare_times);
+        noises[w] = deviations[PERF_REPETITIONS / 2] / medians[w];
+    }
+
+    free(times);
+}
+
+/**
+ * Reads the machine of the baseline file from its header line "# measured on <cpu model> with <threads> threads",
+ * returns -1 if the file or the line is missing.
+ */
+static int read_baseline_machine(const char* filename, char* cpu_model, const size_t length, int* num_threads) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    const char* prefix = "# measured on ";
+    char line[256];
+    int found = -1;
+
+    while (found != 0 && fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, prefix, strlen(prefix)) != 0) {
+            continue;
+        }
+
+        // the model can contain spaces, the thread count is after its last " with "
+        char* model = line + strlen(prefix);
+        char* with = NULL;
+
+        for (char* next = strstr(model, " with "); next; next = strstr(next + 1, " with ")) {
+            with = next;
+        }
+
+        if (with && sscanf(with, " with %d threads", num_threads) == 1) {
+            const size_t model_length = (size_t) (with - model) < length - 1 ? (size_t) (with - model) : length - 1;
+
+            memcpy(cpu_model, model, model_length);
+            cpu_model[model_length] = '\0';
+            found = 0;
+        }
+    }
+
+    fclose(fp);
+
+    return found;
+}
+
+/**
+ * Reads the time per step of a workload and its noise from the baseline file, returns -1 if the file or the workload is missing.
+ * The noise is 0 in the baselines written without it.
+ */
+static int read_baseline_time(const char* filename, const char* name, double* time, double* noise) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    char line[256];
+    char line_name[PERF_NAME_LENGTH];
+    int found = -1;
+
+    while (found != 0 && fgets(line, sizeof(line), fp)) {
+        const char* start = line + strspn(line, " \t");
+        if (*start == '#') {
+            continue;
+        }
+
+        *noise = 0;
+        if (sscanf(start, "%31s %lf %lf", line_name, time, noise) >= 2 && strcmp(line_name, name) == 0) {
+            found = 0;
+        }
+    }
+
+    fclose(fp);
+
+    return found;
+}
+
+/**
+ * Times the workloads with the threads of the baseline and compares them with it, returns the number of failures:
+ * a time per step above the baseline by more than the tolerance and PERF_NOISE_FACTOR times the noise (of the baseline or of this run)
+ * is a regression, that only fails the check in strict mode. In strict mode a baseline of another machine fails the check too,
+ * otherwise its timings are not compared.
+ */
+static int check_timings(const char* baseline_filename, const double tolerance, const bool strict) {
+    uint64_t num_workloads;
+    const perf_workload_t* workloads = get_perf_workloads(&num_workloads);
+    char cpu_model[CPU_MODEL_LENGTH];
+    char baseline_cpu_model[CPU_MODEL_LENGTH];
+    int baseline_threads;
+
+    get_cpu_model(cpu_model, sizeof(cpu_model));
+
+    if (read_baseline_machine(baseline_filename, baseline_cpu_model, sizeof(baseline_cpu_model), &baseline_threads) != 0) {
+        printf("Not checking the timings: %s does not tell the machine it was measured on\n", baseline_filename);
+        return strict ? 1 : 0;
+    }
+
+    if (strcmp(cpu_model, baseline_cpu_model) != 0 || baseline_threads > omp_get_num_procs()) {
+        printf("Not checking the timings: %s was measured on %s with %d threads, this machine is %s with %d processors\n",
+            baseline_filename, baseline_cpu_model, baseline_threads, cpu_model, omp_get_num_procs());
+        return strict ? 1 : 0;
+    }
+
+    // the timings are only comparable with the same number of threads
+    const int max_threads = omp_get_max_threads();
+    double* times = (double*) malloc(num_workloads * sizeof(double));
+    double* noises = (double*) malloc(num_workloads * sizeof(double));
+    int failures = 0;
+
+    printf("Checking the timings against %s (tolerance %.0f%%, %d threads, median of %d runs of at least %.2f s)%s\n", baseline_filename,
+        tolerance * 100, baseline_threads, PERF_REPETITIONS, PERF_MIN_TIME, strict ? ", strict" : "");
+
+    omp_set_num_threads(baseline_threads);
+    time_workloads(workloads, num_workloads, times, noises);
+    omp_set_num_threads(max_threads);
+
+    for (uint64_t w = 0; w < num_workloads; w++) {
+        double baseline, baseline_noise;
+
+        if (read_baseline_time(baseline_filename, workloads[w].name, &baseline, &baseline_noise) != 0) {
+            printf("  %-22s  %.6f s/step  no baseline\n", workloads[w].name, times[w]);
+            continue;
+        }
+
+        const double noise = noises[w] > baseline_noise ? noises[w] : baseline_noise;
+        const double threshold = tolerance > PERF_NOISE_FACTOR * noise ? tolerance : PERF_NOISE_FACTOR * noise;
+        const double change = times[w] / baseline - 1;
+        const char* verdict = "ok";
+
+        if (change > threshold) {
+            verdict = strict ? "REGRESSION" : "slower, warning";
+            failures += strict ? 1 : 0;
+        }
+
+        printf("  %-22s  %.6f s/step  baseline %.6f  %+6.1f%%  threshold %4.1f%%  %s\n", workloads[w].name, times[w], baseline,
+            change * 100, threshold * 100, verdict);
+    }
+
+    free(times);
+    free(noises);
+
+    return failures;
+}
+
+int run_perfcheck(const char* golden_filename, const char* baseline_filename, const double tolerance, const bool strict) {
+    perf_golden_t* golden;
+    const int64_t num_golden = read_perf_golden(golden_filename, &golden);
+    if (num_golden < 0) {
+        return -1;
+    }
+
+    uint64_t num_workloads;
+    const perf_workload_t* workloads = get_perf_workloads(&num_workloads);
+    int failures = 0;
+
+    printf("Checking the state hashes against %s\n", golden_filename);
+
+    for (uint64_t w = 0; w < num_workloads; w++) {
+        uint64_t expected[PERF_CHECKPOINTS][PERF_MAX_HASHES];
+
+        if (find_workload_golden(&workloads[w], golden, num_golden, expected) != 0) {
+            printf("  %-22s  missing golden hashes  FAIL\n", workloads[w].name);
+            failures++;
+            continue;
+        }
+
+        failures += check_workload_hashes(&workloads[w], expected);
+    }
+
+    free(golden);
+
+    failures += check_timings(baseline_filename, tolerance, strict);
+
+    printf("%s\n", failures == 0 ? "Performance check passed" : "Performance check FAILED");
+
+    return failures == 0 ? 0 : -1;
+}
+
+int update_perfcheck(const char* golden_filename, const char* baseline_filename) {
+    uint64_t num_workloads;
+    const perf_workload_t* workloads = get_perf_workloads(&num_workloads);
+    uint64_t (*hashes)[PERF_CHECKPOINTS][PERF_MAX_HASHES] = malloc(num_workloads * sizeof(*hashes));
+
+    printf("Hashing the workloads with the default schedule and checking the other schedules, kernels and representations\n");
+
+    for (uint64_t w = 0; w < num_workloads; w++) {
+        if (hash_workload(&workloads[w], default_schedule(), REPRESENTATION_AUTO, hashes[w]) != 0 || check_workload_hashes(&workloads[w], hashes[w]) != 0) {
+            fprintf(stderr, "The schedules disagree on workload %s, the golden hashes are not updated\n", workloads[w].name);
+            free(hashes);
+            return -1;
+        }
+    }
+
+    FILE* fp = fopen(golden_filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for writing\n", golden_filename);
+        free(hashes);
+        return -1;
+    }
+
+    fprintf(fp, "# golden state hashes of the perfcheck workloads (FNV-1a, see state_hash.h)\n");
+    fprintf(fp, "# <workload> <step> <combined> <dependent> <layer 0> ... <layer n-1>\n");
+
+    for (uint64_t w = 0; w < num_workloads; w++) {
+        for (uint64_t c = 0; c < PERF_CHECKPOINTS; c++) {
+            fprintf(fp, "%s %lu", workloads[w].name, checkpoint_step(&workloads[w], c));
+
+            for (uint64_t h = 0; h < 2 + workloads[w].num_layers; h++) {
+                fprintf(fp, " %016lx", hashes[w][c][h]);
+            }
+
+            fprintf(fp, "\n");
+        }
+    }
+
+    fclose(fp);
+    free(hashes);
+
+    fp = fopen(baseline_filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for writing\n", baseline_filename);
+        return -1;
+    }
+
+    char cpu_model[CPU_MODEL_LENGTH];
+    get_cpu_model(cpu_model, sizeof(cpu_model));
+
+    printf("Timing the workloads with %d threads (median of %d runs of at least %.2f s)\n", omp_get_max_threads(), PERF_REPETITIONS, PERF_MIN_TIME);
+
+    double* times = (double*) malloc(num_workloads * sizeof(double));
+    double* noises = (double*) malloc(num_workloads * sizeof(double));
+    time_workloads(workloads, num_workloads, times, noises);
+
+    fprintf(fp, "# median seconds per step of the perfcheck workloads with the default schedule and their relative noise\n");
+    fprintf(fp, "# measured on %s with %d threads\n", cpu_model, omp_get_max_threads());
+    fprintf(fp, "# <workload> <seconds_per_step> <noise>\n");
+
+    for (uint64_t w = 0; w < num_workloads; w++) {
+        printf("  %-22s  %.6f s/step  noise %.1f%%\n", workloads[w].name, times[w], noises[w] * 100);
+        fprintf(fp, "%s %.9f %.4f\n", workloads[w].name, times[w], noises[w]);
+    }
+
+    fclose(fp);
+    free(times);
+    free(noises);
+
+    printf("Written %s and %s\n", golden_filename, baseline_filename);
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+#include "preview.h"
+#include "image.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Returns the position of the given cell on the torus.
+ */
+static inline uint64_t wrap(const int64_t i, const uint64_t grid_size) {
+    return (uint64_t) ((i % (int64_t) grid_size + (int64_t) grid_size) % (int64_t) grid_size);
+}
+
+/**
+ * Calculates the weights of the cells in the pixels: the cell i covers [i * size, (i + 1) * size)
+ * and the pixel p covers [p * grid_size, (p + 1) * grid_size), the weight is the length of the overlap.
+ * With a margin, each pixel also receives the weights of the cells around the ones it covers,
+ * as the sum of the weights of the 2 * margin + 1 cells centered on each of them.
+ */
+static void init_weights(preview_weights_t* weights, const uint64_t grid_size, const uint64_t size, const uint64_t margin) {
+    weights->max_count = (grid_size + size - 1) / size + 1 + 2 * margin;
+    weights->total = (2 * margin + 1) * grid_size;
+    weights->first = (int64_t*) malloc(size * sizeof(int64_t));
+    weights->count = (uint64_t*) malloc(size * sizeof(uint64_t));
+    weights->weights = (uint32_t*) calloc(size * weights->max_count, sizeof(uint32_t));
+
+    for (uint64_t p = 0; p < size; p++) {
+        const uint64_t start = p * grid_size;
+        const uint64_t end = (p + 1) * grid_size;
+        const int64_t first = (int64_t) (start / size);
+        const int64_t last = (int64_t) ((end + size - 1) / size) - 1;
+
+        weights->first[p] = first - (int64_t) margin;
+        weights->count[p] = (uint64_t) (last - first + 1) + 2 * margin;
+
+        uint32_t* pixel_weights = weights->weights + p * weights->max_count;
+
+        for (int64_t i = first; i <= last; i++) {
+            uint64_t cell_start = (uint64_t) i * size;
+            uint64_t cell_end = (uint64_t) (i + 1) * size;
+            uint32_t overlap = (uint32_t) ((cell_end < end ? cell_end : end) - (cell_start > start ? cell_start : start));
+
+            // the cell contributes to the neighborhoods of the cells up to margin before and after it, itself included
+            for (uint64_t d = 0; d <= 2 * margin; d++) {
+                pixel_weights[(uint64_t) (i - first) + d] += overlap;
+            }
+        }
+    }
+}
+
+static void free_weights(preview_weights_t* weights) {
+    free(weights->first);
+    free(weights->count);
+    free(weights->weights);
+}
+
+/**
+ * Returns the index of the first pixel of the given level in the density planes of one layer.
+ */
+static uint64_t level_offset(const preview_t* preview, const uint64_t level) {
+    uint64_t offset = 0;
+
+    for (uint64_t l = 0; l < level; l++) {
+        uint64_t side = get_preview_level_size(preview, l);
+        offset += side * side;
+    }
+
+    return offset;
+}
+
+void init_preview(preview_t* preview, const ml_gol_t* ml_gol, const uint64_t size, const uint64_t num_levels) {
+    preview->grid_size = ml_gol->grid_size;
+    preview->num_layers = ml_gol->num_layers;
+    preview->size = size < ml_gol->grid_size ? size : ml_gol->grid_size;
+    preview->num_levels = 1;
+
+    while (preview->num_levels < num_levels && (preview->size >> preview->num_levels) > 0) {
+        preview->num_levels++;
+    }
+
+    init_weights(&preview->block_weights, preview->grid_size, preview->size, 0);
+    init_weights(&preview->neighborhood_weights, preview->grid_size, preview->size, ml_gol->dependent_radius);
+
+    const uint64_t pixels = level_offset(preview, preview->num_levels);
+
+    preview->layers_density = (float*) malloc(pixels * preview->num_layers * sizeof(float));
+    preview->dependent_density = (float*) malloc(pixels * sizeof(float));
+
+    // 3 channels: RGB, the largest level is the first one
+    preview->buffer = (uint8_t*) malloc(preview->size * preview->size * 3 * sizeof(uint8_t));
+}
+
+uint64_t get_preview_level_size(const preview_t* preview, const uint64_t level) {
+    return preview->size >> level;
+}
+
+/**
+ * Sums the rows of the given pixel row, weighted by the row weights: one sum per column for each layer
+ * (the block of the pixel row) and one for all the layers together (the neighborhood of the pixel row).
+ */
+static void sum_pixel_row_columns(const preview_t* preview, const ml_gol_t* ml_gol, const uint64_t p, uint64_t* layers_sums, uint64_t* dependent_sums) {
+    const uint64_t n = preview->grid_size;
+    const uint64_t stride = get_layer_grid_stride(ml_gol);
+    const preview_weights_t* block = &preview->block_weights;
+    const preview_weights_t* neighborhood = &preview->neighborhood_weights;
+
+    memset(layers_sums, 0, preview->num_layers * n * sizeof(uint64_t));
+    memset(dependent_sums, 0, n * sizeof(uint64_t));
+
+    for (uint64_t layer = 0; layer < preview->num_layers; layer++) {
+        const bool* grid = get_layer_grid(ml_gol, layer);
+        uint64_t* sums = layers_sums + layer * n;
+
+        for (uint64_t k = 0; k < block->count[p]; k++) {
+            const bool* row = grid + wrap(block->first[p] + (int64_t) k, n) * stride;
+            const uint64_t weight = block->weights[p * block->max_count + k];
+
+            for (uint64_t j = 0; j < n; j++) {
+                sums[j] += weight * row[j];
+            }
+        }
+
+        for (uint64_t k = 0; k < neighborhood->count[p]; k++) {
+            const bool* row = grid + wrap(neighborhood->first[p] + (int64_t) k, n) * stride;
+            const uint64_t weight = neighborhood->weights[p * neighborhood->max_count + k];
+
+            for (uint64_t j = 0; j < n; j++) {
+                dependent_sums[j] += weight * row[j];
+            }
+        }
+    }
+}
+
+/**
+ * Returns the sum of the given column sums, weighted by the column weights of the pixel q.
+ */
+static uint64_t sum_pixel_columns(const preview_weights_t* weights, const uint64_t* sums, const uint64_t q, const uint64_t grid_size) {
+    uint64_t sum = 0;
+
+    for (uint64_t k = 0; k < weights->count[q]; k++) {
+        sum += weights->weights[q * weights->max_count + k] * sums[wrap(weights->first[q] + (int64_t) k, grid_size)];
+    }
+
+    return sum;
+}
+
+/**
+ * Calculates the level 0 from the layers, the pixel rows are split among the threads.
+ */
+static void calculate_first_level(preview_t* preview, const ml_gol_t* ml_gol) {
+    const uint64_t n = preview->grid_size;
+    const uint64_t size = preview->size;
+
+    // the levels of a layer are stored one after the other
+    const uint64_t layer_pixels = level_offset(preview, preview->num_levels);
+
+    // the weights of a pixel are the product of its row and column weights
+    const double block_area = (double) preview->block_weights.total * preview->block_weights.total;
+    const double neighborhood_area = (double) preview->neighborhood_weights.total * preview->neighborhood_weights.total;
+
+#pragma omp parallel
+    {
+        uint64_t* layers_sums = (uint64_t*) malloc(preview->num_layers * n * sizeof(uint64_t));
+        uint64_t* dependent_sums = (uint64_t*) malloc(n * sizeof(uint64_t));
+
+#pragma omp for schedule(dynamic)
+        for (uint64_t p = 0; p < size; p++) {
+            sum_pixel_row_columns(preview, ml_gol, p, layers_sums, dependent_sums);
+
+            for (uint64_t q = 0; q < size; q++) {
+                for (uint64_t layer = 0; layer < preview->num_layers; layer++) {
+                    uint64_t sum = sum_pixel_columns(&preview->block_weights, layers_sums + layer * n, q, n);
+                    preview->layers_density[layer * layer_pixels + p * size + q] = (float) (sum / block_area);
+                }
+
+                // each cell of a neighborhood can be alive in all the layers
+                uint64_t sum = sum_pixel_columns(&preview->neighborhood_weights, dependent_sums, q, n);
+                preview->dependent_density[p * size + q] = (float) (sum / neighborhood_area / preview->num_layers);
+            }
+        }
+
+        free(layers_sums);
+        free(dependent_sums);
+    }
+}
+
+/**
+ * Averages the 2x2 squares of pixels of the previous level, a pixel row or column left over by an odd side is dropped.
+ */
+static void downsample_plane(const float* source, const uint64_t source_size, float* destination, const uint64_t size) {
+#pragma omp parallel for
+    for (uint64_t p = 0; p < size; p++) {
+        for (uint64_t q = 0; q < size; q++) {
+            const float* top = source + (2 * p) * source_size + 2 * q;
+            const float* bottom = top + source_size;
+
+            destination[p * size + q] = (top[0] + top[1] + bottom[0] + bottom[1]) / 4;
+        }
+    }
+}
+
+void calculate_preview(preview_t* preview, const ml_gol_t* ml_gol) {
+    // the rows of the layers are read by all the threads
+    restore_layers_grids(ml_gol);
+    calculate_first_level(preview, ml_gol);
+
+    const uint64_t layer_pixels = level_offset(preview, preview->num_levels);
+
+    for (uint64_t level = 1; level < preview->num_levels; level++) {
+        const uint64_t source_size = get_preview_level_size(preview, level - 1);
+        const uint64_t size = get_preview_level_size(preview, level);
+        const uint64_t source_offset = level_offset(preview, level - 1);
+        const uint64_t offset = level_offset(preview, level);
+
+        for (uint64_t layer = 0; layer < preview->num_layers; layer++) {
+            downsample_plane(preview->layers_density + layer * layer_pixels + source_offset, source_size,
+                preview->layers_density + layer * layer_pixels + offset, size);
+        }
+
+        downsample_plane(preview->dependent_density + source_offset, source_size, preview->dependent_density + offset, size);
+    }
+}
+
+static uint8_t to_channel(const double value) {
+    return value >= 255 ? 255 : (uint8_t) (value + 0.5);
+}
+
+void create_png_for_preview(preview_t* preview, const ml_gol_t* ml_gol, const uint64_t step) {
+    char filename[64];
+    const uint64_t layer_pixels = level_offset(preview, preview->num_levels);
+
+    for (uint64_t level = 0; level < preview->num_levels; level++) {
+        const uint64_t size = get_preview_level_size(preview, level);
+        const uint64_t offset = level_offset(preview, level);
+
+        // the combined color is the sum of the colors of the layers, weighted by their density
+#pragma omp parallel for
+        for (uint64_t pixel = 0; pixel < size * size; pixel++) {
+            double r = 0, g = 0, b = 0;
+
+            for (uint64_t layer = 0; layer < preview->num_layers; layer++) {
+                double density = preview->layers_density[layer * layer_pixels + offset + pixel];
+
+                r += density * ml_gol->layers_colors[layer].r;
+                g += density * ml_gol->layers_colors[layer].g;
+                b += density * ml_gol->layers_colors[layer].b;
+            }
+
+            preview->buffer[pixel * 3] =     to_channel(r);
+            preview->buffer[pixel * 3 + 1] = to_channel(g);
+            preview->buffer[pixel * 3 + 2] = to_channel(b);
+        }
+
+        sprintf(filename, "output/%s/combined%ld_%04ld.png", PREVIEW_FOLDER, size, step);
+        write_png_file(filename, size, size, preview->buffer);
+
+#pragma omp parallel for
+        for (uint64_t pixel = 0; pixel < size * size; pixel++) {
+            uint8_t value = to_channel(preview->dependent_density[offset + pixel] * 255);
+
+            preview->buffer[pixel * 3] =     value;
+            preview->buffer[pixel * 3 + 1] = value;
+            preview->buffer[pixel * 3 + 2] = value;
+        }
+
+        sprintf(filename, "output/%s/dependent%ld_%04ld.png", PREVIEW_FOLDER, size, step);
+        write_png_file(filename, size, size, preview->buffer);
+    }
+}
+
+void preview_step_callback(const ml_gol_t* ml_gol, void* user_data) {
+    preview_t* preview = (preview_t*) user_data;
+
+    calculate_preview(preview, ml_gol);
+    create_png_for_preview(preview, ml_gol, ml_gol->step);
+}
+
+void free_preview(preview_t* preview) {
+    free_weights(&preview->block_weights);
+    free_weights(&preview->neighborhood_weights);
+    free(preview->layers_density);
+    free(preview->dependent_density);
+    free(preview->buffer);
+}
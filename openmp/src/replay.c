@@ -0,0 +1,440 @@
+#include "replay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// maximum number of bytes of a varint of 64 bits
+#define MAX_VARINT_SIZE 10
+
+/**
+ * Grows the payload buffer of a layer so that it can hold the given number of bytes more.
+ */
+static void reserve_payload(replay_writer_t* writer, const uint64_t layer, const size_t extra) {
+    size_t needed = writer->payload_sizes[layer] + extra;
+
+    if (needed > writer->payload_capacities[layer]) {
+        size_t capacity = writer->payload_capacities[layer] * 2;
+        writer->payload_capacities[layer] = capacity > needed ? capacity : needed;
+        writer->payloads[layer] = (uint8_t*) realloc(writer->payloads[layer], writer->payload_capacities[layer]);
+    }
+}
+
+static size_t encode_varint(uint8_t* buffer, uint64_t value) {
+    size_t size = 0;
+
+    while (value >= 0x80) {
+        buffer[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t) value;
+
+    return size;
+}
+
+static int decode_varint(const uint8_t** buffer, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+
+    for (int shift = 0; shift < 64 && *buffer < end; shift += 7) {
+        uint8_t byte = *(*buffer)++;
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static void append_varint(replay_writer_t* writer, const uint64_t layer, const uint64_t value) {
+    reserve_payload(writer, layer, MAX_VARINT_SIZE);
+    writer->payload_sizes[layer] += encode_varint(writer->payloads[layer] + writer->payload_sizes[layer], value);
+}
+
+/**
+ * Packs the cells of a layer in bits, row by row.
+ */
+static void encode_keyframe(replay_writer_t* writer, const uint64_t layer, const gol_t* gol) {
+    const uint64_t n = gol->size;
+    const size_t size = (n * n + 7) / 8;
+
+    reserve_payload(writer, layer, size);
+    uint8_t* bits = writer->payloads[layer];
+    memset(bits, 0, size);
+
+    for (uint64_t i = 0; i < n; i++) {
+        for (uint64_t j = 0; j < n; j++) {
+            uint64_t k = i * n + j;
+            bits[k / 8] |= (uint8_t) (gol->current[idx(gol, i + 1, j + 1)] << (k % 8));
+        }
+    }
+
+    writer->payload_sizes[layer] = size;
+}
+
+/**
+ * Encodes the runs of cells of a layer that changed in the last step.
+ * The grid of the previous step is the next grid of the layer (they are swapped at the end of the step)
+ * and only the tiles flagged as changed are compared.
+ */
+static void encode_delta(replay_writer_t* writer, const uint64_t layer, const gol_t* gol) {
+    const uint64_t n = gol->size;
+    uint64_t num_runs = 0;
+    uint64_t previous_end = 0;
+    uint64_t run_start = 0;
+    uint64_t run_length = 0;
+
+    // the runs are written after room for their number, which is moved in front of them at the end
+    writer->payload_sizes[layer] = MAX_VARINT_SIZE;
+
+    for (uint64_t i = 1; i < n + 1; i++) {
+        const uint8_t* tiles = gol->changed_tiles + ((i - 1) / ACTIVITY_TILE_SIZE) * gol->tiles_per_side;
+
+        for (uint64_t tile = 0; tile < gol->tiles_per_side; tile++) {
+            if (!tiles[tile]) {
+                continue;
+            }
+
+            const uint64_t first_col = tile * ACTIVITY_TILE_SIZE + 1;
+            const uint64_t last_col = first_col + ACTIVITY_TILE_SIZE < n + 1 ? first_col + ACTIVITY_TILE_SIZE : n + 1;
+
+            for (uint64_t j = first_col; j < last_col; j++) {
+                if (gol->current[idx(gol, i, j)] == gol->next[idx(gol, i, j)]) {
+                    continue;
+                }
+
+                uint64_t k = (i - 1) * n + (j - 1);
+
+                if (run_length > 0 && k == run_start + run_length) {
+                    run_length++;
+                    continue;
+                }
+
+                if (run_length > 0) {
+                    append_varint(writer, layer, run_start - previous_end);
+                    append_varint(writer, layer, run_length);
+                    previous_end = run_start + run_length;
+                    num_runs++;
+                }
+
+                run_start = k;
+                run_length = 1;
+            }
+        }
+    }
+
+    if (run_length > 0) {
+        append_varint(writer, layer, run_start - previous_end);
+        append_varint(writer, layer, run_length);
+        num_runs++;
+    }
+
+    uint8_t count[MAX_VARINT_SIZE];
+    size_t count_size = encode_varint(count, num_runs);
+    size_t runs_size = writer->payload_sizes[layer] - MAX_VARINT_SIZE;
+
+    memcpy(writer->payloads[layer], count, count_size);
+    memmove(writer->payloads[layer] + count_size, writer->payloads[layer] + MAX_VARINT_SIZE, runs_size);
+    writer->payload_sizes[layer] = count_size + runs_size;
+}
+
+int open_replay_writer(replay_writer_t* writer, const char* filename, const ml_gol_t* ml_gol, const uint64_t keyframe_interval) {
+    writer->fp = fopen(filename, "wb");
+    if (!writer->fp) {
+        fprintf(stderr, "Could not open file %s for writing\n", filename);
+        return -1;
+    }
+
+    writer->num_layers = ml_gol->num_layers;
+    writer->grid_size = ml_gol->grid_size;
+    writer->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : DEFAULT_KEYFRAME_INTERVAL;
+    writer->num_records = 0;
+    writer->payloads = (uint8_t**) calloc(writer->num_layers, sizeof(uint8_t*));
+    writer->payload_sizes = (size_t*) calloc(writer->num_layers, sizeof(size_t));
+    writer->payload_capacities = (size_t*) calloc(writer->num_layers, sizeof(size_t));
+
+    uint32_t version = REPLAY_VERSION;
+    uint64_t header[3] = { writer->num_layers, writer->grid_size, writer->keyframe_interval };
+
+    fwrite(REPLAY_MAGIC, 1, 4, writer->fp);
+    fwrite(&version, sizeof(version), 1, writer->fp);
+    fwrite(header, sizeof(uint64_t), 3, writer->fp);
+
+    write_replay_record(writer, ml_gol);
+
+    return 0;
+}
+
+void write_replay_record(replay_writer_t* writer, const ml_gol_t* ml_gol) {
+    const uint8_t type = writer->num_records == 0 || ml_gol->step % writer->keyframe_interval == 0 ? REPLAY_KEYFRAME : REPLAY_DELTA;
+
+    // the deltas read the previous state in the next grids, that are restored with the current ones
+    restore_layers_grids(ml_gol);
+
+#pragma omp parallel for
+    for (uint64_t layer = 0; layer < writer->num_layers; layer++) {
+        writer->payload_sizes[layer] = 0;
+
+        if (type == REPLAY_KEYFRAME) {
+            encode_keyframe(writer, layer, &ml_gol->layers[layer]);
+        } else {
+            encode_delta(writer, layer, &ml_gol->layers[layer]);
+        }
+    }
+
+    uint64_t payload_size = 0;
+    for (uint64_t layer = 0; layer < writer->num_layers; layer++) {
+        payload_size += writer->payload_sizes[layer];
+    }
+
+    fwrite(&type, sizeof(type), 1, writer->fp);
+    fwrite(&ml_gol->step, sizeof(uint64_t), 1, writer->fp);
+    fwrite(&payload_size, sizeof(uint64_t), 1, writer->fp);
+
+    for (uint64_t layer = 0; layer < writer->num_layers; layer++) {
+        fwrite(writer->payloads[layer], 1, writer->payload_sizes[layer], writer->fp);
+    }
+
+    writer->num_records++;
+}
+
+void close_replay_writer(replay_writer_t* writer) {
+    fclose(writer->fp);
+
+    for (uint64_t layer = 0; layer < writer->num_layers; layer++) {
+        free(writer->payloads[layer]);
+    }
+
+    free(writer->payloads);
+    free(writer->payload_sizes);
+    free(writer->payload_capacities);
+}
+
+void replay_step_callback(const ml_gol_t* ml_gol, void* user_data) {
+    write_replay_record((replay_writer_t*) user_data, ml_gol);
+}
+
+/**
+ * Reads the headers of all the records and stores their position in the file.
+ * The records must start with a keyframe and have consecutive steps.
+ */
+static int index_replay_records(replay_reader_t* reader) {
+    uint64_t capacity = 0;
+    uint8_t type;
+
+    reader->num_records = 0;
+
+    while (fread(&type, sizeof(type), 1, reader->fp) == 1) {
+        uint64_t record[2];
+
+        if (fread(record, sizeof(uint64_t), 2, reader->fp) != 2) {
+            return -1;
+        }
+
+        if (reader->num_records == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            reader->record_types = (uint8_t*) realloc(reader->record_types, capacity * sizeof(uint8_t));
+            reader->record_steps = (uint64_t*) realloc(reader->record_steps, capacity * sizeof(uint64_t));
+            reader->record_offsets = (long*) realloc(reader->record_offsets, capacity * sizeof(long));
+            reader->record_sizes = (uint64_t*) realloc(reader->record_sizes, capacity * sizeof(uint64_t));
+        }
+
+        const uint64_t r = reader->num_records;
+        reader->record_types[r] = type;
+        reader->record_steps[r] = record[0];
+        reader->record_sizes[r] = record[1];
+        reader->record_offsets[r] = ftell(reader->fp);
+
+        bool valid = (type == REPLAY_KEYFRAME || type == REPLAY_DELTA) && (r == 0 ? type == REPLAY_KEYFRAME : record[0] == reader->record_steps[r - 1] + 1);
+        if (!valid || fseek(reader->fp, (long) record[1], SEEK_CUR) != 0) {
+            return -1;
+        }
+
+        reader->num_records++;
+    }
+
+    return reader->num_records > 0 ? 0 : -1;
+}
+
+int open_replay_reader(replay_reader_t* reader, const char* filename) {
+    memset(reader, 0, sizeof(replay_reader_t));
+
+    reader->fp = fopen(filename, "rb");
+    if (!reader->fp) {
+        fprintf(stderr, "Could not open file %s for reading\n", filename);
+        return -1;
+    }
+
+    char magic[4];
+    uint32_t version;
+    uint64_t header[3];
+
+    if (fread(magic, 1, 4, reader->fp) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0 ||
+        fread(&version, sizeof(version), 1, reader->fp) != 1 || version != REPLAY_VERSION ||
+        fread(header, sizeof(uint64_t), 3, reader->fp) != 3 || header[0] == 0 || header[0] > MAX_NUM_LAYERS || header[1] == 0) {
+        fprintf(stderr, "File %s is not a replay file\n", filename);
+        fclose(reader->fp);
+        return -1;
+    }
+
+    reader->num_layers = header[0];
+    reader->grid_size = header[1];
+    reader->keyframe_interval = header[2];
+
+    if (index_replay_records(reader) != 0) {
+        fprintf(stderr, "File %s is corrupted\n", filename);
+        close_replay_reader(reader);
+        return -1;
+    }
+
+    // all the cells are dead until the first keyframe is loaded
+    reader->ml_gol = create_ml_gol(reader->grid_size, reader->num_layers, 0, 0);
+    reader->current_record = -1;
+
+    // the records write the grids directly and the layers are never stepped, they do not need live sets
+    set_layers_representation(reader->ml_gol, REPRESENTATION_DENSE);
+
+    if (seek_replay(reader, reader->record_steps[0]) != 0) {
+        fprintf(stderr, "File %s is corrupted\n", filename);
+        close_replay_reader(reader);
+        return -1;
+    }
+
+    return 0;
+}
+
+uint64_t get_replay_last_step(const replay_reader_t* reader) {
+    return reader->record_steps[reader->num_records - 1];
+}
+
+static const uint8_t* read_payload(replay_reader_t* reader, const uint64_t record) {
+    const uint64_t size = reader->record_sizes[record];
+
+    if (size > reader->payload_capacity) {
+        free(reader->payload);
+        reader->payload = (uint8_t*) malloc(size);
+        reader->payload_capacity = size;
+    }
+
+    if (fseek(reader->fp, reader->record_offsets[record], SEEK_SET) != 0 || fread(reader->payload, 1, size, reader->fp) != size) {
+        return NULL;
+    }
+
+    return reader->payload;
+}
+
+static int apply_keyframe(replay_reader_t* reader, const uint8_t* payload, const uint64_t size) {
+    const uint64_t n = reader->grid_size;
+    const size_t layer_size = (n * n + 7) / 8;
+
+    if (size != layer_size * reader->num_layers) {
+        return -1;
+    }
+
+#pragma omp parallel for
+    for (uint64_t layer = 0; layer < reader->num_layers; layer++) {
+        gol_t* gol = &reader->ml_gol->layers[layer];
+        const uint8_t* bits = payload + layer * layer_size;
+
+        for (uint64_t i = 0; i < n; i++) {
+            for (uint64_t j = 0; j < n; j++) {
+                uint64_t k = i * n + j;
+                gol->current[idx(gol, i + 1, j + 1)] = (bits[k / 8] >> (k % 8)) & 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int apply_delta(replay_reader_t* reader, const uint8_t* payload, const uint64_t size) {
+    const uint64_t n = reader->grid_size;
+    const uint8_t* end = payload + size;
+
+    // the layers are one after the other and their size is only known by decoding them
+    for (uint64_t layer = 0; layer < reader->num_layers; layer++) {
+        gol_t* gol = &reader->ml_gol->layers[layer];
+        uint64_t num_runs;
+        uint64_t position = 0;
+
+        if (decode_varint(&payload, end, &num_runs) != 0) {
+            return -1;
+        }
+
+        for (uint64_t r = 0; r < num_runs; r++) {
+            uint64_t gap, length;
+
+            if (decode_varint(&payload, end, &gap) != 0 || decode_varint(&payload, end, &length) != 0 || position + gap + length > n * n) {
+                return -1;
+            }
+
+            for (uint64_t k = position + gap; k < position + gap + length; k++) {
+                size_t cell = idx(gol, k / n + 1, k % n + 1);
+                gol->current[cell] = !gol->current[cell];
+            }
+
+            position += gap + length;
+        }
+    }
+
+    return payload == end ? 0 : -1;
+}
+
+int seek_replay(replay_reader_t* reader, const uint64_t step) {
+    if (step < reader->record_steps[0] || step > get_replay_last_step(reader)) {
+        return -1;
+    }
+
+    const int64_t target = (int64_t) (step - reader->record_steps[0]);
+
+    int64_t keyframe = target;
+    while (reader->record_types[keyframe] != REPLAY_KEYFRAME) {
+        keyframe--;
+    }
+
+    // going forward from the current step is cheaper than from the keyframe, when it is after it
+    int64_t record = reader->current_record >= keyframe && reader->current_record <= target ? reader->current_record + 1 : keyframe;
+
+    for (; record <= target; record++) {
+        const uint8_t* payload = read_payload(reader, (uint64_t) record);
+        const uint64_t size = reader->record_sizes[record];
+
+        int result = !payload ? -1 :
+            reader->record_types[record] == REPLAY_KEYFRAME ? apply_keyframe(reader, payload, size) : apply_delta(reader, payload, size);
+
+        if (result != 0) {
+            reader->current_record = -1;
+            return -1;
+        }
+
+        reader->current_record = record;
+    }
+
+    for (uint64_t layer = 0; layer < reader->num_layers; layer++) {
+        fill_ghost_cells(&reader->ml_gol->layers[layer]);
+    }
+
+    reader->ml_gol->step = step;
+    calculate_combined(reader->ml_gol);
+    calculate_dependent(reader->ml_gol);
+
+    return 0;
+}
+
+const ml_gol_t* get_replay_ml_gol(const replay_reader_t* reader) {
+    return reader->ml_gol;
+}
+
+void close_replay_reader(replay_reader_t* reader) {
+    fclose(reader->fp);
+
+    if (reader->ml_gol) {
+        free_ml_gol(reader->ml_gol);
+    }
+
+    free(reader->record_types);
+    free(reader->record_steps);
+    free(reader->record_offsets);
+    free(reader->record_sizes);
+    free(reader->payload);
+}
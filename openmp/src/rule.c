@@ -0,0 +1,215 @@
+#include "rule.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * Parses the counts after the letter of a part of a rule, up to the slash or the end of the string.
+ */
+static int parse_counts(const char** string, uint16_t* mask) {
+    *mask = 0;
+
+    for (; **string != '\0' && **string != '/'; (*string)++) {
+        if (**string < '0' || **string > '8') {
+            return -1;
+        }
+
+        *mask |= (uint16_t) (1 << (**string - '0'));
+    }
+
+    return 0;
+}
+
+static int parse_life_like_rule(const char* string, rule_t* rule) {
+    if (toupper((unsigned char) string[0]) != 'B') {
+        return -1;
+    }
+
+    string++;
+    if (parse_counts(&string, &rule->birth) != 0 || *string != '/') {
+        return -1;
+    }
+
+    string++;
+    if (toupper((unsigned char) string[0]) != 'S') {
+        return -1;
+    }
+
+    string++;
+    return parse_counts(&string, &rule->survive);
+}
+
+/**
+ * Parses a number of a Larger than Life rule, at most max.
+ */
+static int parse_number(const char** string, const unsigned long max, uint16_t* number) {
+    char* end;
+
+    if (!isdigit((unsigned char) **string)) {
+        return -1;
+    }
+
+    unsigned long value = strtoul(*string, &end, 10);
+    if (value > max) {
+        return -1;
+    }
+
+    *string = end;
+    *number = (uint16_t) value;
+
+    return 0;
+}
+
+/**
+ * Parses the range of a part of a Larger than Life rule, <min>..<max> or a single count, up to the end of the part.
+ */
+static int parse_range(const char* string, const unsigned long max, uint16_t* min_count, uint16_t* max_count) {
+    if (parse_number(&string, max, min_count) != 0) {
+        return -1;
+    }
+
+    *max_count = *min_count;
+    if (strncmp(string, "..", 2) == 0) {
+        string += 2;
+
+        if (parse_number(&string, max, max_count) != 0 || *max_count < *min_count) {
+            return -1;
+        }
+    }
+
+    return *string == '\0' || *string == ',' ? 0 : -1;
+}
+
+/**
+ * Converts a Larger than Life rule of radius 1 to the masks of the Life-like rule, the counts of the survivals
+ * are shifted by one when they include the cell itself.
+ */
+static void to_life_like_rule(rule_t* rule) {
+    uint16_t birth = 0;
+    uint16_t survive = 0;
+
+    for (uint16_t k = 0; k <= 8; k++) {
+        if (k >= rule->birth_min && k <= rule->birth_max) {
+            birth |= (uint16_t) (1 << k);
+        }
+
+        uint16_t count = rule->middle ? k + 1 : k;
+        if (count >= rule->survive_min && count <= rule->survive_max) {
+            survive |= (uint16_t) (1 << k);
+        }
+    }
+
+    *rule = (rule_t) { birth, survive, 1, false, 0, 0, 0, 0 };
+}
+
+static int parse_larger_than_life_rule(const char* string, rule_t* rule) {
+    memset(rule, 0, sizeof(rule_t));
+
+    const char* birth = NULL;
+    const char* survive = NULL;
+    uint16_t value;
+
+    for (const char* part = string; part; part = strchr(part, ',') ? strchr(part, ',') + 1 : NULL) {
+        const char letter = (char) toupper((unsigned char) part[0]);
+        const char* rest = part + 1;
+
+        switch (letter) {
+        case 'R':
+            if (parse_number(&rest, MAX_RULE_RADIUS, &value) != 0 || value == 0) {
+                return -1;
+            }
+            rule->radius = (uint8_t) value;
+            break;
+        case 'C':
+            // the rules with more than two states are not supported, C0 and C2 are the same
+            if (parse_number(&rest, 2, &value) != 0 || value == 1) {
+                return -1;
+            }
+            break;
+        case 'M':
+            if (parse_number(&rest, 1, &value) != 0) {
+                return -1;
+            }
+            rule->middle = value == 1;
+            break;
+        case 'N':
+            // only the square (Moore) neighborhood
+            if (toupper((unsigned char) *rest++) != 'M') {
+                return -1;
+            }
+            break;
+        case 'S':
+            survive = rest;
+            continue;
+        case 'B':
+            birth = rest;
+            continue;
+        default:
+            return -1;
+        }
+
+        if (*rest != '\0' && *rest != ',') {
+            return -1;
+        }
+    }
+
+    if (rule->radius == 0 || !birth || !survive) {
+        return -1;
+    }
+
+    // the counts can include the cell itself
+    const unsigned long max_count = (2UL * rule->radius + 1) * (2UL * rule->radius + 1);
+
+    if (parse_range(birth, max_count, &rule->birth_min, &rule->birth_max) != 0 ||
+            parse_range(survive, max_count, &rule->survive_min, &rule->survive_max) != 0) {
+        return -1;
+    }
+
+    if (rule->radius == 1) {
+        to_life_like_rule(rule);
+    }
+
+    return 0;
+}
+
+int parse_rule(const char* string, rule_t* rule) {
+    if (toupper((unsigned char) string[0]) == 'R') {
+        return parse_larger_than_life_rule(string, rule);
+    }
+
+    *rule = (rule_t) { 0, 0, 1, false, 0, 0, 0, 0 };
+
+    return parse_life_like_rule(string, rule);
+}
+
+void rule_to_string(const rule_t rule, char* string) {
+    if (rule.radius > 1) {
+        snprintf(string, MAX_RULE_LENGTH, "R%u,C0,M%d,S%u..%u,B%u..%u,NM",
+            rule.radius, rule.middle, rule.survive_min, rule.survive_max, rule.birth_min, rule.birth_max);
+        return;
+    }
+
+    *string++ = 'B';
+    for (int k = 0; k <= 8; k++) {
+        if (rule.birth & (1 << k)) {
+            *string++ = (char) ('0' + k);
+        }
+    }
+
+    *string++ = '/';
+    *string++ = 'S';
+    for (int k = 0; k <= 8; k++) {
+        if (rule.survive & (1 << k)) {
+            *string++ = (char) ('0' + k);
+        }
+    }
+
+    *string = '\0';
+}
+
+bool rules_equal(const rule_t a, const rule_t b) {
+    return a.birth == b.birth && a.survive == b.survive && a.radius == b.radius && a.middle == b.middle &&
+        a.birth_min == b.birth_min && a.birth_max == b.birth_max && a.survive_min == b.survive_min && a.survive_max == b.survive_max;
+}
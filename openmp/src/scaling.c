@@ -0,0 +1,242 @@
+#include "scaling.h"
+#include "autotune.h"
+#include "ml_gol.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <omp.h>
+
+// repetitions of the timings of a point and of the bandwidth probe, the best one is kept
+#define SCALING_REPETITIONS 3
+#define STREAM_REPETITIONS 5
+
+#define STREAM_SCALAR 3.0
+
+#define SCALING_DENSITY 0.3
+#define SCALING_SEED 1
+
+#define CPU_MODEL_LENGTH 128
+
+double measure_stream_bandwidth(const int num_threads) {
+    double* a = (double*) malloc(STREAM_ARRAY_SIZE * sizeof(double));
+    double* b = (double*) malloc(STREAM_ARRAY_SIZE * sizeof(double));
+    double* c = (double*) malloc(STREAM_ARRAY_SIZE * sizeof(double));
+
+    // the pages are touched first by the threads that use them
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+    for (uint64_t i = 0; i < STREAM_ARRAY_SIZE; i++) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+
+    double best_time = INFINITY;
+
+    for (int r = 0; r < STREAM_REPETITIONS; r++) {
+        double tstart = omp_get_wtime();
+
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (uint64_t i = 0; i < STREAM_ARRAY_SIZE; i++) {
+            a[i] = b[i] + STREAM_SCALAR * c[i];
+        }
+
+        double time = omp_get_wtime() - tstart;
+        best_time = time < best_time ? time : best_time;
+    }
+
+    // the result is checked, like STREAM does, so that the loop is not optimized away
+    if (a[STREAM_ARRAY_SIZE - 1] != 1.0 + STREAM_SCALAR * 2.0) {
+        fprintf(stderr, "The bandwidth probe produced a wrong result\n");
+    }
+
+    free(a);
+    free(b);
+    free(c);
+
+    // two arrays read and one written
+    return 3.0 * sizeof(double) * STREAM_ARRAY_SIZE / best_time / 1e9;
+}
+
+/**
+ * Returns the schedule with the given number of threads and the strategy with the lowest predicted time.
+ */
+static schedule_t schedule_for_threads(const cost_model_t* model, const uint64_t grid_size, const uint64_t num_layers, const int num_threads) {
+    schedule_t best = default_schedule();
+    best.num_threads = num_threads;
+    double best_time = predict_step_time(model, best, grid_size, num_layers);
+
+    for (int s = 0; s < NUM_SCHEDULE_STRATEGIES; s++) {
+        schedule_t candidate = best;
+        candidate.strategy = (schedule_strategy_t) s;
+
+        double time = predict_step_time(model, candidate, grid_size, num_layers);
+
+        if (time < best_time) {
+            best = candidate;
+            best_time = time;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Returns the best time per step of the given configuration over SCALING_REPETITIONS runs of num_steps steps, after one step of warm up.
+ */
+static double time_steps(const uint64_t grid_size, const uint64_t num_layers, const uint64_t num_steps, const schedule_t schedule) {
+    ml_gol_t* ml_gol = create_ml_gol(grid_size, num_layers, SCALING_DENSITY, SCALING_SEED);
+
+    set_derived_grids(ml_gol, false);
+    set_schedule(ml_gol, schedule);
+
+    step_ml_gol(ml_gol, 1);
+
+    double best_time = INFINITY;
+
+    for (int r = 0; r < SCALING_REPETITIONS; r++) {
+        double tstart = omp_get_wtime();
+        step_ml_gol(ml_gol, num_steps);
+
+        double time = omp_get_wtime() - tstart;
+        best_time = time < best_time ? time : best_time;
+    }
+
+    free_ml_gol(ml_gol);
+
+    return best_time / num_steps;
+}
+
+/**
+ * Times a point of a study and calculates its rates, the speedup and the efficiency are calculated by the caller.
+ */
+static void measure_point(scaling_point_t* point, const char* study, const cost_model_t* model, const uint64_t grid_size, const uint64_t num_layers,
+        const uint64_t num_steps, const int num_threads, const double stream_bandwidth) {
+    point->num_threads = num_threads;
+    point->grid_size = grid_size;
+    point->schedule = schedule_for_threads(model, grid_size, num_layers, num_threads);
+    point->step_time = time_steps(grid_size, num_layers, num_steps, point->schedule);
+    point->cell_updates_per_second = (double) grid_size * grid_size * num_layers / point->step_time;
+    point->bandwidth = point->cell_updates_per_second * BYTES_PER_CELL_UPDATE / 1e9;
+    point->stream_bandwidth = stream_bandwidth;
+
+    printf("  %-6s  %3d threads  grid %6ld  %-10s  %.6f s/step  %8.3f Gcells/s  %7.2f GB/s (STREAM %.2f GB/s)\n",
+        study, num_threads, grid_size, schedule_strategy_name(point->schedule.strategy), point->step_time,
+        point->cell_updates_per_second / 1e9, point->bandwidth, stream_bandwidth);
+}
+
+/**
+ * Returns the number of threads after the given one: the next power of two, or the maximum if the power would be larger.
+ */
+static int next_thread_count(const int num_threads, const int max_threads) {
+    return (num_threads < max_threads && num_threads * 2 > max_threads) ? max_threads : num_threads * 2;
+}
+
+void run_scaling_study(scaling_report_t* report, const uint64_t grid_size, const uint64_t num_layers, const uint64_t num_steps, const int max_threads) {
+    report->grid_size = grid_size;
+    report->num_layers = num_layers;
+    report->num_steps = num_steps;
+    report->max_threads = max_threads;
+    report->num_points = 0;
+
+    for (int t = 1; t <= max_threads; t = next_thread_count(t, max_threads)) {
+        report->num_points++;
+    }
+
+    report->strong = (scaling_point_t*) malloc(report->num_points * sizeof(scaling_point_t));
+    report->weak = (scaling_point_t*) malloc(report->num_points * sizeof(scaling_point_t));
+
+    cost_model_t model;
+    measure_cost_model(&model, max_threads);
+
+    uint64_t p = 0;
+    for (int t = 1; t <= max_threads; t = next_thread_count(t, max_threads), p++) {
+        double stream_bandwidth = measure_stream_bandwidth(t);
+
+        // the cells of the grid grow with the threads
+        uint64_t weak_grid_size = (uint64_t) (grid_size * sqrt((double) t) + 0.5);
+
+        measure_point(&report->strong[p], "strong", &model, grid_size, num_layers, num_steps, t, stream_bandwidth);
+        measure_point(&report->weak[p], "weak", &model, weak_grid_size, num_layers, num_steps, t, stream_bandwidth);
+
+        report->strong[p].speedup = report->strong[0].step_time / report->strong[p].step_time;
+        report->strong[p].efficiency = report->strong[p].speedup / t;
+
+        // the work of the point over the work with one thread is about t, the rounding of the grid size is taken into account
+        report->weak[p].speedup = ((double) weak_grid_size * weak_grid_size) / ((double) grid_size * grid_size) *
+            report->weak[0].step_time / report->weak[p].step_time;
+        report->weak[p].efficiency = report->weak[p].speedup / t;
+    }
+
+    free_cost_model(&model);
+}
+
+/**
+ * Writes a string as a JSON string, with the quotes and the backslashes escaped.
+ */
+static void write_json_string(FILE* fp, const char* string) {
+    fputc('"', fp);
+
+    for (; *string != '\0'; string++) {
+        if (*string == '"' || *string == '\\') {
+            fputc('\\', fp);
+        }
+
+        fputc(*string, fp);
+    }
+
+    fputc('"', fp);
+}
+
+static void write_json_points(FILE* fp, const char* name, const scaling_point_t* points, const uint64_t num_points) {
+    fprintf(fp, "  \"%s\": [\n", name);
+
+    for (uint64_t p = 0; p < num_points; p++) {
+        const scaling_point_t* point = &points[p];
+
+        fprintf(fp, "    {\"threads\": %d, \"grid_size\": %lu, \"strategy\": \"%s\", \"kernel\": \"%s\", \"step_time\": %.9f, "
+            "\"speedup\": %.4f, \"efficiency\": %.4f, \"cell_updates_per_second\": %.6e, \"bandwidth_gbs\": %.4f, "
+            "\"stream_bandwidth_gbs\": %.4f, \"bandwidth_fraction\": %.4f}%s\n",
+            point->num_threads, point->grid_size, schedule_strategy_name(point->schedule.strategy), kernel_name(point->schedule.kernel),
+            point->step_time, point->speedup, point->efficiency, point->cell_updates_per_second, point->bandwidth,
+            point->stream_bandwidth, point->bandwidth / point->stream_bandwidth, p + 1 < num_points ? "," : "");
+    }
+
+    fprintf(fp, "  ]");
+}
+
+int write_scaling_report(const char* filename, const scaling_report_t* report) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Could not open file %s for writing\n", filename);
+        return -1;
+    }
+
+    char cpu_model[CPU_MODEL_LENGTH];
+    get_cpu_model(cpu_model, sizeof(cpu_model));
+
+    fprintf(fp, "{\n  \"cpu_model\": ");
+    write_json_string(fp, cpu_model);
+    fprintf(fp, ",\n  \"timestamp\": %ld,\n", (long) time(NULL));
+    fprintf(fp, "  \"max_threads\": %d,\n", report->max_threads);
+    fprintf(fp, "  \"grid_size\": %lu,\n", report->grid_size);
+    fprintf(fp, "  \"num_layers\": %lu,\n", report->num_layers);
+    fprintf(fp, "  \"num_steps\": %lu,\n", report->num_steps);
+    fprintf(fp, "  \"bytes_per_cell_update\": %d,\n", BYTES_PER_CELL_UPDATE);
+    fprintf(fp, "  \"stream_array_bytes\": %lu,\n", (uint64_t) STREAM_ARRAY_SIZE * sizeof(double));
+
+    write_json_points(fp, "strong", report->strong, report->num_points);
+    fprintf(fp, ",\n");
+    write_json_points(fp, "weak", report->weak, report->num_points);
+    fprintf(fp, "\n}\n");
+
+    fclose(fp);
+
+    return 0;
+}
+
+void free_scaling_report(scaling_report_t* report) {
+    free(report->strong);
+    free(report->weak);
+}
@@ -0,0 +1,220 @@
+#include "scheduler.h"
+#include "ml_gol.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+// grid used to measure the cost of a cell, small enough to be measured in a few milliseconds
+#define SAMPLE_GRID_SIZE 256
+#define SAMPLE_NUM_LAYERS 2
+#define SAMPLE_REPETITIONS 3
+
+// number of parallel regions and barriers timed for each thread count
+#define OVERHEAD_REPETITIONS 200
+
+#define DEFAULT_TILE_SIZE 64
+
+static const char* STRATEGY_NAMES[NUM_SCHEDULE_STRATEGIES] = {
+    "layers",
+    "rows",
+    "tiles",
+    "persistent",
+    "tasks"
+};
+
+static double measure_fork_join_time(const int num_threads) {
+    volatile int sink = 0;
+
+    // first region to create the threads
+#pragma omp parallel num_threads(num_threads)
+    {
+        sink++;
+    }
+
+    double tstart = omp_get_wtime();
+
+    for (int r = 0; r < OVERHEAD_REPETITIONS; r++) {
+#pragma omp parallel num_threads(num_threads)
+        {
+            sink++;
+        }
+    }
+
+    return (omp_get_wtime() - tstart) / OVERHEAD_REPETITIONS;
+}
+
+static double measure_barrier_time(const int num_threads) {
+    double elapsed = 0;
+
+#pragma omp parallel num_threads(num_threads)
+    {
+#pragma omp barrier
+        double tstart = omp_get_wtime();
+
+        for (int r = 0; r < OVERHEAD_REPETITIONS; r++) {
+#pragma omp barrier
+        }
+
+#pragma omp master
+        elapsed = omp_get_wtime() - tstart;
+    }
+
+    return elapsed / OVERHEAD_REPETITIONS;
+}
+
+static void measure_cell_times(cost_model_t* model) {
+    ml_gol_t* ml_gol = create_ml_gol(SAMPLE_GRID_SIZE, SAMPLE_NUM_LAYERS, 0.3, 1);
+    const double cells = (double) SAMPLE_GRID_SIZE * SAMPLE_GRID_SIZE * SAMPLE_NUM_LAYERS;
+
+    model->step_cell_time = 0;
+    model->derived_cell_time = 0;
+
+    // the minimum of a few repetitions, to exclude the first touches and the noise
+    for (int r = 0; r < SAMPLE_REPETITIONS; r++) {
+        double tstart = omp_get_wtime();
+
+        for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+            step(&ml_gol->layers[layer]);
+        }
+
+        double tmiddle = omp_get_wtime();
+
+        // a single thread, the rows can be updated in order
+        for (uint64_t i = 1; i < SAMPLE_GRID_SIZE + 1; i++) {
+            update_combined_row(ml_gol, i);
+            update_dependent_row(ml_gol, i);
+        }
+
+        double tstop = omp_get_wtime();
+
+        double step_time = (tmiddle - tstart) / cells;
+        double derived_time = (tstop - tmiddle) / cells;
+
+        if (r == 0 || step_time < model->step_cell_time) {
+            model->step_cell_time = step_time;
+        }
+        if (r == 0 || derived_time < model->derived_cell_time) {
+            model->derived_cell_time = derived_time;
+        }
+    }
+
+    free_ml_gol(ml_gol);
+}
+
+void measure_cost_model(cost_model_t* model, const int max_threads) {
+    model->max_threads = max_threads;
+    model->fork_join_time = (double*) calloc(max_threads + 1, sizeof(double));
+    model->barrier_time = (double*) calloc(max_threads + 1, sizeof(double));
+
+    // measure powers of two (and the maximum), the thread counts in between are interpolated
+    int previous = 0;
+    for (int t = 1; previous < max_threads; t = (t * 2 > max_threads) ? max_threads : t * 2) {
+        model->fork_join_time[t] = measure_fork_join_time(t);
+        model->barrier_time[t] = measure_barrier_time(t);
+
+        for (int k = previous + 1; previous > 0 && k < t; k++) {
+            double weight = (double) (k - previous) / (t - previous);
+            model->fork_join_time[k] = model->fork_join_time[previous] + weight * (model->fork_join_time[t] - model->fork_join_time[previous]);
+            model->barrier_time[k] = model->barrier_time[previous] + weight * (model->barrier_time[t] - model->barrier_time[previous]);
+        }
+
+        previous = t;
+    }
+
+    measure_cell_times(model);
+}
+
+void free_cost_model(cost_model_t* model) {
+    free(model->fork_join_time);
+    free(model->barrier_time);
+}
+
+/**
+ * Ratio between the time of the slowest thread and the ideal time,
+ * when the given number of equal units of work are statically split among the threads.
+ */
+static double imbalance(const uint64_t units, const int num_threads) {
+    uint64_t units_per_thread = (units + num_threads - 1) / num_threads;
+    return (double) (units_per_thread * num_threads) / units;
+}
+
+double predict_step_time(const cost_model_t* model, const schedule_t schedule, const uint64_t grid_size, const uint64_t num_layers) {
+    const int t = schedule.num_threads;
+    const double cells = (double) grid_size * grid_size;
+
+    const double fork_join = model->fork_join_time[t];
+    const double barrier = model->barrier_time[t];
+
+    // the ghost cells are filled serially, about four rows per layer, the wrap kernel does not need them
+    const double fill_time = schedule.kernel == KERNEL_WRAP ? 0 : 4.0 * grid_size * model->step_cell_time;
+    const double fill = ((num_layers + t - 1) / t) * fill_time;
+
+    // the derived grids are always split by rows, the dependent one in three phases
+    const double derived_work = cells * num_layers * model->derived_cell_time / t;
+    const double derived = derived_work * imbalance(grid_size, t) + 4 * barrier;
+    const double step_work = cells * num_layers * model->step_cell_time / t;
+
+    uint64_t tiles_per_side = (grid_size + schedule.tile_size - 1) / schedule.tile_size;
+    uint64_t bands = (grid_size + TASK_BAND_ROWS - 1) / TASK_BAND_ROWS;
+
+    switch (schedule.strategy) {
+    case SCHEDULE_LAYERS:
+        return 2 * fork_join + ((num_layers + t - 1) / t) * (cells * model->step_cell_time + fill_time) + derived;
+    case SCHEDULE_ROWS:
+        return fork_join + 2 * barrier + step_work * imbalance(num_layers * grid_size, t) + fill + derived;
+    case SCHEDULE_TILES:
+        return fork_join + 2 * barrier + step_work * imbalance(num_layers * tiles_per_side * tiles_per_side, t) + fill + derived;
+    case SCHEDULE_PERSISTENT:
+        // the region is opened once, each step only pays the barriers
+        return 3 * barrier + step_work * imbalance(num_layers * grid_size, t) + fill + derived;
+    case SCHEDULE_TASKS:
+        // no barriers and no serial fill, but the bands are coarse and each task costs about a barrier to schedule
+        return fork_join + (step_work + derived_work) * imbalance(bands, t) + 2.0 * bands * barrier / t;
+    }
+
+    return 0;
+}
+
+schedule_t choose_schedule(const cost_model_t* model, const uint64_t grid_size, const uint64_t num_layers) {
+    schedule_t best = default_schedule();
+    best.num_threads = 1;
+    double best_time = predict_step_time(model, best, grid_size, num_layers);
+
+    for (int t = 1; t <= model->max_threads; t++) {
+        for (int s = 0; s < NUM_SCHEDULE_STRATEGIES; s++) {
+            schedule_t candidate = best;
+            candidate.strategy = (schedule_strategy_t) s;
+            candidate.num_threads = t;
+
+            double time = predict_step_time(model, candidate, grid_size, num_layers);
+
+            if (time < best_time) {
+                best = candidate;
+                best_time = time;
+            }
+        }
+    }
+
+    return best;
+}
+
+schedule_t default_schedule(void) {
+    schedule_t schedule = { SCHEDULE_LAYERS, omp_get_max_threads(), DEFAULT_TILE_SIZE, KERNEL_WRAP };
+    return schedule;
+}
+
+const char* schedule_strategy_name(const schedule_strategy_t strategy) {
+    return STRATEGY_NAMES[strategy];
+}
+
+int parse_schedule_strategy(const char* name, schedule_strategy_t* strategy) {
+    for (int s = 0; s < NUM_SCHEDULE_STRATEGIES; s++) {
+        if (strcmp(name, STRATEGY_NAMES[s]) == 0) {
+            *strategy = (schedule_strategy_t) s;
+            return 0;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,49 @@
+#include "state_hash.h"
+
+uint64_t fnv1a_hash(uint64_t hash, const void* data, const uint64_t length) {
+    const uint8_t* bytes = (const uint8_t*) data;
+
+    for (uint64_t b = 0; b < length; b++) {
+        hash ^= bytes[b];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
+uint64_t hash_layer_state(const ml_gol_t* ml_gol, const uint64_t layer) {
+    const bool* grid = get_layer_grid(ml_gol, layer);
+    const uint64_t stride = get_layer_grid_stride(ml_gol);
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (uint64_t i = 0; i < ml_gol->grid_size; i++) {
+        for (uint64_t j = 0; j < ml_gol->grid_size; j++) {
+            const uint8_t cell = grid[i * stride + j] ? 1 : 0;
+            hash = fnv1a_hash(hash, &cell, 1);
+        }
+    }
+
+    return hash;
+}
+
+/**
+ * Hashes the channels of a grid of colors, the padding of the structure (if any) is not hashed.
+ */
+static uint64_t hash_colors(const color_t* colors, const uint64_t num_pixels) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (uint64_t p = 0; p < num_pixels; p++) {
+        const uint8_t channels[3] = { colors[p].r, colors[p].g, colors[p].b };
+        hash = fnv1a_hash(hash, channels, sizeof(channels));
+    }
+
+    return hash;
+}
+
+uint64_t hash_combined_state(const ml_gol_t* ml_gol) {
+    return hash_colors(get_combined_grid(ml_gol), ml_gol->grid_size * ml_gol->grid_size);
+}
+
+uint64_t hash_dependent_state(const ml_gol_t* ml_gol) {
+    return hash_colors(get_dependent_grid(ml_gol), ml_gol->grid_size * ml_gol->grid_size);
+}
@@ -0,0 +1,130 @@
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the records are small, a large buffer makes the writes to the file rare
+#define STATS_BUFFER_SIZE (1 << 20)
+
+static stats_format_t format_for_filename(const char* filename) {
+    size_t length = strlen(filename);
+    return length >= 4 && strcmp(filename + length - 4, ".bin") == 0 ? STATS_BINARY : STATS_CSV;
+}
+
+int open_stats_writer(stats_writer_t* writer, const char* filename, const ml_gol_t* ml_gol, const uint64_t histogram_interval) {
+    writer->format = format_for_filename(filename);
+    writer->fp = fopen(filename, writer->format == STATS_BINARY ? "wb" : "w");
+    if (!writer->fp) {
+        fprintf(stderr, "Could not open file %s for writing\n", filename);
+        return -1;
+    }
+
+    setvbuf(writer->fp, NULL, _IOFBF, STATS_BUFFER_SIZE);
+
+    writer->num_layers = ml_gol->num_layers;
+    writer->bins = get_dependent_histogram_bins(ml_gol);
+    writer->histogram_interval = histogram_interval > 0 ? histogram_interval : DEFAULT_STATS_HISTOGRAM_INTERVAL;
+
+    // step, 4 stats per layer and the histogram
+    writer->record = (uint64_t*) malloc((1 + 4 * writer->num_layers + writer->bins) * sizeof(uint64_t));
+
+    if (writer->format == STATS_BINARY) {
+        uint32_t version = STATS_VERSION;
+        uint64_t header[4] = { ml_gol->num_layers, ml_gol->grid_size, writer->bins, writer->histogram_interval };
+
+        fwrite(STATS_MAGIC, 1, 4, writer->fp);
+        fwrite(&version, sizeof(version), 1, writer->fp);
+        fwrite(header, sizeof(uint64_t), 4, writer->fp);
+        return 0;
+    }
+
+    fprintf(writer->fp, "step");
+    for (uint64_t l = 0; l < writer->num_layers; l++) {
+        fprintf(writer->fp, ",alive_%lu,births_%lu,deaths_%lu,changed_tiles_%lu", l, l, l, l);
+    }
+    fprintf(writer->fp, ",dependent_mean,dependent_median,dependent_max,dependent_empty\n");
+
+    return 0;
+}
+
+/**
+ * Writes the summary of the dependent histogram: the mean, the median and the maximum number
+ * of alive cells in the neighborhood of a cell, and the number of cells with none.
+ */
+static void write_histogram_summary(FILE* fp, const uint64_t* histogram, const uint64_t bins) {
+    uint64_t cells = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    for (uint64_t k = 0; k < bins; k++) {
+        cells += histogram[k];
+        sum += k * histogram[k];
+        if (histogram[k]) {
+            max = k;
+        }
+    }
+
+    uint64_t median = 0;
+    uint64_t below = 0;
+    while (median < bins && below + histogram[median] < (cells + 1) / 2) {
+        below += histogram[median];
+        median++;
+    }
+
+    fprintf(fp, ",%.4f,%lu,%lu,%lu\n", cells ? (double) sum / cells : 0.0, median, max, histogram[0]);
+}
+
+void write_stats_record(stats_writer_t* writer, const ml_gol_t* ml_gol) {
+    const bool with_histogram = ml_gol->step % writer->histogram_interval == 0;
+
+    // the histogram is kept by the steps only while the derived grids are calculated
+    if (with_histogram && !ml_gol->derived_grids) {
+        calculate_dependent_histogram(ml_gol);
+    }
+
+    const uint64_t* histogram = get_dependent_histogram(ml_gol);
+
+    if (writer->format == STATS_CSV) {
+        fprintf(writer->fp, "%lu", ml_gol->step);
+
+        for (uint64_t l = 0; l < writer->num_layers; l++) {
+            const gol_stats_t* stats = get_layer_stats(ml_gol, l);
+            fprintf(writer->fp, ",%lu,%lu,%lu,%lu", stats->alive, stats->births, stats->deaths, stats->changed_tiles);
+        }
+
+        if (with_histogram) {
+            write_histogram_summary(writer->fp, histogram, writer->bins);
+        } else {
+            fprintf(writer->fp, ",,,,\n");
+        }
+        return;
+    }
+
+    uint64_t* record = writer->record;
+    *record++ = ml_gol->step;
+
+    for (uint64_t l = 0; l < writer->num_layers; l++) {
+        const gol_stats_t* stats = get_layer_stats(ml_gol, l);
+        *record++ = stats->alive;
+        *record++ = stats->births;
+        *record++ = stats->deaths;
+        *record++ = stats->changed_tiles;
+    }
+
+    if (with_histogram) {
+        memcpy(record, histogram, writer->bins * sizeof(uint64_t));
+    } else {
+        memset(record, 0, writer->bins * sizeof(uint64_t));
+    }
+
+    fwrite(writer->record, sizeof(uint64_t), 1 + 4 * writer->num_layers + writer->bins, writer->fp);
+}
+
+void close_stats_writer(stats_writer_t* writer) {
+    fclose(writer->fp);
+    free(writer->record);
+}
+
+void stats_step_callback(const ml_gol_t* ml_gol, void* user_data) {
+    write_stats_record((stats_writer_t*) user_data, ml_gol);
+}
@@ -0,0 +1,232 @@
+#include "telemetry.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <omp.h>
+
+/**
+ * Returns the nanoseconds since the start of the run.
+ */
+static uint64_t telemetry_now(const telemetry_t* telemetry) {
+    return (uint64_t) ((omp_get_wtime() - telemetry->start_time) * 1e9);
+}
+
+/**
+ * Adds to a counter that has a single writer, a relaxed load and store are enough and do not lock the bus like an atomic add.
+ */
+static void add_relaxed(_Atomic uint64_t* counter, const uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+void init_telemetry(telemetry_t* telemetry, const uint64_t num_layers, const uint64_t num_steps) {
+    telemetry->num_layers = num_layers;
+    telemetry->num_steps = num_steps;
+    telemetry->start_time = omp_get_wtime();
+    telemetry->last_mark = 0;
+    telemetry->alive = (_Atomic uint64_t*) malloc(num_layers * sizeof(_Atomic uint64_t));
+    telemetry->socket_fd = -1;
+    telemetry->socket_path[0] = '\0';
+
+    atomic_init(&telemetry->step, 0);
+    atomic_init(&telemetry->last_step_time, 0);
+    atomic_init(&telemetry->setup_time, 0);
+    atomic_init(&telemetry->compute_time, 0);
+    atomic_init(&telemetry->outputs_time, 0);
+    atomic_init(&telemetry->running, false);
+
+    for (uint64_t layer = 0; layer < num_layers; layer++) {
+        atomic_init(&telemetry->alive[layer], 0);
+    }
+}
+
+void begin_telemetry_steps(telemetry_t* telemetry) {
+    telemetry->last_mark = telemetry_now(telemetry);
+    atomic_store_explicit(&telemetry->setup_time, telemetry->last_mark, memory_order_relaxed);
+    atomic_store_explicit(&telemetry->last_step_time, telemetry->last_mark, memory_order_relaxed);
+}
+
+void record_step_telemetry(telemetry_t* telemetry, const uint64_t step, const gol_t* layers) {
+    const uint64_t now = telemetry_now(telemetry);
+
+    for (uint64_t layer = 0; layer < telemetry->num_layers; layer++) {
+        atomic_store_explicit(&telemetry->alive[layer], layers[layer].stats.alive, memory_order_relaxed);
+    }
+
+    add_relaxed(&telemetry->compute_time, now - telemetry->last_mark);
+    atomic_store_explicit(&telemetry->last_step_time, now, memory_order_relaxed);
+    atomic_store_explicit(&telemetry->step, step, memory_order_relaxed);
+
+    telemetry->last_mark = now;
+}
+
+void record_outputs_telemetry(telemetry_t* telemetry) {
+    const uint64_t now = telemetry_now(telemetry);
+
+    add_relaxed(&telemetry->outputs_time, now - telemetry->last_mark);
+
+    telemetry->last_mark = now;
+}
+
+/**
+ * Reads a size in kB from /proc/self/status (e.g. VmRSS), returns it in bytes or 0 if it is not available.
+ */
+static uint64_t read_process_memory(const char* field) {
+    FILE* fp = fopen("/proc/self/status", "r");
+    if (!fp) {
+        return 0;
+    }
+
+    char line[256];
+    const size_t length = strlen(field);
+    uint64_t kilobytes = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, field, length) == 0 && line[length] == ':') {
+            kilobytes = strtoull(line + length + 1, NULL, 10);
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return kilobytes * 1024;
+}
+
+void write_telemetry_json(FILE* fp, const telemetry_t* telemetry) {
+    const uint64_t now = telemetry_now(telemetry);
+    const uint64_t step = atomic_load_explicit(&telemetry->step, memory_order_relaxed);
+    const uint64_t last_step_time = atomic_load_explicit(&telemetry->last_step_time, memory_order_relaxed);
+    const double setup_time = atomic_load_explicit(&telemetry->setup_time, memory_order_relaxed) / 1e9;
+    const double compute_time = atomic_load_explicit(&telemetry->compute_time, memory_order_relaxed) / 1e9;
+    const double outputs_time = atomic_load_explicit(&telemetry->outputs_time, memory_order_relaxed) / 1e9;
+
+    // the rate is over the time of the completed steps, the setup is not included
+    const double steps_per_second = compute_time + outputs_time > 0 ? step / (compute_time + outputs_time) : 0;
+
+    uint64_t peak_memory = read_process_memory("VmHWM");
+    if (peak_memory == 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        peak_memory = (uint64_t) usage.ru_maxrss * 1024;
+    }
+
+    fprintf(fp, "{\"step\": %lu, \"num_steps\": %lu, \"elapsed\": %.3f, \"seconds_since_step\": %.3f, \"steps_per_second\": %.4f, ",
+        step, telemetry->num_steps, now / 1e9, now > last_step_time ? (now - last_step_time) / 1e9 : 0.0, steps_per_second);
+    fprintf(fp, "\"phases\": {\"setup\": %.6f, \"compute\": %.6f, \"outputs\": %.6f}, \"alive\": [",
+        setup_time, compute_time, outputs_time);
+
+    for (uint64_t layer = 0; layer < telemetry->num_layers; layer++) {
+        fprintf(fp, "%s%lu", layer > 0 ? ", " : "", atomic_load_explicit(&telemetry->alive[layer], memory_order_relaxed));
+    }
+
+    fprintf(fp, "], \"memory_bytes\": %lu, \"peak_memory_bytes\": %lu, \"eta\": ", read_process_memory("VmRSS"), peak_memory);
+
+    if (step >= telemetry->num_steps) {
+        fprintf(fp, "0");
+    } else if (steps_per_second > 0) {
+        fprintf(fp, "%.3f", (telemetry->num_steps - step) / steps_per_second);
+    } else {
+        fprintf(fp, "null");
+    }
+
+    fprintf(fp, "}\n");
+}
+
+/**
+ * Accepts the connections until the server is stopped, each one gets a snapshot and is closed.
+ */
+static void* telemetry_server(void* data) {
+    telemetry_t* telemetry = (telemetry_t*) data;
+    struct pollfd listener = { .fd = telemetry->socket_fd, .events = POLLIN };
+
+    while (atomic_load_explicit(&telemetry->running, memory_order_relaxed)) {
+        if (poll(&listener, 1, TELEMETRY_POLL_INTERVAL) <= 0) {
+            continue;
+        }
+
+        int client = accept(telemetry->socket_fd, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+
+        // the snapshot is sent at once without SIGPIPE, a client that already left must not stop the run
+        char* snapshot = NULL;
+        size_t length = 0;
+        FILE* fp = open_memstream(&snapshot, &length);
+
+        if (fp) {
+            write_telemetry_json(fp, telemetry);
+            fclose(fp);
+            send(client, snapshot, length, MSG_NOSIGNAL);
+            free(snapshot);
+        }
+
+        close(client);
+    }
+
+    return NULL;
+}
+
+int start_telemetry_server(telemetry_t* telemetry, const char* socket_path) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long\n", socket_path);
+        return -1;
+    }
+
+    strcpy(address.sun_path, socket_path);
+
+    telemetry->socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (telemetry->socket_fd < 0) {
+        fprintf(stderr, "Could not create the telemetry socket\n");
+        return -1;
+    }
+
+    unlink(socket_path);
+
+    if (bind(telemetry->socket_fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(telemetry->socket_fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Could not listen on socket %s\n", socket_path);
+        close(telemetry->socket_fd);
+        telemetry->socket_fd = -1;
+        return -1;
+    }
+
+    strcpy(telemetry->socket_path, socket_path);
+    atomic_store(&telemetry->running, true);
+
+    if (pthread_create(&telemetry->server, NULL, telemetry_server, telemetry) != 0) {
+        fprintf(stderr, "Could not start the telemetry server\n");
+        atomic_store(&telemetry->running, false);
+        close(telemetry->socket_fd);
+        unlink(socket_path);
+        telemetry->socket_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void stop_telemetry_server(telemetry_t* telemetry) {
+    if (telemetry->socket_fd < 0) {
+        return;
+    }
+
+    atomic_store(&telemetry->running, false);
+    pthread_join(telemetry->server, NULL);
+
+    close(telemetry->socket_fd);
+    unlink(telemetry->socket_path);
+    telemetry->socket_fd = -1;
+}
+
+void free_telemetry(telemetry_t* telemetry) {
+    free(telemetry->alive);
+}
@@ -0,0 +1,110 @@
+#include "viewport.h"
+#include "ml_gol.h"
+#include "image.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+int parse_viewport(const char* spec, viewport_t* viewport) {
+    char end;
+
+    if (sscanf(spec, "%lu,%lu,%lu,%lu%c", &viewport->row, &viewport->col, &viewport->height, &viewport->width, &end) != 4) {
+        return -1;
+    }
+
+    if (viewport->height == 0 || viewport->width == 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void init_viewport_output(viewport_output_t* output, const ml_gol_t* ml_gol, const viewport_t* viewports, const uint64_t num_viewports) {
+    const uint64_t n = ml_gol->grid_size;
+    uint64_t max_pixels = 0;
+
+    output->num_viewports = num_viewports < MAX_VIEWPORTS ? num_viewports : MAX_VIEWPORTS;
+
+    for (uint64_t v = 0; v < output->num_viewports; v++) {
+        viewport_t* viewport = &output->viewports[v];
+
+        viewport->row = viewports[v].row % n;
+        viewport->col = viewports[v].col % n;
+        viewport->height = viewports[v].height < n ? viewports[v].height : n;
+        viewport->width = viewports[v].width < n ? viewports[v].width : n;
+
+        if (viewport->height * viewport->width > max_pixels) {
+            max_pixels = viewport->height * viewport->width;
+        }
+    }
+
+    // 3 channels: RGB, combined and dependent
+    output->buffer = (uint8_t*) malloc(2 * max_pixels * 3 * sizeof(uint8_t));
+}
+
+void calculate_viewport(const ml_gol_t* ml_gol, const viewport_t viewport, uint8_t* combined, uint8_t* dependent) {
+    const uint64_t n = ml_gol->grid_size;
+
+    restore_layers_grids(ml_gol);
+
+#pragma omp parallel for
+    for (uint64_t r = 0; r < viewport.height; r++) {
+        // rows and columns of the grid start from 1, 0 is the ghost cell
+        const uint64_t i = (viewport.row + r) % n + 1;
+
+        for (uint64_t c = 0; c < viewport.width; c++) {
+            const uint64_t j = (viewport.col + c) % n + 1;
+            const size_t pixel = (r * viewport.width + c) * 3;
+
+            if (combined) {
+                size_t grid_idx = idx(&ml_gol->layers[0], i, j);
+                color_t color = BLACK;
+
+                for (uint64_t layer = 0; layer < ml_gol->num_layers; layer++) {
+                    if (ml_gol->layers[layer].current[grid_idx]) {
+                        color = add_colors(color, ml_gol->layers_colors[layer]);
+                    }
+                }
+
+                combined[pixel] =     color.r;
+                combined[pixel + 1] = color.g;
+                combined[pixel + 2] = color.b;
+            }
+
+            if (dependent) {
+                uint16_t alive_neighbors = count_dependent_alive_neighbors(ml_gol, i, j);
+                uint8_t channel_value = (uint8_t) ((((float) alive_neighbors) / (get_dependent_histogram_bins(ml_gol) - 1)) * 255);
+
+                dependent[pixel] =     channel_value;
+                dependent[pixel + 1] = channel_value;
+                dependent[pixel + 2] = channel_value;
+            }
+        }
+    }
+}
+
+void create_png_for_viewports(viewport_output_t* output, const ml_gol_t* ml_gol, const uint64_t step) {
+    char filename[64];
+
+    for (uint64_t v = 0; v < output->num_viewports; v++) {
+        const viewport_t viewport = output->viewports[v];
+        uint8_t* combined = output->buffer;
+        uint8_t* dependent = output->buffer + viewport.height * viewport.width * 3;
+
+        calculate_viewport(ml_gol, viewport, combined, dependent);
+
+        sprintf(filename, "output/%s/combined%ld_%04ld.png", VIEWPORT_FOLDER, v, step);
+        write_png_file(filename, viewport.width, viewport.height, combined);
+
+        sprintf(filename, "output/%s/dependent%ld_%04ld.png", VIEWPORT_FOLDER, v, step);
+        write_png_file(filename, viewport.width, viewport.height, dependent);
+    }
+}
+
+void viewports_step_callback(const ml_gol_t* ml_gol, void* user_data) {
+    create_png_for_viewports((viewport_output_t*) user_data, ml_gol, ml_gol->step);
+}
+
+void free_viewport_output(viewport_output_t* output) {
+    free(output->buffer);
+}